@@ -0,0 +1,348 @@
+
+#include <cmath>    // for std::ceil, std::sqrt
+#include <cstdlib>  // for std::atof
+#include <cstring>  // for std::strcmp, std::strstr
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Table.hpp"
+#include "BallSprite.hpp"
+#include "BallShader.hpp"
+#include "Compositor.hpp"
+#include "RenderQueue.hpp"
+#include "Log.hpp"
+
+
+// Microbenchmarks for the hot paths of the simulation and the renderer.
+//
+// Each benchmark prints one line of JSON, so runs can be appended to a file
+// and compared over time:
+//
+//   {"name": "physics_step/16", "iterations": 51234, "ns_per_op": 4123.5,
+//    "items_per_op": 1, "item": "step", "ns_per_item": 4123.5}
+//
+// An "op" is one call of the thing being timed. Some of them handle many
+// items at once (a break is thousands of steps, a sprite is many pixels),
+// so the cost per item is given as well.
+
+
+typedef std::chrono::steady_clock Clock;
+
+static double s_MinSeconds {0.5};
+static const char* s_pFilter {nullptr};
+
+// Results are folded into this, so the compiler can't leave any work out.
+static volatile uint32_t s_Sink {0};
+
+
+static void printResult(const std::string& name, const char* item, uint64_t iterations, uint64_t items, double nanoseconds)
+{
+    std::cout
+        << "{\"name\": \"" << name << "\""
+        << ", \"iterations\": " << iterations
+        << ", \"ns_per_op\": " << nanoseconds / iterations
+        << ", \"items_per_op\": " << items / iterations
+        << ", \"item\": \"" << item << "\""
+        << ", \"ns_per_item\": " << (items > 0 ? nanoseconds / items : 0.0)
+        << "}" << std::endl;
+}
+
+// Run `op` until at least s_MinSeconds have gone by, after one untimed run
+// to warm up. `op` returns how many `item`s it handled.
+template<typename Op>
+static void runBenchmark(const std::string& name, const char* item, Op op)
+{
+    if (s_pFilter && ! std::strstr(name.c_str(), s_pFilter))
+    {
+        return;
+    }
+
+    op();
+
+    uint64_t iterations {0};
+    uint64_t items {0};
+    const auto start = Clock::now();
+    auto end = start;
+    do
+    {
+        items += op();
+        ++iterations;
+        end = Clock::now();
+    }
+    while (std::chrono::duration<double>(end - start).count() < s_MinSeconds);
+
+    printResult(name, item, iterations, items, std::chrono::duration<double, std::nano>(end - start).count());
+}
+
+// The same, but with `setUp` called before every run of `op`, and only
+// `op` itself timed.
+template<typename SetUp, typename Op>
+static void runBenchmark(const std::string& name, const char* item, SetUp setUp, Op op)
+{
+    if (s_pFilter && ! std::strstr(name.c_str(), s_pFilter))
+    {
+        return;
+    }
+
+    setUp();
+    op();
+
+    uint64_t iterations {0};
+    uint64_t items {0};
+    double nanoseconds {0.0};
+    const auto deadline = Clock::now() + std::chrono::duration<double>(s_MinSeconds);
+    do
+    {
+        setUp();
+        const auto start = Clock::now();
+        items += op();
+        nanoseconds += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        ++iterations;
+    }
+    while (Clock::now() < deadline);
+
+    printResult(name, item, iterations, items, nanoseconds);
+}
+
+
+// Spread `count` balls over the felt on a grid, moving in random
+// directions. More than a few hundred won't fit without overlapping, but
+// every pair is tested either way, which is what's being timed.
+static void scatterBalls(Table& table, size_t count)
+{
+    std::mt19937 random {1234};
+    std::uniform_real_distribution<float> speed {-0.5f, 0.5f};
+
+    const float radius {Table::BALL_DIAMETER / 2.0f};
+    const float width {Table::FELT_WIDTH - 2.0f * radius};
+    const float height {Table::FELT_HEIGHT - 2.0f * radius};
+    const auto columns = static_cast<size_t>(std::ceil(std::sqrt(count * width / height)));
+    const size_t rows {(count + columns - 1) / columns};
+
+    table.removeAllBalls();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 position {
+            Table::FELT_LEFT_COORD + radius + width * ((i % columns) + 0.5f) / columns,
+            Table::FELT_TOP_COORD + radius + height * ((i / columns) + 0.5f) / rows,
+        };
+        const auto type = static_cast<BallType>(i % BALL_TYPE_COUNT);
+        table.addBall(type, position, glm::vec2 {speed(random), speed(random)});
+    }
+}
+
+static void benchmarkPhysics()
+{
+    // Left to itself, a scattered table drains into the pockets and slows
+    // down, so every step would be cheaper than the last, and the result
+    // would depend on how many steps got run. Putting the balls back this
+    // often (without timing it) keeps the work about the same.
+    const uint32_t STEPS_PER_SCATTER {100};
+
+    const size_t BALL_COUNTS[] {16, 256, 4096};
+    for (const size_t count : BALL_COUNTS)
+    {
+        Table scattered;
+        scatterBalls(scattered, count);
+        Table table {scattered};
+        uint32_t stepCount {0};
+        runBenchmark("physics_step/" + std::to_string(count), "step", [&table, &scattered, &stepCount]()
+        {
+            if (stepCount++ % STEPS_PER_SCATTER == 0)
+            {
+                table = scattered;
+            }
+        },
+        [&table]()
+        {
+            table.step();
+            return uint64_t {1};
+        });
+    }
+
+    // A full break, from the rack until everything stops: lots of
+    // collisions early on, then a long tail of a few balls rolling.
+    Table breakTable;
+    runBenchmark("break_shot", "step", [&breakTable]()
+    {
+        breakTable.rackBalls();
+        breakTable.applyForce(0, glm::vec2 {20.0f, 0.0f});
+        const uint32_t steps {breakTable.runUntilRest(60.0f)};
+        s_Sink += static_cast<uint32_t>(breakTable.getBalls()[0].position.x);
+        return uint64_t {steps};
+    });
+
+    // One ball hit hard, bouncing off the cushions until friction stops it.
+    Table rollTable;
+    runBenchmark("single_ball_roll", "step", [&rollTable]()
+    {
+        rollTable.removeAllBalls();
+        rollTable.addBall(BallType::Cue, Table::getCueSpot(), glm::vec2 {0.0f, 0.0f});
+        rollTable.applyForce(0, glm::vec2 {20.0f, 7.0f});
+        const uint32_t steps {rollTable.runUntilRest(60.0f)};
+        s_Sink += static_cast<uint32_t>(rollTable.getBalls()[0].position.x);
+        return uint64_t {steps};
+    });
+}
+
+
+static void benchmarkBallTextures()
+{
+    // The table's own size comes from compile time masks; the others are
+    // what a scaled up window rasterises.
+    const int SPRITE_SIZES[] {Table::BALL_DIAMETER, 2 * Table::BALL_DIAMETER, 4 * Table::BALL_DIAMETER};
+    for (const int size : SPRITE_SIZES)
+    {
+        runBenchmark("ball_atlas/" + std::to_string(size), "pixel", [size]() -> uint64_t
+        {
+            const BallAtlas atlas {buildBallAtlas(size)};
+            s_Sink += atlas.m_Pixels[atlas.m_Pixels.size() / 2];
+            return atlas.m_Pixels.size();
+        });
+    }
+
+    // Shading every ball rolled to some angle, as each frame does
+    for (const int size : SPRITE_SIZES)
+    {
+        const BallShader shader {size};
+        std::vector<uint32_t> pixels(size * size);
+        const glm::quat orientation {glm::angleAxis(0.7f, glm::normalize(glm::vec3 {1.0f, 2.0f, 0.0f}))};
+        runBenchmark("ball_shade/" + std::to_string(size), "pixel", [&]()
+        {
+            for (size_t i = 0; i < BALL_TYPE_COUNT; ++i)
+            {
+                shader.shade(
+                    reinterpret_cast<uint8_t*>(pixels.data()),
+                    size * 4,
+                    static_cast<BallType>(i),
+                    orientation
+                );
+                s_Sink += pixels[pixels.size() / 2];
+            }
+            return static_cast<uint64_t>(BALL_TYPE_COUNT * size * size);
+        });
+    }
+}
+
+
+static void benchmarkRendering()
+{
+    // A frame from partway through a break, with the balls spread out
+    Table table;
+    table.rackBalls();
+    table.applyForce(0, glm::vec2 {20.0f, 0.0f});
+    table.step(500);
+
+    SoftwareCompositor compositor;
+    std::vector<uint32_t> frame(SoftwareCompositor::WIDTH * SoftwareCompositor::HEIGHT);
+    runBenchmark("compositor_frame", "pixel", [&]()
+    {
+        compositor.renderFrame(frame.data(), table.getBalls(), 0.5f);
+        s_Sink += frame[frame.size() / 2];
+        return static_cast<uint64_t>(frame.size());
+    });
+
+    // Just the queue: sorting a frame's worth of commands and grouping
+    // them into backend calls, with nothing drawn.
+    RenderQueue queue;
+    RenderRecorder recorder;
+    const SDL_Rect source {0, 0, Table::BALL_DIAMETER, Table::BALL_DIAMETER};
+    runBenchmark("render_queue", "command", [&]()
+    {
+        queue.clear();
+        recorder.clear();
+        for (const auto& ball : table.getBalls())
+        {
+            queue.drawSprite(RenderLayer::Balls, RenderTexture::Balls, source, ball.position.x, ball.position.y, source.w, source.h);
+            queue.fillRect(RenderLayer::Paths, source, SDL_Color {0xff, 0xff, 0xff, 0x40});
+        }
+        queue.sort();
+        queue.submit(recorder);
+        s_Sink += static_cast<uint32_t>(recorder.getCalls().size());
+        return static_cast<uint64_t>(queue.getCommandCount());
+    });
+}
+
+
+static void benchmarkLogging()
+{
+    // What every LOG() costs while logging is off.
+    runBenchmark("log_disabled", "message", []()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            LOG("Dropped %zu table events \n", static_cast<size_t>(i));
+        }
+        return uint64_t {256};
+    });
+
+    // And while it's on. Only the logging thread's side is timed: bursts
+    // small enough to fit in its ring, with pauses (not timed) for the
+    // background thread to write them out, so nothing is dropped.
+    const char* pName {"log_message"};
+    if (s_pFilter && ! std::strstr(pName, s_pFilter))
+    {
+        return;
+    }
+    if ( ! Log::start("/dev/null"))
+    {
+        std::cerr << "Could not start logging" << std::endl;
+        return;
+    }
+
+    const size_t BURST {256};
+    uint64_t iterations {0};
+    Clock::duration elapsed {};
+    const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double> {s_MinSeconds});
+    while (Clock::now() < end)
+    {
+        const auto start = Clock::now();
+        for (size_t i = 0; i < BURST; ++i)
+        {
+            LOG("Audio: %d Hz, %u sample buffer (%.1f ms) \n", 48000, 512u, 10.7f);
+        }
+        elapsed += Clock::now() - start;
+        ++iterations;
+        std::this_thread::sleep_for(std::chrono::milliseconds {10});
+    }
+    Log::stop();
+
+    printResult(pName, "message", iterations, iterations * BURST, std::chrono::duration<double, std::nano>(elapsed).count());
+}
+
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+        {
+            s_MinSeconds = std::atof(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && ! s_pFilter)
+        {
+            s_pFilter = argv[i];
+        }
+        else
+        {
+            std::cerr
+                << "Usage: " << argv[0] << " [--min-time SECONDS] [FILTER] \n"
+                << "  Runs the benchmarks whose names contain FILTER, each for at least \n"
+                << "  SECONDS (default 0.5), and prints the results as JSON lines. \n"
+                << std::endl;
+            return 1;
+        }
+    }
+
+    benchmarkPhysics();
+    benchmarkBallTextures();
+    benchmarkRendering();
+    benchmarkLogging();
+    return 0;
+}
@@ -0,0 +1,92 @@
+
+#include "AimPredictor.hpp"
+
+
+AimPredictor::AimPredictor() :
+    m_Table {},
+    m_ObjectBall {0},
+    m_StepCount {0},
+    m_IsComplete {true},
+    m_CuePath {},
+    m_ObjectPath {}
+{
+    // Enough for a whole prediction, so refining never allocates.
+    m_CuePath.reserve(MAX_STEPS / SAMPLE_INTERVAL + 2);
+    m_ObjectPath.reserve(MAX_STEPS / SAMPLE_INTERVAL + 2);
+
+    // Its steps are timed as a whole, by the game, rather than one by one.
+    m_Table.setInstrumented(false);
+}
+
+
+void AimPredictor::start(const std::vector<Ball>& balls, glm::vec2 force)
+{
+    m_Table.removeAllBalls();
+    for (const auto& ball : balls)
+    {
+        if ( ! ball.m_IsPocketed)
+        {
+            m_Table.addBall(ball.m_Type, ball.position, ball.velocity);
+        }
+    }
+    m_Table.applyForce(0, force);
+
+    m_ObjectBall = 0;
+    m_StepCount = 0;
+    m_IsComplete = false;
+    m_CuePath.clear();
+    m_ObjectPath.clear();
+    sample();
+}
+
+bool AimPredictor::refine(std::chrono::microseconds budget)
+{
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    while ( ! m_IsComplete)
+    {
+        for (uint32_t i = 0; i < STEPS_PER_CHECK && ! m_IsComplete; ++i)
+        {
+            m_Table.step();
+            ++m_StepCount;
+
+            if (m_ObjectBall == 0)
+            {
+                for (const auto& event : m_Table.getEvents())
+                {
+                    if (event.m_Type == TableEventType::BallContact && (event.m_BallIndex == 0 || event.m_Other == 0))
+                    {
+                        m_ObjectBall = (event.m_BallIndex == 0) ? event.m_Other : event.m_BallIndex;
+                        break;
+                    }
+                }
+            }
+
+            m_IsComplete = m_StepCount >= MAX_STEPS || m_Table.isAtRest();
+            if (m_StepCount % SAMPLE_INTERVAL == 0 || m_IsComplete)
+            {
+                sample();
+            }
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+    }
+    return m_IsComplete;
+}
+
+void AimPredictor::sample()
+{
+    const auto& balls = m_Table.getBalls();
+
+    // Paths stop where the ball drops into a pocket.
+    if ( ! balls[0].m_IsPocketed)
+    {
+        m_CuePath.push_back(balls[0].position);
+    }
+    if (m_ObjectBall != 0 && ! balls[m_ObjectBall].m_IsPocketed)
+    {
+        m_ObjectPath.push_back(balls[m_ObjectBall].position);
+    }
+}
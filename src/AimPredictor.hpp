@@ -0,0 +1,65 @@
+
+#ifndef AIM_PREDICTOR_HPP
+#define AIM_PREDICTOR_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "Table.hpp"
+
+
+// Works out where a shot will send the cue ball, and the first ball it
+// hits, by playing the shot out on a private copy of the table.
+//
+// A whole shot is a few thousand steps, which is too much to do in one
+// frame, so it's done a slice at a time with refine(). The paths grow as
+// it goes, and can be drawn before they're finished.
+class AimPredictor
+{
+public:
+    AimPredictor();
+
+    // Start again from `balls` (pocketed ones are left out), with `force`
+    // applied to the cue ball, which must be the first ball.
+    void start(const std::vector<Ball>& balls, glm::vec2 force);
+
+    // Carry on for about `budget`, or until the prediction is finished.
+    // Returns true once it's finished.
+    bool refine(std::chrono::microseconds budget);
+
+    bool isComplete() const { return m_IsComplete; }
+
+    // Sampled positions along each path. The object ball path is empty
+    // until the cue ball hits something.
+    const std::vector<glm::vec2>& getCuePath() const { return m_CuePath; }
+    const std::vector<glm::vec2>& getObjectPath() const { return m_ObjectPath; }
+
+private:
+    void sample();
+
+private:
+    Table m_Table;
+    size_t m_ObjectBall;  // 0 until the cue ball hits something
+    uint32_t m_StepCount;
+    bool m_IsComplete;
+
+    std::vector<glm::vec2> m_CuePath;
+    std::vector<glm::vec2> m_ObjectPath;
+
+    // Give up after this long, even if the balls are still going
+    static const uint32_t MAX_STEPS {4000};
+
+    // Keep a point every this many steps
+    static const uint32_t SAMPLE_INTERVAL {10};
+
+    // How many steps to take between looking at the clock
+    static const uint32_t STEPS_PER_CHECK {16};
+
+};
+
+
+#endif
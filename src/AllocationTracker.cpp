@@ -0,0 +1,192 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>  // for std::max
+#include <array>
+#include <fstream>
+#include <new>
+
+#include "AllocationTracker.hpp"
+
+
+std::atomic<bool> AllocationTracker::s_IsEnabled {false};
+thread_local AllocationSubsystem AllocationTracker::t_Subsystem {AllocationSubsystem::Other};
+
+
+const char* getAllocationSubsystemName(AllocationSubsystem subsystem)
+{
+    switch (subsystem)
+    {
+        case AllocationSubsystem::Other:      return "other";
+        case AllocationSubsystem::Input:      return "input";
+        case AllocationSubsystem::Simulation: return "simulation";
+        case AllocationSubsystem::Render:     return "render";
+    }
+    return "unknown";
+}
+
+
+// Added to from any thread
+struct AllocationCounters
+{
+    std::atomic<uint64_t> m_Count;
+    std::atomic<uint64_t> m_Bytes;
+};
+static std::array<AllocationCounters, ALLOCATION_SUBSYSTEM_COUNT> s_Counters;
+
+static std::atomic<bool> s_IsStrict {false};
+static std::atomic<bool> s_IsArmed {false};  // Strict, and past the warm-up
+
+// Only touched by the main thread
+static std::array<AllocationStats, ALLOCATION_SUBSYSTEM_COUNT> s_Stats;
+static uint64_t s_FrameCount {0};
+
+
+void AllocationTracker::setEnabled(bool isEnabled)
+{
+    s_IsEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+void AllocationTracker::setStrict(bool isStrict)
+{
+    s_IsStrict.store(isStrict, std::memory_order_relaxed);
+    s_IsArmed.store(isStrict && s_FrameCount >= WARM_UP_FRAMES, std::memory_order_relaxed);
+}
+
+void AllocationTracker::record(size_t bytes)
+{
+    const AllocationSubsystem subsystem {t_Subsystem};
+    AllocationCounters& counters = s_Counters[static_cast<size_t>(subsystem)];
+    counters.m_Count.fetch_add(1, std::memory_order_relaxed);
+    counters.m_Bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (s_IsArmed.load(std::memory_order_relaxed) && (
+        subsystem == AllocationSubsystem::Simulation ||
+        subsystem == AllocationSubsystem::Render
+    )) {
+        // Nothing here may allocate, so no iostreams.
+        fprintf(
+            stderr,
+            "Allocated %zu bytes in %s after the warm-up, in strict allocation mode \n",
+            bytes,
+            getAllocationSubsystemName(subsystem)
+        );
+        abort();
+    }
+}
+
+
+void AllocationTracker::endFrame()
+{
+    const bool isSteady {s_FrameCount >= WARM_UP_FRAMES};
+    for (size_t i = 0; i < ALLOCATION_SUBSYSTEM_COUNT; ++i)
+    {
+        AllocationStats& stats = s_Stats[i];
+        const uint64_t count {s_Counters[i].m_Count.load(std::memory_order_relaxed)};
+        const uint64_t bytes {s_Counters[i].m_Bytes.load(std::memory_order_relaxed)};
+        const uint64_t frameCount {count - stats.m_Count};
+        const uint64_t frameBytes {bytes - stats.m_Bytes};
+        stats.m_Count = count;
+        stats.m_Bytes = bytes;
+
+        if (isSteady)
+        {
+            stats.m_SteadyCount += frameCount;
+            stats.m_SteadyBytes += frameBytes;
+            stats.m_SteadyFrameCount += frameCount > 0 ? 1 : 0;
+            stats.m_MaxFrameCount = std::max(stats.m_MaxFrameCount, frameCount);
+            stats.m_MaxFrameBytes = std::max(stats.m_MaxFrameBytes, frameBytes);
+        }
+    }
+
+    ++s_FrameCount;
+    if (s_FrameCount == WARM_UP_FRAMES && s_IsStrict.load(std::memory_order_relaxed))
+    {
+        s_IsArmed.store(true, std::memory_order_relaxed);
+    }
+}
+
+AllocationStats AllocationTracker::getStats(AllocationSubsystem subsystem)
+{
+    return s_Stats[static_cast<size_t>(subsystem)];
+}
+
+bool AllocationTracker::writeCsv(const char* path)
+{
+    // The file's own buffers shouldn't count against any frame.
+    endFrame();
+
+    std::ofstream file {path};
+    if ( ! file)
+    {
+        return false;
+    }
+
+    file << "subsystem,allocations,bytes,steady_allocations,steady_bytes,steady_frames_allocating,steady_frames,max_frame_allocations,max_frame_bytes\n";
+    const uint64_t steadyFrames {s_FrameCount > WARM_UP_FRAMES ? s_FrameCount - WARM_UP_FRAMES : 0};
+    for (size_t i = 0; i < ALLOCATION_SUBSYSTEM_COUNT; ++i)
+    {
+        const AllocationStats& stats = s_Stats[i];
+        file
+            << getAllocationSubsystemName(static_cast<AllocationSubsystem>(i)) << ","
+            << stats.m_Count << ","
+            << stats.m_Bytes << ","
+            << stats.m_SteadyCount << ","
+            << stats.m_SteadyBytes << ","
+            << stats.m_SteadyFrameCount << ","
+            << steadyFrames << ","
+            << stats.m_MaxFrameCount << ","
+            << stats.m_MaxFrameBytes << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+
+// Replacements for the global allocation functions, which count what they
+// hand out. The rest of the standard forms (nothrow, and so on) end up in
+// these.
+
+static void* allocate(size_t size)
+{
+    if (AllocationTracker::isEnabled())
+    {
+        AllocationTracker::record(size);
+    }
+
+    void* pMemory {malloc(size > 0 ? size : 1)};
+    if ( ! pMemory)
+    {
+        throw std::bad_alloc {};
+    }
+    return pMemory;
+}
+
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}
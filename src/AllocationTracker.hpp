@@ -0,0 +1,113 @@
+
+#ifndef ALLOCATION_TRACKER_HPP
+#define ALLOCATION_TRACKER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+
+// What a thread is busy with, for the purpose of blaming it for allocating.
+enum class AllocationSubsystem : uint8_t
+{
+    Other,
+    Input,
+    Simulation,
+    Render,
+};
+static const size_t ALLOCATION_SUBSYSTEM_COUNT {4};
+
+const char* getAllocationSubsystemName(AllocationSubsystem subsystem);
+
+
+struct AllocationStats
+{
+    // Since tracking started
+    uint64_t m_Count;
+    uint64_t m_Bytes;
+
+    // Since the warm-up frames
+    uint64_t m_SteadyCount;
+    uint64_t m_SteadyBytes;
+    uint64_t m_SteadyFrameCount;  // Frames with any allocations at all
+    uint64_t m_MaxFrameCount;
+    uint64_t m_MaxFrameBytes;
+};
+
+
+// Counts what goes through operator new, by subsystem and by frame.
+//
+// The global operator new and delete are replaced so that every allocation
+// is counted (when tracking is on), along with whichever subsystem the
+// allocating thread was in, as set by ALLOCATION_SCOPE. Once a frame,
+// endFrame() works out what each subsystem allocated during it.
+//
+// The first WARM_UP_FRAMES frames are for filling caches and growing
+// buffers. After that, the simulation and rendering shouldn't allocate at
+// all; in strict mode, the process aborts (with a message, and a core dump
+// if it's allowed one) the moment either of them does.
+//
+// When tracking is off, an allocation costs one relaxed load and a branch.
+class AllocationTracker
+{
+public:
+    static bool isEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool isEnabled);
+    static void setStrict(bool isStrict);
+
+    // Called from operator new
+    static void record(size_t bytes);
+
+    static AllocationSubsystem getSubsystem() { return t_Subsystem; }
+    static void setSubsystem(AllocationSubsystem subsystem) { t_Subsystem = subsystem; }
+
+    // Main thread only, from here on.
+    static void endFrame();
+    static AllocationStats getStats(AllocationSubsystem subsystem);
+
+    // One row per subsystem. Returns false if the file couldn't be written.
+    static bool writeCsv(const char* path);
+
+    static const uint64_t WARM_UP_FRAMES {120};
+
+private:
+    static std::atomic<bool> s_IsEnabled;
+    static thread_local AllocationSubsystem t_Subsystem;
+
+};
+
+
+// Blames the current thread's allocations on `subsystem` until the end of
+// the scope.
+class AllocationScope
+{
+public:
+    explicit AllocationScope(AllocationSubsystem subsystem) :
+        m_Previous {AllocationTracker::getSubsystem()}
+    {
+        AllocationTracker::setSubsystem(subsystem);
+    }
+
+    ~AllocationScope()
+    {
+        AllocationTracker::setSubsystem(m_Previous);
+    }
+
+private:
+    AllocationSubsystem m_Previous;
+
+private:
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+};
+
+
+#define ALLOCATION_CONCAT_INNER(a, b) a ## b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_INNER(a, b)
+
+#define ALLOCATION_SCOPE(subsystem) \
+    const AllocationScope ALLOCATION_CONCAT(allocationScope, __LINE__) {AllocationSubsystem::subsystem}
+
+
+#endif
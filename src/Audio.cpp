@@ -0,0 +1,170 @@
+
+#include <cmath>      // for std::sin, std::exp
+#include <algorithm>  // for std::min, std::max
+
+#include "Audio.hpp"
+#include "debug.hpp"
+
+
+AudioMixer::AudioMixer() :
+    m_Device {0},
+    m_Samples {},
+    m_Voices {},
+    m_Requests {}
+{
+}
+
+AudioMixer::~AudioMixer()
+{
+    close();
+}
+
+
+bool AudioMixer::open()
+{
+    LOG("Opening audio device \n");
+
+    SDL_AudioSpec desired {};
+    SDL_AudioSpec obtained {};
+    desired.freq = SAMPLE_RATE;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 1;
+    desired.samples = BUFFER_SAMPLES;
+    desired.callback = &AudioMixer::audioCallback;
+    desired.userdata = this;
+
+    m_Device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (m_Device == 0)
+    {
+        return false;
+    }
+
+    LOG("Audio: %d Hz, %u sample buffer (%.1f ms) \n",
+        obtained.freq, obtained.samples, 1000.0f * obtained.samples / obtained.freq);
+
+    // The device is still paused, so the callback can't see these yet.
+    generateSamples(obtained.freq);
+
+    SDL_PauseAudioDevice(m_Device, 0);
+    return true;
+}
+
+void AudioMixer::close()
+{
+    if (m_Device != 0)
+    {
+        SDL_CloseAudioDevice(m_Device);
+        m_Device = 0;
+    }
+}
+
+
+bool AudioMixer::play(Sound sound, float volume)
+{
+    if (m_Device == 0)
+    {
+        return false;
+    }
+    return m_Requests.push({sound, std::min(std::max(volume, 0.0f), 1.0f)});
+}
+
+
+void AudioMixer::generateSamples(int frequency)
+{
+    const float PI {3.14159265f};
+    const auto rate = static_cast<float>(frequency);
+
+    // Ball click: a short, bright knock that dies away almost immediately.
+    {
+        auto& samples = m_Samples[static_cast<size_t>(Sound::BallClick)];
+        samples.resize(static_cast<size_t>(0.03f * rate));
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            const float t {i / rate};
+            const float envelope {std::exp(-t / 0.004f)};
+            samples[i] = envelope * (
+                0.7f * std::sin(2.0f * PI * 2800.0f * t) +
+                0.3f * std::sin(2.0f * PI * 4300.0f * t)
+            );
+        }
+    }
+
+    // Cushion thud: a low, dull bump with a little bit of noise on top.
+    {
+        auto& samples = m_Samples[static_cast<size_t>(Sound::CushionThud)];
+        samples.resize(static_cast<size_t>(0.09f * rate));
+        uint32_t noiseState {0x1234567u};
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            // xorshift32; any cheap deterministic noise will do.
+            noiseState ^= noiseState << 13;
+            noiseState ^= noiseState >> 17;
+            noiseState ^= noiseState << 5;
+            const float noise {static_cast<float>(noiseState) / 4294967295.0f * 2.0f - 1.0f};
+
+            const float t {i / rate};
+            samples[i] =
+                std::exp(-t / 0.025f) * std::sin(2.0f * PI * 110.0f * t) +
+                0.2f * std::exp(-t / 0.005f) * noise;
+        }
+    }
+}
+
+
+void AudioMixer::audioCallback(void* pUserData, Uint8* pStream, int length)
+{
+    auto pMixer = static_cast<AudioMixer*>(pUserData);
+    pMixer->mix(reinterpret_cast<int16_t*>(pStream), static_cast<size_t>(length) / sizeof(int16_t));
+}
+
+void AudioMixer::mix(int16_t* pOutput, size_t sampleCount)
+{
+    // Start any sounds that were requested since the last buffer.
+    PlayRequest request;
+    while (m_Requests.pop(request))
+    {
+        // Use a free voice if there is one, otherwise cut off whichever
+        // sound has been playing the longest.
+        Voice* pVoice = &m_Voices[0];
+        for (auto& voice : m_Voices)
+        {
+            if ( ! voice.m_pSamples)
+            {
+                pVoice = &voice;
+                break;
+            }
+            if (voice.m_Position > pVoice->m_Position)
+            {
+                pVoice = &voice;
+            }
+        }
+
+        const auto& samples = m_Samples[static_cast<size_t>(request.m_Sound)];
+        pVoice->m_pSamples = samples.data();
+        pVoice->m_Length = samples.size();
+        pVoice->m_Position = 0;
+        pVoice->m_Volume = request.m_Volume;
+    }
+
+    static const float MASTER_VOLUME {0.5f};
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        float value {0.0f};
+        for (auto& voice : m_Voices)
+        {
+            if ( ! voice.m_pSamples)
+            {
+                continue;
+            }
+
+            value += voice.m_Volume * voice.m_pSamples[voice.m_Position];
+            if (++voice.m_Position == voice.m_Length)
+            {
+                voice.m_pSamples = nullptr;
+            }
+        }
+
+        value = std::min(std::max(MASTER_VOLUME * value, -1.0f), 1.0f);
+        pOutput[i] = static_cast<int16_t>(value * 32767.0f);
+    }
+}
@@ -0,0 +1,88 @@
+
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "SpscRing.hpp"
+
+
+enum class Sound : uint8_t
+{
+    BallClick,
+    CushionThud,
+};
+
+static const size_t SOUND_COUNT {2};
+
+
+// Mixes short impact sounds in the SDL audio callback.
+//
+// All of the samples are generated up front when the device is opened.
+// Play requests are passed to the audio thread through a lock-free ring,
+// so neither the game thread nor the audio thread ever waits on the other,
+// and the callback never allocates.
+class AudioMixer
+{
+public:
+    AudioMixer();
+    ~AudioMixer();
+
+    bool open();
+    void close();
+
+    // Queue a sound to start on the next audio buffer. Safe to call from
+    // one (and only one) thread other than the audio thread. Returns false
+    // if the request had to be dropped.
+    bool play(Sound sound, float volume);
+
+    bool isOpen() const { return m_Device != 0; }
+
+private:
+    struct PlayRequest
+    {
+        Sound m_Sound;
+        float m_Volume;
+    };
+
+    struct Voice
+    {
+        const float* m_pSamples;
+        size_t m_Length;
+        size_t m_Position;
+        float m_Volume;
+    };
+
+    void generateSamples(int frequency);
+
+    static void audioCallback(void* pUserData, Uint8* pStream, int length);
+    void mix(int16_t* pOutput, size_t sampleCount);
+
+public:
+    // Keep the device buffer small; at 48 kHz this is about 5 ms.
+    static const uint16_t BUFFER_SAMPLES {256};
+    static const int SAMPLE_RATE {48000};
+
+private:
+    SDL_AudioDeviceID m_Device;
+
+    std::array<std::vector<float>, SOUND_COUNT> m_Samples;
+
+    static const size_t MAX_VOICES {32};
+    std::array<Voice, MAX_VOICES> m_Voices;
+
+    SpscRing<PlayRequest, 256> m_Requests;
+
+private:
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+
+};
+
+
+#endif
@@ -0,0 +1,122 @@
+
+#include <cmath>  // for std::sin
+#include <limits>
+
+#include <glm/geometric.hpp>  // for glm::normalize, glm::distance
+
+#include "AutoPlayer.hpp"
+
+
+constexpr float AutoPlayer::SHOT_STRENGTH;
+
+
+AutoPlayer::AutoPlayer(uint32_t seed) :
+    m_Table {},
+    m_Rules {},
+    m_RestingSince {0},
+    m_PowerPhase {0.7f * seed}
+{
+}
+
+
+void AutoPlayer::rack()
+{
+    m_Table.rackBalls();
+    m_Rules.rack();
+    m_RestingSince = m_Table.getStepCount();
+}
+
+void AutoPlayer::step()
+{
+    const uint64_t restingFor {m_Table.getStepCount() - m_RestingSince};
+    if (m_Rules.isGameOver())
+    {
+        // Leave the last shot up for a bit, then play again.
+        if (restingFor >= NEW_GAME_STEPS)
+        {
+            rack();
+        }
+    }
+    else if ( ! m_Rules.isShotInProgress() && m_Table.isAtRest() && restingFor >= PAUSE_STEPS)
+    {
+        takeShot();
+    }
+
+    m_Table.step();
+
+    if (m_Rules.isShotInProgress())
+    {
+        m_Rules.consume(m_Table.getEvents(), m_Table.getBalls());
+        if (m_Table.isAtRest())
+        {
+            finishShot();
+        }
+    }
+}
+
+void AutoPlayer::takeShot()
+{
+    // Aim at the nearest ball it's legal to hit first: one from our own
+    // group, or anything but the black on an open table. Once the group is
+    // gone, that leaves the black.
+    const auto& balls = m_Table.getBalls();
+    const glm::vec2 cuePosition {balls[0].position};
+    const BallGroup group {m_Rules.getPlayerGroup(m_Rules.getCurrentPlayer())};
+
+    size_t target {0};
+    float targetDistance {std::numeric_limits<float>::max()};
+    for (int pass = 0; pass < 2 && target == 0; ++pass)
+    {
+        const bool allowBlack {pass == 1};
+        for (size_t i = 1; i < balls.size(); ++i)
+        {
+            const Ball& ball = balls[i];
+            if (ball.m_IsPocketed)
+            {
+                continue;
+            }
+
+            const BallGroup ballGroup {getBallGroup(ball.m_Type)};
+            const bool isCandidate {
+                ball.m_Type == BallType::Black ? allowBlack :
+                (group == BallGroup::None || ballGroup == group)
+            };
+            const float distance {glm::distance(cuePosition, ball.position)};
+            if (isCandidate && distance < targetDistance)
+            {
+                target = i;
+                targetDistance = distance;
+            }
+        }
+    }
+    if (target == 0)
+    {
+        return;
+    }
+
+    const glm::vec2 direction {glm::normalize(balls[target].position - cuePosition)};
+    m_Rules.beginShot();
+    m_Table.applyForce(0, direction * SHOT_STRENGTH * (0.5f + 0.5f * getShotPower()));
+}
+
+void AutoPlayer::finishShot()
+{
+    const ShotResult result = m_Rules.endShot();
+    if (result.m_ReRack)
+    {
+        // The rules have already started again; the balls haven't.
+        m_Table.rackBalls();
+    }
+    else if (result.m_CueBallPocketed)
+    {
+        m_Table.respotBall(0, Table::getCueSpot());
+    }
+    m_RestingSince = m_Table.getStepCount();
+}
+
+float AutoPlayer::getShotPower() const
+{
+    // The same swing as the power bar in the game
+    const float time {m_Table.getStepCount() * 0.001f};
+    return 0.5f * (std::sin(8 * time + m_PowerPhase) + 1.0f);
+}
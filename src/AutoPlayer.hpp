@@ -0,0 +1,53 @@
+
+#ifndef AUTO_PLAYER_HPP
+#define AUTO_PLAYER_HPP
+
+#include <stdint.h>
+
+#include "Table.hpp"
+#include "Rules.hpp"
+
+
+// A game of 8-ball that plays itself: whenever the balls have been still
+// for a moment, it shoots at the nearest ball it's allowed to hit, with
+// whatever the (swinging) power is at the time.
+//
+// Games with different seeds swing the power out of step with each other,
+// so they soon go their own ways.
+class AutoPlayer
+{
+public:
+    explicit AutoPlayer(uint32_t seed = 0);
+
+    void rack();
+    void step();
+
+    // From 0 to 1, like the power bar in the game
+    float getShotPower() const;
+
+    const Table& getTable() const { return m_Table; }
+    const EightBallRules& getRules() const { return m_Rules; }
+
+private:
+    void takeShot();
+    void finishShot();
+
+private:
+    Table m_Table;
+    EightBallRules m_Rules;
+    uint64_t m_RestingSince;  // Step count when the balls last stopped
+    float m_PowerPhase;
+
+    // Wait this long between shots, so it's easier to follow (half a
+    // second at the game's step rate), and a while longer after a game
+    // before racking up the next one.
+    static const uint32_t PAUSE_STEPS {200};
+    static const uint32_t NEW_GAME_STEPS {4 * PAUSE_STEPS};
+
+    // Force for a shot at full power
+    static constexpr float SHOT_STRENGTH {20.0f};
+
+};
+
+
+#endif
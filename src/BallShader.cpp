@@ -0,0 +1,169 @@
+
+#include <algorithm>  // for std::min, std::max
+#include <cmath>      // for std::sqrt, std::fabs
+#include <cstring>    // for std::memcpy
+
+#include <glm/mat3x3.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "BallShader.hpp"
+#include "BallSprite.hpp"
+
+
+// The white bands of a stripe are everything further than this from the
+// middle of the ball, side to side (as on the flat sprites).
+static const float STRIPE_EDGE {1.0f / 3.0f};
+
+// The number spot covers about 25 degrees around the ball's own -z axis,
+// which faces the camera when the ball hasn't rolled yet.
+static const float SPOT_COSINE {0.9f};
+static const float SPOT_SINE {0.436f};
+
+static const uint8_t CUE_SPOT_COLOR[3] {200, 16, 16};
+
+
+BallShader::BallShader(int diameter) :
+    m_Diameter {diameter},
+    m_Stride {(diameter + 3) & ~3},
+    m_NormalX(m_Stride * diameter),
+    m_NormalY(m_Stride * diameter),
+    m_NormalZ(m_Stride * diameter),
+    m_Brightness(m_Stride * diameter),
+    m_Alpha(m_Stride * diameter)
+{
+    const float radius {diameter / 2.0f};
+    for (int y = 0; y < diameter; ++y)
+    {
+        for (int x = 0; x < diameter; ++x)
+        {
+            const int i {y * m_Stride + x};
+
+            // Pixels right on the rim may have their middle just outside
+            // the ball, so pull those back onto the edge.
+            float nx {(x + 0.5f - radius) / radius};
+            float ny {(y + 0.5f - radius) / radius};
+            const float r2 {nx * nx + ny * ny};
+            if (r2 > 1.0f)
+            {
+                const float length {std::sqrt(r2)};
+                nx /= length;
+                ny /= length;
+            }
+            m_NormalX[i] = nx;
+            m_NormalY[i] = ny;
+            m_NormalZ[i] = -std::sqrt(std::max(0.0f, 1.0f - nx * nx - ny * ny));
+
+            const BallSpriteCoverage coverage {getBallSpriteCoverage(diameter, x, y)};
+            m_Brightness[i] = static_cast<float>(BALL_SPRITE_SAMPLES - coverage.m_Edge) / BALL_SPRITE_SAMPLES;
+            m_Alpha[i] = static_cast<uint32_t>(coverage.m_Disc) << 24;
+        }
+    }
+
+    // The padding at the end of each row is left as fully transparent, and
+    // is never written out anyway.
+}
+
+
+void BallShader::shade(uint8_t* pPixels, int pitch, BallType type, const glm::quat& orientation) const
+{
+    const BallColorProfile profile {getBallColorProfile(type)};
+    const bool isCueBall {type == BallType::Cue};
+    const float base[3] {
+        static_cast<float>(profile.r),
+        static_cast<float>(profile.g),
+        static_cast<float>(profile.b),
+    };
+    const float spot[3] {
+        isCueBall ? static_cast<float>(CUE_SPOT_COLOR[0]) : 255.0f,
+        isCueBall ? static_cast<float>(CUE_SPOT_COLOR[1]) : 255.0f,
+        isCueBall ? static_cast<float>(CUE_SPOT_COLOR[2]) : 255.0f,
+    };
+
+    // Edges of the stripe and spot are blended over about a pixel, so they
+    // don't come out jagged.
+    const float radius {m_Diameter / 2.0f};
+    const float stripeSharpness {profile.hasStripe ? radius : 0.0f};
+    const float stripeOffset {profile.hasStripe ? 0.5f : 0.0f};
+    const float spotSharpness {radius / SPOT_SINE};
+
+    // Turning the table's frame into the ball's is the inverse of the
+    // ball's orientation. The matrix is column major, so m[column][row].
+    const glm::mat3 m {glm::mat3_cast(glm::conjugate(orientation))};
+
+    for (int y = 0; y < m_Diameter; ++y)
+    {
+        uint8_t* pRow = pPixels + y * pitch;
+        for (int x = 0; x < m_Diameter; x += 4)
+        {
+            const int i {y * m_Stride + x};
+            uint32_t out[4];
+
+#ifdef __SSE2__
+            const __m128 nx {_mm_loadu_ps(&m_NormalX[i])};
+            const __m128 ny {_mm_loadu_ps(&m_NormalY[i])};
+            const __m128 nz {_mm_loadu_ps(&m_NormalZ[i])};
+            auto rotate = [&](int row)
+            {
+                return _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), nx), _mm_mul_ps(_mm_set1_ps(m[1][row]), ny)),
+                    _mm_mul_ps(_mm_set1_ps(m[2][row]), nz)
+                );
+            };
+            const __m128 px {rotate(0)};
+            const __m128 pz {rotate(2)};
+
+            const __m128 zero {_mm_setzero_ps()};
+            const __m128 one {_mm_set1_ps(1.0f)};
+            const __m128 absX {_mm_andnot_ps(_mm_set1_ps(-0.0f), px)};
+            const __m128 stripe {_mm_min_ps(one, _mm_max_ps(zero, _mm_add_ps(
+                _mm_mul_ps(_mm_sub_ps(absX, _mm_set1_ps(STRIPE_EDGE)), _mm_set1_ps(stripeSharpness)),
+                _mm_set1_ps(stripeOffset)
+            )))};
+            const __m128 spotCover {_mm_min_ps(one, _mm_max_ps(zero, _mm_add_ps(
+                _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, pz), _mm_set1_ps(SPOT_COSINE)), _mm_set1_ps(spotSharpness)),
+                _mm_set1_ps(0.5f)
+            )))};
+            const __m128 brightness {_mm_loadu_ps(&m_Brightness[i])};
+
+            __m128i result {_mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_Alpha[i]))};
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                const __m128 b {_mm_set1_ps(base[channel])};
+                __m128 c {_mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(255.0f), b), stripe))};
+                c = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(spot[channel]), c), spotCover));
+                c = _mm_mul_ps(c, brightness);
+                result = _mm_or_si128(result, _mm_slli_epi32(_mm_cvtps_epi32(c), 16 - 8 * channel));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+#else
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                const int j {i + lane};
+                const float nx {m_NormalX[j]};
+                const float ny {m_NormalY[j]};
+                const float nz {m_NormalZ[j]};
+                const float px {m[0][0] * nx + m[1][0] * ny + m[2][0] * nz};
+                const float pz {m[0][2] * nx + m[1][2] * ny + m[2][2] * nz};
+
+                const float stripe {std::min(1.0f, std::max(0.0f, (std::fabs(px) - STRIPE_EDGE) * stripeSharpness + stripeOffset))};
+                const float spotCover {std::min(1.0f, std::max(0.0f, (-pz - SPOT_COSINE) * spotSharpness + 0.5f))};
+
+                uint32_t pixel {m_Alpha[j]};
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    float c {base[channel] + (255.0f - base[channel]) * stripe};
+                    c += (spot[channel] - c) * spotCover;
+                    c *= m_Brightness[j];
+                    pixel |= static_cast<uint32_t>(c + 0.5f) << (16 - 8 * channel);
+                }
+                out[lane] = pixel;
+            }
+#endif
+
+            std::memcpy(pRow + 4 * x, out, 4 * std::min(4, m_Diameter - x));
+        }
+    }
+}
@@ -0,0 +1,46 @@
+
+#ifndef BALL_SHADER_HPP
+#define BALL_SHADER_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Table.hpp"
+
+
+// Draws balls as spheres, turned however far they've rolled.
+//
+// The sphere's surface normal under every pixel of the sprite is worked
+// out once, when the shader is made. Shading a ball is then just a
+// rotation of each normal into the ball's own frame, and a look at what's
+// painted there: the colour, the white of a stripe, and the spot where the
+// number would be (the cue ball gets a red one). With SSE2 that's four
+// pixels at a time, and all sixteen balls take well under a millisecond.
+class BallShader
+{
+public:
+    explicit BallShader(int diameter);
+
+    int getDiameter() const { return m_Diameter; }
+
+    // Write a diameter-square sprite of ARGB8888 pixels, with rows `pitch`
+    // bytes apart.
+    void shade(uint8_t* pPixels, int pitch, BallType type, const glm::quat& orientation) const;
+
+private:
+    int m_Diameter;
+    int m_Stride;  // Pixels per row in the tables, rounded up to a multiple of 4
+
+    // One entry per pixel, m_Stride to a row
+    std::vector<float> m_NormalX;
+    std::vector<float> m_NormalY;
+    std::vector<float> m_NormalZ;
+    std::vector<float> m_Brightness;  // Darkened towards the edge ring
+    std::vector<uint32_t> m_Alpha;    // Already shifted into place
+
+};
+
+
+#endif
@@ -0,0 +1,186 @@
+
+#include <cstring>  // for std::memcpy
+
+#include "BallSprite.hpp"
+#include "debug.hpp"
+
+
+void tintBallSprite(
+    const uint8_t* pDisc,
+    const uint8_t* pEdge,
+    const uint8_t* pStripe,
+    int diameter,
+    uint8_t* pPixels,
+    int pitch,
+    uint8_t red,
+    uint8_t green,
+    uint8_t blue,
+    bool hasStripe
+)
+{
+    // The edge and stripe masks only have a handful of distinct levels, so
+    // work out the colour for every combination of them once up front.
+    // Each pixel is then just a lookup.
+    const int LEVELS {BALL_SPRITE_SAMPLES + 1};
+    uint32_t palette[LEVELS][LEVELS];
+    for (int stripe = 0; stripe < LEVELS; ++stripe)
+    {
+        for (int edge = 0; edge < LEVELS; ++edge)
+        {
+            // Blend towards white over the stripes, then towards black
+            // over the edge ring.
+            auto shade = [stripe, edge, hasStripe](int channel)
+            {
+                const int striped {hasStripe ? channel + (255 - channel) * stripe / BALL_SPRITE_SAMPLES : channel};
+                return static_cast<uint32_t>(striped * (BALL_SPRITE_SAMPLES - edge) / BALL_SPRITE_SAMPLES);
+            };
+            palette[stripe][edge] = (shade(red) << 16) | (shade(green) << 8) | shade(blue);
+        }
+    }
+
+    for (int y = 0; y < diameter; ++y)
+    {
+        uint8_t* pRow = pPixels + y * pitch;
+        for (int x = 0; x < diameter; ++x)
+        {
+            const int i {y * diameter + x};
+            const uint32_t pixel {(static_cast<uint32_t>(pDisc[i]) << 24) | palette[pStripe[i]][pEdge[i]]};
+            std::memcpy(pRow + 4 * x, &pixel, sizeof(pixel));
+        }
+    }
+}
+
+
+BallAtlas::BallAtlas() :
+    m_SpriteSize {0},
+    m_Width {0},
+    m_Height {0},
+    m_Pixels {},
+    m_BallSpriteX {},
+    m_PocketSpriteX {0}
+{
+}
+
+
+// The coverage masks for one size of sprite, in one block of memory.
+class BallSpriteMaskSet
+{
+public:
+    explicit BallSpriteMaskSet(int diameter) :
+        m_Diameter {diameter},
+        m_Storage {},
+        m_pDisc {nullptr},
+        m_pEdge {nullptr},
+        m_pStripe {nullptr}
+    {
+        // The masks are worked out by the compiler for the usual size, so
+        // all that's left to do at startup is to colour them in.
+        static constexpr BallSpriteMasks<Table::BALL_DIAMETER> MASKS {};
+        if (diameter == Table::BALL_DIAMETER)
+        {
+            m_pDisc = MASKS.m_Disc;
+            m_pEdge = MASKS.m_Edge;
+            m_pStripe = MASKS.m_Stripe;
+            return;
+        }
+
+        const int area {diameter * diameter};
+        m_Storage.resize(3 * area);
+        for (int y = 0; y < diameter; ++y)
+        {
+            for (int x = 0; x < diameter; ++x)
+            {
+                const BallSpriteCoverage coverage {getBallSpriteCoverage(diameter, x, y)};
+                m_Storage[y * diameter + x] = coverage.m_Disc;
+                m_Storage[area + y * diameter + x] = coverage.m_Edge;
+                m_Storage[2 * area + y * diameter + x] = coverage.m_Stripe;
+            }
+        }
+        m_pDisc = m_Storage.data();
+        m_pEdge = m_pDisc + area;
+        m_pStripe = m_pEdge + area;
+    }
+
+    void draw(uint32_t* pPixels, int pitch, uint8_t red, uint8_t green, uint8_t blue, bool hasStripe) const
+    {
+        LOG("Drawing ball sprite: red=%u, green=%u, blue=%u, hasStripe=%s \n", red, green, blue, BOOL_STRING(hasStripe));
+
+        tintBallSprite(
+            m_pDisc,
+            m_pEdge,
+            m_pStripe,
+            m_Diameter,
+            reinterpret_cast<uint8_t*>(pPixels),
+            pitch,
+            red,
+            green,
+            blue,
+            hasStripe
+        );
+    }
+
+private:
+    int m_Diameter;
+    std::vector<uint8_t> m_Storage;
+    const uint8_t* m_pDisc;
+    const uint8_t* m_pEdge;
+    const uint8_t* m_pStripe;
+
+private:
+    BallSpriteMaskSet(const BallSpriteMaskSet&) = delete;
+    BallSpriteMaskSet& operator=(const BallSpriteMaskSet&) = delete;
+
+};
+
+BallColorProfile getBallColorProfile(BallType type)
+{
+    switch (type)
+    {
+        case BallType::Cue:          return BallColorProfile {255, 255, 255, false};
+        case BallType::Black:        return BallColorProfile {0,   0,   0,   false};
+
+        case BallType::Yellow:       return BallColorProfile {255, 204, 0,   false};
+        case BallType::Blue:         return BallColorProfile {0,   51,  153, false};
+        case BallType::Red:          return BallColorProfile {255, 0,   0,   false};
+        case BallType::Purple:       return BallColorProfile {61,  0,   153, false};
+        case BallType::Orange:       return BallColorProfile {255, 51,  0,   false};
+        case BallType::Green:        return BallColorProfile {0,   77,  0,   false};
+        case BallType::Maroon:       return BallColorProfile {153, 0,   0,   false};
+
+        case BallType::YellowStripe: return BallColorProfile {255, 204, 0,   true};
+        case BallType::BlueStripe:   return BallColorProfile {0,   51,  153, true};
+        case BallType::RedStripe:    return BallColorProfile {255, 0,   0,   true};
+        case BallType::PurpleStripe: return BallColorProfile {61,  0,   153, true};
+        case BallType::OrangeStripe: return BallColorProfile {255, 51,  0,   true};
+        case BallType::GreenStripe:  return BallColorProfile {0,   77,  0,   true};
+        case BallType::MaroonStripe: return BallColorProfile {153, 0,   0,   true};
+    }
+    return BallColorProfile {255, 255, 255, false};
+}
+
+BallAtlas buildBallAtlas(int spriteSize)
+{
+    const BallSpriteMaskSet masks {spriteSize};
+
+    BallAtlas atlas;
+    atlas.m_SpriteSize = spriteSize;
+    atlas.m_Width = spriteSize * static_cast<int>(BALL_TYPE_COUNT + 1);
+    atlas.m_Height = spriteSize;
+    atlas.m_Pixels.resize(atlas.m_Width * atlas.m_Height);
+    const int PITCH {4 * atlas.m_Width};
+
+    int spriteX {0};
+    for (size_t i = 0; i < BALL_TYPE_COUNT; ++i)
+    {
+        const BallColorProfile profile {getBallColorProfile(static_cast<BallType>(i))};
+        masks.draw(&atlas.m_Pixels[spriteX], PITCH, profile.r, profile.g, profile.b, profile.hasStripe);
+        atlas.m_BallSpriteX[i] = spriteX;
+        spriteX += spriteSize;
+    }
+
+    // Pockets are just big, dark balls.
+    masks.draw(&atlas.m_Pixels[spriteX], PITCH, 16, 14, 14, false);
+    atlas.m_PocketSpriteX = spriteX;
+
+    return atlas;
+}
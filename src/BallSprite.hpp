@@ -0,0 +1,134 @@
+
+#ifndef BALL_SPRITE_HPP
+#define BALL_SPRITE_HPP
+
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include "Table.hpp"
+
+
+// Every pixel is split into a grid of this many samples on each side.
+static const int BALL_SPRITE_SUPERSAMPLES {4};
+static const int BALL_SPRITE_SAMPLES {BALL_SPRITE_SUPERSAMPLES * BALL_SPRITE_SUPERSAMPLES};
+
+// How much of a sprite pixel is covered by each part of a ball. Each pixel
+// is supersampled, so the edges come out anti-aliased.
+struct BallSpriteCoverage
+{
+    uint8_t m_Disc;    // The whole ball, from 0 to 255; this becomes the alpha channel
+    uint8_t m_Edge;    // Samples (out of BALL_SPRITE_SAMPLES) in the dark ring around the outside
+    uint8_t m_Stripe;  // Samples in the white bands on either side of a striped ball
+};
+
+// Width of the dark ring around the edge of the ball, in pixels, for a
+// sprite of Table::BALL_DIAMETER. Bigger sprites get a wider ring.
+static constexpr float BALL_SPRITE_EDGE_WIDTH {3.0f};
+
+constexpr BallSpriteCoverage getBallSpriteCoverage(int diameter, int x, int y)
+{
+    const float radius {diameter / 2.0f};
+    const float edgeRadius {radius - BALL_SPRITE_EDGE_WIDTH * diameter / Table::BALL_DIAMETER};
+    const float stripeInner {radius - diameter / 3.0f};
+
+    int disc {0};
+    int edge {0};
+    int stripe {0};
+    for (int sy = 0; sy < BALL_SPRITE_SUPERSAMPLES; ++sy)
+    {
+        for (int sx = 0; sx < BALL_SPRITE_SUPERSAMPLES; ++sx)
+        {
+            // Offset from the center of the ball to the middle of the sample
+            const float dx {x + (sx + 0.5f) / BALL_SPRITE_SUPERSAMPLES - radius};
+            const float dy {y + (sy + 0.5f) / BALL_SPRITE_SUPERSAMPLES - radius};
+            const float r2 {dx * dx + dy * dy};
+
+            disc += (r2 <= radius * radius) ? 1 : 0;
+            edge += (r2 >= edgeRadius * edgeRadius) ? 1 : 0;
+            stripe += (dx < -stripeInner || dx > stripeInner) ? 1 : 0;
+        }
+    }
+
+    return BallSpriteCoverage {
+        static_cast<uint8_t>(disc * 255 / BALL_SPRITE_SAMPLES),
+        static_cast<uint8_t>(edge),
+        static_cast<uint8_t>(stripe),
+    };
+}
+
+
+// Coverage masks for a ball sprite of a fixed size. Declare one of these
+// constexpr and the whole thing is worked out by the compiler, leaving
+// only the tinting to be done at startup.
+template<int DIAMETER>
+struct BallSpriteMasks
+{
+    uint8_t m_Disc[DIAMETER * DIAMETER];
+    uint8_t m_Edge[DIAMETER * DIAMETER];
+    uint8_t m_Stripe[DIAMETER * DIAMETER];
+
+    constexpr BallSpriteMasks() :
+        m_Disc {},
+        m_Edge {},
+        m_Stripe {}
+    {
+        for (int y = 0; y < DIAMETER; ++y)
+        {
+            for (int x = 0; x < DIAMETER; ++x)
+            {
+                const BallSpriteCoverage coverage {getBallSpriteCoverage(DIAMETER, x, y)};
+                m_Disc[y * DIAMETER + x] = coverage.m_Disc;
+                m_Edge[y * DIAMETER + x] = coverage.m_Edge;
+                m_Stripe[y * DIAMETER + x] = coverage.m_Stripe;
+            }
+        }
+    }
+};
+
+
+struct BallColorProfile
+{
+    uint8_t r, g, b;
+    bool hasStripe;
+};
+
+BallColorProfile getBallColorProfile(BallType type);
+
+
+// Colour in a sprite from its masks, writing ARGB8888 pixels.
+void tintBallSprite(
+    const uint8_t* pDisc,
+    const uint8_t* pEdge,
+    const uint8_t* pStripe,
+    int diameter,
+    uint8_t* pPixels,
+    int pitch,
+    uint8_t red,
+    uint8_t green,
+    uint8_t blue,
+    bool hasStripe
+);
+
+
+// Every ball sprite, plus one for the pockets, side by side in a single row
+// of ARGB8888 pixels. Each sprite is m_SpriteSize square.
+struct BallAtlas
+{
+    int m_SpriteSize;
+    int m_Width;
+    int m_Height;
+    std::vector<uint32_t> m_Pixels;
+    std::array<int, BALL_TYPE_COUNT> m_BallSpriteX;  // Left edge of each ball's sprite, by BallType
+    int m_PocketSpriteX;
+
+    BallAtlas();
+};
+
+// Sprites of Table::BALL_DIAMETER come from masks worked out at compile
+// time. Any other size (for a scaled up window, say) is rasterised here
+// and now, which takes a few milliseconds.
+BallAtlas buildBallAtlas(int spriteSize = Table::BALL_DIAMETER);
+
+
+#endif
@@ -0,0 +1,111 @@
+
+#include <algorithm>  // for std::min
+
+#include <glm/gtc/quaternion.hpp>     // for glm::equal
+#include <glm/vector_relational.hpp>  // for glm::all
+
+#include "BallTexture.hpp"
+#include "debug.hpp"
+
+
+BallTexture::BallTexture() :
+    m_pTexture {nullptr},
+    m_SpriteSize {0},
+    m_pShader {},
+    m_IsShaded {},
+    m_ShadedTypes {},
+    m_ShadedOrientations {}
+{
+}
+
+BallTexture::~BallTexture()
+{
+    destroy();
+}
+
+
+bool BallTexture::create(SDL_Renderer* pRenderer, const std::shared_ptr<const BallShader>& pShader)
+{
+    if ( ! pShader)
+    {
+        return false;
+    }
+
+    const int spriteSize {pShader->getDiameter()};
+    if (m_pTexture && spriteSize == m_SpriteSize)
+    {
+        return true;
+    }
+    destroy();
+
+    LOG("Creating %d pixel rolling ball texture \n", spriteSize);
+
+    m_pTexture = SDL_CreateTexture(
+        pRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        spriteSize * static_cast<int>(BALL_TYPE_COUNT),
+        spriteSize
+    );
+    if ( ! m_pTexture)
+    {
+        return false;
+    }
+    SDL_SetTextureBlendMode(m_pTexture, SDL_BLENDMODE_BLEND);
+
+    m_SpriteSize = spriteSize;
+    m_pShader = pShader;
+    return true;
+}
+
+void BallTexture::destroy()
+{
+    SDL_DestroyTexture(m_pTexture);
+    m_pTexture = nullptr;
+
+    // Whatever was in the texture is gone.
+    m_IsShaded.fill(false);
+}
+
+
+void BallTexture::update(const std::vector<Ball>& balls)
+{
+    if ( ! m_pTexture)
+    {
+        return;
+    }
+
+    const size_t count {std::min(balls.size(), BALL_TYPE_COUNT)};
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Ball& ball = balls[i];
+        if (ball.m_IsPocketed)
+        {
+            continue;
+        }
+
+        if (m_IsShaded[i] &&
+            ball.m_Type == m_ShadedTypes[i] &&
+            glm::all(glm::equal(ball.m_Orientation, m_ShadedOrientations[i])))
+        {
+            continue;
+        }
+
+        // Each sprite is locked on its own, so only the ones that changed
+        // get uploaded. Locked pixels are write-only, but the whole sprite
+        // is drawn over anyway.
+        const SDL_Rect rect {getSpriteRect(i)};
+        void* pPixels;
+        int pitch;
+        if (SDL_LockTexture(m_pTexture, &rect, &pPixels, &pitch) != 0)
+        {
+            continue;
+        }
+        m_pShader->shade(static_cast<uint8_t*>(pPixels), pitch, ball.m_Type, ball.m_Orientation);
+        SDL_UnlockTexture(m_pTexture);
+
+        m_IsShaded[i] = true;
+        m_ShadedTypes[i] = ball.m_Type;
+        m_ShadedOrientations[i] = ball.m_Orientation;
+    }
+}
@@ -0,0 +1,60 @@
+
+#ifndef BALL_TEXTURE_HPP
+#define BALL_TEXTURE_HPP
+
+#include <stddef.h>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "Table.hpp"
+#include "BallShader.hpp"
+
+
+// A sprite for each ball, side by side in a streaming texture, showing the
+// ball turned however far it's rolled. Only balls that have turned since
+// they were last drawn get shaded again, so a table at rest costs nothing.
+class BallTexture
+{
+public:
+    BallTexture();
+    ~BallTexture();
+
+    // (Re)create the texture for sprites of the shader's diameter, and
+    // shade them with it. Does nothing if it's already that size.
+    bool create(SDL_Renderer* pRenderer, const std::shared_ptr<const BallShader>& pShader);
+    void destroy();
+
+    // Bring each ball's sprite up to date. Ball i is drawn from
+    // getSpriteRect(i).
+    void update(const std::vector<Ball>& balls);
+
+    SDL_Texture* getTexture() const { return m_pTexture; }
+    int getWidth() const { return m_SpriteSize * static_cast<int>(BALL_TYPE_COUNT); }
+    int getHeight() const { return m_SpriteSize; }
+
+    SDL_Rect getSpriteRect(size_t ballIndex) const
+    {
+        return SDL_Rect {static_cast<int>(ballIndex) * m_SpriteSize, 0, m_SpriteSize, m_SpriteSize};
+    }
+
+private:
+    SDL_Texture* m_pTexture;
+    int m_SpriteSize;
+    std::shared_ptr<const BallShader> m_pShader;
+
+    // Each sprite as it was last shaded
+    std::array<bool, BALL_TYPE_COUNT> m_IsShaded;
+    std::array<BallType, BALL_TYPE_COUNT> m_ShadedTypes;
+    std::array<glm::quat, BALL_TYPE_COUNT> m_ShadedOrientations;
+
+private:
+    BallTexture(const BallTexture&) = delete;
+    BallTexture& operator=(const BallTexture&) = delete;
+
+};
+
+
+#endif
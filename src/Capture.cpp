@@ -0,0 +1,93 @@
+
+#include <cstring>   // for std::strlen, std::strcmp
+#include <chrono>
+#include <iostream>
+
+#include "Capture.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
+#include "Telemetry.hpp"
+#include "StateExport.hpp"
+#include "debug.hpp"
+
+
+Capture::Capture(const GameOptions& options) :
+    m_Options {options},
+    m_Player {},
+    m_Compositor {},
+    m_Writer {}
+{
+}
+
+
+bool Capture::run()
+{
+    const char* path {m_Options.m_pCapturePath};
+    const size_t length {std::strlen(path)};
+    const bool isY4M {length >= 4 && std::strcmp(path + length - 4, ".y4m") == 0};
+    const int frameRate {m_Options.m_CaptureFrameRate};
+
+    if ( ! m_Writer.open(
+        path,
+        isY4M ? CaptureFormat::Y4M : CaptureFormat::PPM,
+        SoftwareCompositor::WIDTH,
+        SoftwareCompositor::HEIGHT,
+        frameRate
+    )) {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    m_Player.rack();
+    const Table& table = m_Player.getTable();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto frameCount = static_cast<uint64_t>(m_Options.m_CaptureSeconds * frameRate);
+    uint64_t frame {0};
+    for ( ; frame < frameCount && ! m_Player.getRules().isGameOver(); ++frame)
+    {
+        TRACE_SCOPE("frame", "frame");
+
+        // Work out each frame's step from scratch, so rounding never builds up.
+        const uint64_t frameStep {frame * Game::STEPS_PER_SECOND / frameRate};
+        {
+            ALLOCATION_SCOPE(Simulation);
+            while (table.getStepCount() < frameStep)
+            {
+                m_Player.step();
+                StateExport::publish(table);
+            }
+        }
+
+        uint32_t* pPixels {m_Writer.beginFrame()};
+        {
+            ALLOCATION_SCOPE(Render);
+            m_Compositor.renderFrame(pPixels, table.getBalls(), m_Player.getShotPower());
+        }
+        m_Writer.endFrame();
+        Profiler::collect();
+        Tracer::writeIfRequested();
+        AllocationTracker::endFrame();
+        Telemetry::publish(table.getStats(), table.getStepCount());
+    }
+
+    m_Writer.close();
+
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+    const double videoSeconds {static_cast<double>(frame) / frameRate};
+    std::cout
+        << "Captured " << frame << " frames (" << videoSeconds << " s) in " << elapsed.count() << " s, "
+        << videoSeconds / elapsed.count() << "x real time, "
+        << m_Writer.getStallCount() << " stalls waiting for the writer"
+        << std::endl;
+
+    if (m_Writer.hasFailed())
+    {
+        std::cerr << "Could not write all of the frames to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
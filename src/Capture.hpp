@@ -0,0 +1,39 @@
+
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <stdint.h>
+
+#include "Game.hpp"
+#include "AutoPlayer.hpp"
+#include "Compositor.hpp"
+#include "FrameWriter.hpp"
+
+
+// Plays a game of 8-ball by itself, with no window, and records it.
+//
+// The table is stepped as fast as the frames can be drawn, at the same
+// STEPS_PER_SECOND as the game, so the video plays back at the speed the
+// game would. Frames are drawn by the software compositor straight into
+// the writer's buffers, and converted and written out on its thread.
+class Capture
+{
+public:
+    explicit Capture(const GameOptions& options);
+
+    bool run();
+
+private:
+    GameOptions m_Options;
+    AutoPlayer m_Player;
+    SoftwareCompositor m_Compositor;
+    FrameWriter m_Writer;
+
+private:
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+};
+
+
+#endif
@@ -0,0 +1,307 @@
+
+#include <algorithm>  // for std::min, std::max, std::copy
+#include <cmath>      // for std::lround
+#include <cstdlib>    // for std::abs
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Compositor.hpp"
+#include "Game.hpp"
+#include "Profiler.hpp"
+
+
+const int SoftwareCompositor::WIDTH {Game::WINDOW_WIDTH};
+const int SoftwareCompositor::HEIGHT {Game::WINDOW_HEIGHT};
+
+
+static inline uint32_t blendPixel(uint32_t dest, uint32_t source)
+{
+    const uint32_t alpha {source >> 24};
+    uint32_t result {0xff000000};
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        const uint32_t s {(source >> shift) & 0xff};
+        const uint32_t d {(dest >> shift) & 0xff};
+        uint32_t t {s * alpha + d * (255 - alpha) + 128};
+        t = (t + (t >> 8)) >> 8;
+        result |= t << shift;
+    }
+    return result;
+}
+
+void blendSpan(uint32_t* pDest, const uint32_t* pSource, int count)
+{
+    int i {0};
+
+#ifdef __SSE2__
+    // Four pixels at a time, with each channel widened to 16 bits so the
+    // products don't overflow.
+    const __m128i zero {_mm_setzero_si128()};
+    const __m128i all255 {_mm_set1_epi16(255)};
+    const __m128i round {_mm_set1_epi16(128)};
+    const __m128i opaque {_mm_set1_epi32(static_cast<int>(0xff000000))};
+    for ( ; i + 4 <= count; i += 4)
+    {
+        const __m128i source {_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i))};
+        const __m128i dest {_mm_loadu_si128(reinterpret_cast<const __m128i*>(pDest + i))};
+
+        __m128i halves[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            const __m128i s {half == 0 ? _mm_unpacklo_epi8(source, zero) : _mm_unpackhi_epi8(source, zero)};
+            const __m128i d {half == 0 ? _mm_unpacklo_epi8(dest, zero) : _mm_unpackhi_epi8(dest, zero)};
+
+            // Copy each pixel's alpha (the top channel) across all four of
+            // its channels.
+            const __m128i alpha {_mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff)};
+            const __m128i inverse {_mm_sub_epi16(all255, alpha)};
+
+            // (s * a + d * (255 - a)) / 255, rounded
+            __m128i t {_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, alpha), _mm_mullo_epi16(d, inverse)), round)};
+            t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            halves[half] = t;
+        }
+
+        const __m128i result {_mm_or_si128(_mm_packus_epi16(halves[0], halves[1]), opaque)};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), result);
+    }
+#endif
+
+    for ( ; i < count; ++i)
+    {
+        pDest[i] = blendPixel(pDest[i], pSource[i]);
+    }
+}
+
+
+SoftwareCompositor::SoftwareCompositor() :
+    m_Atlas {buildBallAtlas()},
+    m_Background(WIDTH * HEIGHT),
+    m_Shader {Table::BALL_DIAMETER},
+    m_BallPixels(BALL_TYPE_COUNT * Table::BALL_DIAMETER * Table::BALL_DIAMETER),
+    m_Textures {},
+    m_Queue {},
+    m_pTarget {nullptr},
+    m_ScaledPixels {}
+{
+    m_Textures[static_cast<size_t>(RenderTexture::Background)] = Texture {m_Background.data(), WIDTH};
+    m_Textures[static_cast<size_t>(RenderTexture::Sprites)] = Texture {m_Atlas.m_Pixels.data(), m_Atlas.m_Width};
+    m_Textures[static_cast<size_t>(RenderTexture::Balls)] = Texture {
+        m_BallPixels.data(),
+        static_cast<int>(BALL_TYPE_COUNT) * Table::BALL_DIAMETER
+    };
+
+    renderBackground();
+}
+
+
+void SoftwareCompositor::renderBackground()
+{
+    m_Queue.clear();
+    for (const auto& background : Game::getBackgroundRects())
+    {
+        m_Queue.fillRect(RenderLayer::Background, background.m_Rect, background.m_Color);
+    }
+
+    // The pockets go over the felt, so in the layer above it. They're drawn
+    // bigger than the sprite, so they get scaled up on the way.
+    const SDL_Rect sprite {m_Atlas.m_PocketSpriteX, 0, m_Atlas.m_SpriteSize, m_Atlas.m_SpriteSize};
+    for (const auto& pocket : Table::getPocketPositions())
+    {
+        const SDL_Rect rect {Game::getPocketRect(pocket)};
+        m_Queue.drawSprite(
+            RenderLayer::Balls,
+            RenderTexture::Sprites,
+            sprite,
+            static_cast<float>(rect.x),
+            static_cast<float>(rect.y),
+            static_cast<float>(rect.w),
+            static_cast<float>(rect.h)
+        );
+    }
+
+    m_Queue.sort();
+    submit(m_Queue, m_Background.data());
+}
+
+void SoftwareCompositor::renderFrame(uint32_t* pPixels, const std::vector<Ball>& balls, float shotPower)
+{
+    PROFILE_SCOPE(Render);
+
+    std::copy(m_Background.begin(), m_Background.end(), pPixels);
+
+    m_Queue.clear();
+    const SDL_Rect powerBar {Game::getPowerBarFillRect(Game::getPowerBarFillHeight(shotPower))};
+    m_Queue.fillRect(RenderLayer::Background, powerBar, Game::POWER_BAR_FILL_COLOR);
+
+    const int SPRITE_SIZE {Table::BALL_DIAMETER};
+    const int PITCH {static_cast<int>(BALL_TYPE_COUNT) * SPRITE_SIZE};
+    for (size_t i = 0; i < balls.size(); ++i)
+    {
+        const Ball& ball = balls[i];
+        if (ball.m_IsPocketed)
+        {
+            continue;
+        }
+
+        const int slotX {static_cast<int>(i) * SPRITE_SIZE};
+        m_Shader.shade(reinterpret_cast<uint8_t*>(&m_BallPixels[slotX]), 4 * PITCH, ball.m_Type, ball.m_Orientation);
+
+        // Draw balls relative to center
+        m_Queue.drawSprite(
+            RenderLayer::Balls,
+            RenderTexture::Balls,
+            SDL_Rect {slotX, 0, SPRITE_SIZE, SPRITE_SIZE},
+            ball.position.x - SPRITE_SIZE / 2.0f,
+            ball.position.y - SPRITE_SIZE / 2.0f,
+            SPRITE_SIZE,
+            SPRITE_SIZE
+        );
+    }
+
+    m_Queue.sort();
+    submit(m_Queue, pPixels);
+}
+
+void SoftwareCompositor::submit(RenderQueue& queue, uint32_t* pPixels)
+{
+    m_pTarget = pPixels;
+    queue.submit(*this);
+    m_pTarget = nullptr;
+}
+
+
+static uint32_t toPixel(const SDL_Color& color)
+{
+    return
+        (static_cast<uint32_t>(color.a) << 24) |
+        (static_cast<uint32_t>(color.r) << 16) |
+        (static_cast<uint32_t>(color.g) << 8) |
+        color.b;
+}
+
+void SoftwareCompositor::fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend)
+{
+    const uint32_t pixel {toPixel(color)};
+    for (size_t i = 0; i < count; ++i)
+    {
+        fillRect(pRects[i], pixel, blend);
+    }
+}
+
+void SoftwareCompositor::drawSprites(RenderTexture name, const RenderSprite* pSprites, size_t count, RenderBlend blend)
+{
+    const Texture& texture = m_Textures[static_cast<size_t>(name)];
+    if ( ! texture.m_pPixels)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const RenderSprite& sprite = pSprites[i];
+        const SDL_Rect& source = sprite.m_Source;
+        const auto x = static_cast<int>(std::lround(sprite.m_X));
+        const auto y = static_cast<int>(std::lround(sprite.m_Y));
+        const auto w = static_cast<int>(std::lround(sprite.m_W));
+        const auto h = static_cast<int>(std::lround(sprite.m_H));
+
+        const uint32_t* pSource {texture.m_pPixels + source.y * texture.m_Pitch + source.x};
+        if (w == source.w && h == source.h)
+        {
+            blendImage(pSource, texture.m_Pitch, x, y, w, h, blend);
+            continue;
+        }
+
+        // Nearest neighbour, like SDL does by default
+        m_ScaledPixels.resize(w * h);
+        for (int row = 0; row < h; ++row)
+        {
+            const int sourceY {row * source.h / h};
+            for (int column = 0; column < w; ++column)
+            {
+                m_ScaledPixels[row * w + column] = pSource[sourceY * texture.m_Pitch + column * source.w / w];
+            }
+        }
+        blendImage(m_ScaledPixels.data(), w, x, y, w, h, blend);
+    }
+}
+
+void SoftwareCompositor::drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend)
+{
+    const uint32_t pixel {toPixel(color)};
+    for (size_t i = 1; i < count; ++i)
+    {
+        drawLine(pPoints[i - 1], pPoints[i], pixel, blend);
+    }
+}
+
+
+void SoftwareCompositor::fillRect(const SDL_Rect& rect, uint32_t pixel, RenderBlend blend)
+{
+    const int left {std::max(rect.x, 0)};
+    const int right {std::min(rect.x + rect.w, WIDTH)};
+    const int top {std::max(rect.y, 0)};
+    const int bottom {std::min(rect.y + rect.h, HEIGHT)};
+    const bool isOpaque {blend == RenderBlend::None || (pixel >> 24) == 0xff};
+    for (int y = top; y < bottom; ++y)
+    {
+        uint32_t* pRow = m_pTarget + y * WIDTH;
+        if (isOpaque)
+        {
+            std::fill(pRow + left, pRow + std::max(left, right), pixel | 0xff000000);
+            continue;
+        }
+        for (int x = left; x < right; ++x)
+        {
+            pRow[x] = blendPixel(pRow[x], pixel);
+        }
+    }
+}
+
+void SoftwareCompositor::drawLine(const SDL_Point& from, const SDL_Point& to, uint32_t pixel, RenderBlend blend)
+{
+    // One pixel per step along whichever axis the line is longer in
+    const int dx {to.x - from.x};
+    const int dy {to.y - from.y};
+    const int steps {std::max(std::abs(dx), std::abs(dy))};
+    for (int i = 0; i <= steps; ++i)
+    {
+        const int x {steps == 0 ? from.x : from.x + (dx * i + (dx >= 0 ? steps : -steps) / 2) / steps};
+        const int y {steps == 0 ? from.y : from.y + (dy * i + (dy >= 0 ? steps : -steps) / 2) / steps};
+        if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        {
+            continue;
+        }
+        uint32_t& dest = m_pTarget[y * WIDTH + x];
+        dest = blend == RenderBlend::None ? (pixel | 0xff000000) : blendPixel(dest, pixel);
+    }
+}
+
+void SoftwareCompositor::blendImage(const uint32_t* pImage, int imagePitch, int x, int y, int width, int height, RenderBlend blend)
+{
+    const int left {std::max(x, 0)};
+    const int right {std::min(x + width, WIDTH)};
+    const int top {std::max(y, 0)};
+    const int bottom {std::min(y + height, HEIGHT)};
+    if (left >= right)
+    {
+        return;
+    }
+
+    for (int row = top; row < bottom; ++row)
+    {
+        uint32_t* pDest = m_pTarget + row * WIDTH + left;
+        const uint32_t* pSource = pImage + (row - y) * imagePitch + (left - x);
+        if (blend == RenderBlend::None)
+        {
+            std::copy(pSource, pSource + (right - left), pDest);
+        }
+        else
+        {
+            blendSpan(pDest, pSource, right - left);
+        }
+    }
+}
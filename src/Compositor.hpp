@@ -0,0 +1,86 @@
+
+#ifndef COMPOSITOR_HPP
+#define COMPOSITOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "Table.hpp"
+#include "BallSprite.hpp"
+#include "BallShader.hpp"
+#include "RenderQueue.hpp"
+
+
+// Draws the same frames as Game::renderFrame, but into plain ARGB8888
+// memory on the CPU. This needs no window, renderer or display, so it
+// works on headless servers.
+//
+// Frames are queued up as render commands, just like in the game, and the
+// compositor is the backend that carries them out.
+class SoftwareCompositor : public RenderBackend
+{
+public:
+    SoftwareCompositor();
+
+    // Draw a frame into `pPixels`, which must hold WIDTH * HEIGHT pixels.
+    void renderFrame(uint32_t* pPixels, const std::vector<Ball>& balls, float shotPower);
+
+    // Carry out a queue of commands on a frame of WIDTH * HEIGHT pixels.
+    void submit(RenderQueue& queue, uint32_t* pPixels);
+
+    void fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend) override;
+    void drawSprites(RenderTexture texture, const RenderSprite* pSprites, size_t count, RenderBlend blend) override;
+    void drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend) override;
+
+    static const int WIDTH;
+    static const int HEIGHT;
+
+private:
+    void renderBackground();
+
+    void fillRect(const SDL_Rect& rect, uint32_t pixel, RenderBlend blend);
+    void drawLine(const SDL_Point& from, const SDL_Point& to, uint32_t pixel, RenderBlend blend);
+
+    // Alpha blend an image onto the frame at (x, y), clipped to the frame.
+    void blendImage(const uint32_t* pImage, int imagePitch, int x, int y, int width, int height, RenderBlend blend);
+
+private:
+    BallAtlas m_Atlas;
+    std::vector<uint32_t> m_Background;
+
+    // Balls are shaded rolling, like in the game, each into its own slot
+    // of m_BallPixels, before being blended onto the frame.
+    BallShader m_Shader;
+    std::vector<uint32_t> m_BallPixels;
+
+    // What the texture names stand for here
+    struct Texture
+    {
+        const uint32_t* m_pPixels;
+        int m_Pitch;  // In pixels
+    };
+    std::array<Texture, RENDER_TEXTURE_COUNT> m_Textures;
+
+    RenderQueue m_Queue;
+    uint32_t* m_pTarget;  // The frame being drawn into
+
+    // Sprites drawn at a different size get scaled into here first.
+    std::vector<uint32_t> m_ScaledPixels;
+
+private:
+    SoftwareCompositor(const SoftwareCompositor&) = delete;
+    SoftwareCompositor& operator=(const SoftwareCompositor&) = delete;
+
+};
+
+
+// Blend `count` straight-alpha ARGB8888 pixels from `pSource` over `pDest`,
+// as SDL_BLENDMODE_BLEND would. The result is always opaque.
+void blendSpan(uint32_t* pDest, const uint32_t* pSource, int count);
+
+
+#endif
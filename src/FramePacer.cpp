@@ -0,0 +1,193 @@
+
+#include <algorithm>  // for std::min, std::max
+#include <fstream>
+#include <limits>
+
+#include "FramePacer.hpp"
+#include "debug.hpp"
+
+
+constexpr double FramePacer::HISTOGRAM_BUCKET_WIDTH;
+const size_t FramePacer::HISTOGRAM_BUCKET_COUNT;
+
+
+FramePacer::FramePacer() :
+    m_Frequency {SDL_GetPerformanceFrequency()},
+    m_TicksPerFrame {0},
+    m_IsVsync {false},
+    m_FrameStart {0},
+    m_LastFrameEnd {0},
+    m_Deadline {0},
+    m_SleepMargin {m_Frequency / 500},  // Start off allowing for 2 ms of oversleep
+    m_Histogram {},
+    m_FrameCount {0},
+    m_MissedCount {0},
+    m_MinFrameTicks {std::numeric_limits<uint64_t>::max()},
+    m_MaxFrameTicks {0},
+    m_TotalFrameTicks {0},
+    m_TotalWorkTicks {0}
+{
+    setTargetFrameRate(60.0);
+}
+
+
+void FramePacer::setTargetFrameRate(double framesPerSecond)
+{
+    LOG("Targeting %.2f frames per second \n", framesPerSecond);
+    m_TicksPerFrame = static_cast<uint64_t>(m_Frequency / framesPerSecond);
+}
+
+double FramePacer::getTargetFrameRate() const
+{
+    return static_cast<double>(m_Frequency) / m_TicksPerFrame;
+}
+
+
+void FramePacer::beginFrame()
+{
+    m_FrameStart = SDL_GetPerformanceCounter();
+    if (m_LastFrameEnd == 0)
+    {
+        // First frame
+        m_LastFrameEnd = m_FrameStart;
+        m_Deadline = m_FrameStart + m_TicksPerFrame;
+    }
+}
+
+void FramePacer::endFrame(bool presented)
+{
+    const uint64_t workEnd {SDL_GetPerformanceCounter()};
+    const uint64_t workTicks {workEnd - m_FrameStart};
+
+    if (workEnd > m_Deadline)
+    {
+        // Missed it. Don't try to make up the lost time by rushing the
+        // next few frames; just start counting again from now.
+        ++m_MissedCount;
+        m_Deadline = workEnd;
+    }
+    else if (m_IsVsync && presented)
+    {
+        // The present already waited for the display, so the frame is
+        // over. Line the next deadline up with the refresh.
+        m_Deadline = workEnd;
+    }
+    else
+    {
+        sleepUntil(m_Deadline);
+    }
+
+    const uint64_t frameEnd {SDL_GetPerformanceCounter()};
+    recordFrame(workTicks, frameEnd - m_LastFrameEnd);
+    m_LastFrameEnd = frameEnd;
+    m_Deadline += m_TicksPerFrame;
+}
+
+void FramePacer::sleepUntil(uint64_t deadline)
+{
+    uint64_t now {SDL_GetPerformanceCounter()};
+
+    // Sleep while there's plenty of time left...
+    if (deadline > now + m_SleepMargin)
+    {
+        const uint64_t ticksToSleep {deadline - now - m_SleepMargin};
+        const auto milliseconds = static_cast<Uint32>(ticksToSleep * 1000 / m_Frequency);
+        if (milliseconds > 0)
+        {
+            SDL_Delay(milliseconds);
+
+            // Keep track of how late SDL_Delay wakes up. Jump straight to
+            // anything worse than we've allowed for, and slowly come back
+            // down otherwise.
+            const uint64_t woke {SDL_GetPerformanceCounter()};
+            const uint64_t asked {milliseconds * m_Frequency / 1000};
+            const uint64_t overslept {woke - now > asked ? woke - now - asked : 0};
+            if (overslept > m_SleepMargin)
+            {
+                m_SleepMargin = overslept;
+            }
+            else
+            {
+                m_SleepMargin = (m_SleepMargin * 31 + overslept) / 32;
+            }
+            m_SleepMargin = std::max(m_SleepMargin, m_Frequency / 4000);
+            now = woke;
+        }
+    }
+
+    // ...then watch the clock for the rest.
+    while (now < deadline)
+    {
+        now = SDL_GetPerformanceCounter();
+    }
+}
+
+void FramePacer::recordFrame(uint64_t workTicks, uint64_t frameTicks)
+{
+    ++m_FrameCount;
+    m_MinFrameTicks = std::min(m_MinFrameTicks, frameTicks);
+    m_MaxFrameTicks = std::max(m_MaxFrameTicks, frameTicks);
+    m_TotalFrameTicks += frameTicks;
+    m_TotalWorkTicks += workTicks;
+
+    const auto bucket = static_cast<size_t>(ticksToMilliseconds(frameTicks) / HISTOGRAM_BUCKET_WIDTH);
+    ++m_Histogram[std::min(bucket, HISTOGRAM_BUCKET_COUNT)];
+}
+
+
+FrameStats FramePacer::getStats() const
+{
+    FrameStats stats {m_FrameCount, m_MissedCount, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if (m_FrameCount == 0)
+    {
+        return stats;
+    }
+
+    stats.m_MinFrameTime = ticksToMilliseconds(m_MinFrameTicks);
+    stats.m_MeanFrameTime = ticksToMilliseconds(m_TotalFrameTicks) / m_FrameCount;
+    stats.m_MaxFrameTime = ticksToMilliseconds(m_MaxFrameTicks);
+    stats.m_MeanWorkTime = ticksToMilliseconds(m_TotalWorkTicks) / m_FrameCount;
+
+    // The 99th percentile is the top of the bucket it falls in.
+    const uint64_t rank {m_FrameCount - m_FrameCount / 100};
+    uint64_t count {0};
+    for (size_t i = 0; i < m_Histogram.size(); ++i)
+    {
+        count += m_Histogram[i];
+        if (count >= rank)
+        {
+            stats.m_P99FrameTime = std::min((i + 1) * HISTOGRAM_BUCKET_WIDTH, stats.m_MaxFrameTime);
+            break;
+        }
+    }
+    return stats;
+}
+
+bool FramePacer::writeHistogram(const char* path) const
+{
+    std::ofstream file {path};
+    if ( ! file)
+    {
+        return false;
+    }
+
+    file << "frame_time_ms,frames\n";
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        if (m_Histogram[i] > 0)
+        {
+            file << i * HISTOGRAM_BUCKET_WIDTH << "," << m_Histogram[i] << "\n";
+        }
+    }
+    if (m_Histogram[HISTOGRAM_BUCKET_COUNT] > 0)
+    {
+        file << HISTOGRAM_BUCKET_COUNT * HISTOGRAM_BUCKET_WIDTH << "+," << m_Histogram[HISTOGRAM_BUCKET_COUNT] << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+
+double FramePacer::ticksToMilliseconds(uint64_t ticks) const
+{
+    return 1000.0 * ticks / m_Frequency;
+}
@@ -0,0 +1,90 @@
+
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <stdint.h>
+#include <array>
+
+#include <SDL2/SDL.h>
+
+
+struct FrameStats
+{
+    uint64_t m_FrameCount;
+    uint64_t m_MissedCount;  // Frames whose work ran past the deadline
+
+    // Time from the end of one frame to the end of the next, in milliseconds
+    double m_MinFrameTime;
+    double m_MeanFrameTime;
+    double m_P99FrameTime;
+    double m_MaxFrameTime;
+
+    // Time spent actually doing work (i.e. not sleeping), in milliseconds
+    double m_MeanWorkTime;
+};
+
+
+// Keeps the main loop running at a steady frame rate.
+//
+// Call beginFrame() before doing a frame's work and endFrame() after it.
+// endFrame() sleeps for whatever is left of the frame: most of it with
+// SDL_Delay(), then the last little bit (which SDL_Delay() can't be trusted
+// with) by watching the performance counter. How much it leaves for the end
+// adapts to how late SDL_Delay() has been waking up.
+//
+// If presents wait for vsync, a frame which presented has already been
+// paced by the display, so endFrame() doesn't sleep on top of it.
+class FramePacer
+{
+public:
+    FramePacer();
+
+    void setTargetFrameRate(double framesPerSecond);
+    void setVsync(bool isVsync) { m_IsVsync = isVsync; }
+    double getTargetFrameRate() const;
+
+    void beginFrame();
+    void endFrame(bool presented);
+
+    FrameStats getStats() const;
+
+    // Write the frame time histogram out as CSV. Returns false if the file
+    // couldn't be written.
+    bool writeHistogram(const char* path) const;
+
+private:
+    void sleepUntil(uint64_t deadline);
+    void recordFrame(uint64_t workTicks, uint64_t frameTicks);
+
+    double ticksToMilliseconds(uint64_t ticks) const;
+
+private:
+    uint64_t m_Frequency;
+    uint64_t m_TicksPerFrame;
+    bool m_IsVsync;
+
+    uint64_t m_FrameStart;
+    uint64_t m_LastFrameEnd;
+    uint64_t m_Deadline;
+
+    // How long before the deadline to stop sleeping and start watching
+    // the clock
+    uint64_t m_SleepMargin;
+
+    // Frame times are bucketed rather than stored, so the stats cost the
+    // same however long the game runs for.
+    static constexpr double HISTOGRAM_BUCKET_WIDTH {0.1};  // Milliseconds
+    static const size_t HISTOGRAM_BUCKET_COUNT {1000};
+    std::array<uint32_t, HISTOGRAM_BUCKET_COUNT + 1> m_Histogram;  // Last bucket is everything longer
+
+    uint64_t m_FrameCount;
+    uint64_t m_MissedCount;
+    uint64_t m_MinFrameTicks;
+    uint64_t m_MaxFrameTicks;
+    uint64_t m_TotalFrameTicks;
+    uint64_t m_TotalWorkTicks;
+
+};
+
+
+#endif
@@ -0,0 +1,239 @@
+
+#include <algorithm>  // for std::min
+
+#include "FrameWriter.hpp"
+#include "debug.hpp"
+
+
+FrameWriter::FrameWriter() :
+    m_pFile {nullptr},
+    m_Format {CaptureFormat::Y4M},
+    m_Width {0},
+    m_Height {0},
+    m_Frames {},
+    m_FreeFrames {},
+    m_QueuedFrames {},
+    m_CurrentFrame {0},
+    m_StallCount {0},
+    m_pThread {nullptr},
+    m_IsClosing {false},
+    m_HasFailed {false},
+    m_Encoded {}
+{
+}
+
+FrameWriter::~FrameWriter()
+{
+    close();
+}
+
+
+bool FrameWriter::open(const char* path, CaptureFormat format, int width, int height, int frameRate)
+{
+    LOG("Opening capture file %s \n", path);
+
+    m_pFile = fopen(path, "wb");
+    if ( ! m_pFile)
+    {
+        return false;
+    }
+    m_Format = format;
+    m_Width = width;
+    m_Height = height;
+
+    if (format == CaptureFormat::Y4M)
+    {
+        // 4:2:0 with each chroma sample centred on its 2x2 block, full range
+        fprintf(m_pFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, frameRate);
+        m_Encoded.resize(width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2));
+    }
+    else
+    {
+        m_Encoded.resize(3 * width * height);
+    }
+
+    for (size_t i = 0; i < QUEUE_CAPACITY; ++i)
+    {
+        m_Frames[i].resize(width * height);
+        m_FreeFrames.push(i);
+    }
+
+    m_IsClosing.store(false, std::memory_order_release);
+    m_HasFailed.store(false, std::memory_order_release);
+    m_pThread = SDL_CreateThread(writerThread, "frame writer", this);
+    if ( ! m_pThread)
+    {
+        fclose(m_pFile);
+        m_pFile = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void FrameWriter::close()
+{
+    if (m_pThread)
+    {
+        m_IsClosing.store(true, std::memory_order_release);
+        SDL_WaitThread(m_pThread, nullptr);
+        m_pThread = nullptr;
+    }
+
+    if (m_pFile)
+    {
+        if (fclose(m_pFile) != 0)
+        {
+            m_HasFailed.store(true, std::memory_order_release);
+        }
+        m_pFile = nullptr;
+    }
+}
+
+
+uint32_t* FrameWriter::beginFrame()
+{
+    while ( ! m_FreeFrames.pop(m_CurrentFrame))
+    {
+        // Every buffer is waiting to be written.
+        ++m_StallCount;
+        SDL_Delay(1);
+    }
+    return m_Frames[m_CurrentFrame].data();
+}
+
+void FrameWriter::endFrame()
+{
+    // There are only QUEUE_CAPACITY buffers, so this always fits.
+    m_QueuedFrames.push(m_CurrentFrame);
+}
+
+
+int FrameWriter::writerThread(void* pUserData)
+{
+    static_cast<FrameWriter*>(pUserData)->runWriter();
+    return 0;
+}
+
+void FrameWriter::runWriter()
+{
+    while (true)
+    {
+        // Anything queued before close() was called is already visible by
+        // the time we see m_IsClosing, so check it first.
+        const bool isClosing {m_IsClosing.load(std::memory_order_acquire)};
+
+        size_t index;
+        if (m_QueuedFrames.pop(index))
+        {
+            writeFrame(m_Frames[index].data());
+            m_FreeFrames.push(index);
+        }
+        else if (isClosing)
+        {
+            break;
+        }
+        else
+        {
+            SDL_Delay(1);
+        }
+    }
+}
+
+void FrameWriter::writeFrame(const uint32_t* pPixels)
+{
+    if (m_HasFailed.load(std::memory_order_relaxed))
+    {
+        // Keep taking frames so the drawing side doesn't get stuck, but
+        // there's no point writing them.
+        return;
+    }
+
+    bool ok {true};
+    if (m_Format == CaptureFormat::Y4M)
+    {
+        encodeY4M(pPixels);
+        ok = fputs("FRAME\n", m_pFile) >= 0;
+    }
+    else
+    {
+        encodePPM(pPixels);
+        ok = fprintf(m_pFile, "P6\n%d %d\n255\n", m_Width, m_Height) > 0;
+    }
+    ok = ok && fwrite(m_Encoded.data(), 1, m_Encoded.size(), m_pFile) == m_Encoded.size();
+
+    if ( ! ok)
+    {
+        LOG("Failed to write a captured frame \n");
+        m_HasFailed.store(true, std::memory_order_release);
+    }
+}
+
+void FrameWriter::encodeY4M(const uint32_t* pPixels)
+{
+    // Full range BT.601, in 8.8 fixed point. The chroma offsets add 128
+    // (as 128 << 8), which keeps everything positive before the shift.
+    //
+    // Each 2x2 block of pixels is done in one go: four luma samples, and
+    // one chroma sample from their average.
+    const int chromaWidth {(m_Width + 1) / 2};
+    const int chromaHeight {(m_Height + 1) / 2};
+    uint8_t* pY = m_Encoded.data();
+    uint8_t* pU = pY + m_Width * m_Height;
+    uint8_t* pV = pU + chromaWidth * chromaHeight;
+
+    auto luma = [](uint32_t pixel)
+    {
+        const uint32_t r {(pixel >> 16) & 0xff};
+        const uint32_t g {(pixel >> 8) & 0xff};
+        const uint32_t b {pixel & 0xff};
+        return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+    };
+
+    for (int cy = 0; cy < chromaHeight; ++cy)
+    {
+        const int y0 {2 * cy};
+        const int y1 {std::min(y0 + 1, m_Height - 1)};
+        const uint32_t* pRow0 = pPixels + y0 * m_Width;
+        const uint32_t* pRow1 = pPixels + y1 * m_Width;
+        uint8_t* pLuma0 = pY + y0 * m_Width;
+        uint8_t* pLuma1 = pY + y1 * m_Width;
+
+        for (int cx = 0; cx < chromaWidth; ++cx)
+        {
+            const int x0 {2 * cx};
+            const int x1 {std::min(x0 + 1, m_Width - 1)};
+            const uint32_t a {pRow0[x0]};
+            const uint32_t b {pRow0[x1]};
+            const uint32_t c {pRow1[x0]};
+            const uint32_t d {pRow1[x1]};
+
+            pLuma0[x0] = luma(a);
+            pLuma0[x1] = luma(b);
+            pLuma1[x0] = luma(c);
+            pLuma1[x1] = luma(d);
+
+            // Adding the red and blue channels of two pixels at once is
+            // fine, since neither can carry into the other.
+            const uint32_t redBlue {(a & 0xff00ff) + (b & 0xff00ff) + (c & 0xff00ff) + (d & 0xff00ff)};
+            const int r {static_cast<int>(((redBlue >> 16) + 2) / 4)};
+            const int g {static_cast<int>(((((a >> 8) & 0xff) + ((b >> 8) & 0xff) + ((c >> 8) & 0xff) + ((d >> 8) & 0xff)) + 2) / 4)};
+            const int blue {static_cast<int>(((redBlue & 0xffff) + 2) / 4)};
+
+            // Pure blue or red comes out at 256, so clamp.
+            pU[cy * chromaWidth + cx] = static_cast<uint8_t>(std::min((-43 * r - 85 * g + 128 * blue + 32896) >> 8, 255));
+            pV[cy * chromaWidth + cx] = static_cast<uint8_t>(std::min((128 * r - 107 * g - 21 * blue + 32896) >> 8, 255));
+        }
+    }
+}
+
+void FrameWriter::encodePPM(const uint32_t* pPixels)
+{
+    uint8_t* pOut = m_Encoded.data();
+    for (int i = 0; i < m_Width * m_Height; ++i)
+    {
+        const uint32_t pixel {pPixels[i]};
+        pOut[3 * i + 0] = static_cast<uint8_t>(pixel >> 16);
+        pOut[3 * i + 1] = static_cast<uint8_t>(pixel >> 8);
+        pOut[3 * i + 2] = static_cast<uint8_t>(pixel);
+    }
+}
@@ -0,0 +1,84 @@
+
+#ifndef FRAME_WRITER_HPP
+#define FRAME_WRITER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "SpscRing.hpp"
+
+
+enum class CaptureFormat
+{
+    Y4M,  // YUV4MPEG2, 4:2:0; most video tools will take this directly
+    PPM,  // One binary PPM image after another
+};
+
+
+// Writes ARGB8888 frames to disk on a background thread.
+//
+// Frames are drawn straight into one of a fixed set of buffers, which are
+// then queued for the writer thread to convert and write out, and handed
+// back once it's done. Nothing is allocated per frame, and the thread
+// drawing frames only ever waits if every buffer is still queued (i.e. the
+// disk can't keep up); getStallCount() says how often that happened.
+class FrameWriter
+{
+public:
+    FrameWriter();
+    ~FrameWriter();
+
+    bool open(const char* path, CaptureFormat format, int width, int height, int frameRate);
+
+    // Write out everything still queued, then close the file.
+    void close();
+
+    // Get a buffer of width * height pixels to draw the next frame into,
+    // then call endFrame() to queue it.
+    uint32_t* beginFrame();
+    void endFrame();
+
+    uint64_t getStallCount() const { return m_StallCount; }
+    bool hasFailed() const { return m_HasFailed.load(std::memory_order_acquire); }
+
+private:
+    static int writerThread(void* pUserData);
+    void runWriter();
+    void writeFrame(const uint32_t* pPixels);
+    void encodeY4M(const uint32_t* pPixels);
+    void encodePPM(const uint32_t* pPixels);
+
+private:
+    FILE* m_pFile;
+    CaptureFormat m_Format;
+    int m_Width;
+    int m_Height;
+
+    static const size_t QUEUE_CAPACITY {8};
+    std::array<std::vector<uint32_t>, QUEUE_CAPACITY> m_Frames;
+    SpscRing<size_t, QUEUE_CAPACITY> m_FreeFrames;    // Writer to drawer
+    SpscRing<size_t, QUEUE_CAPACITY> m_QueuedFrames;  // Drawer to writer
+    size_t m_CurrentFrame;
+    uint64_t m_StallCount;
+
+    SDL_Thread* m_pThread;
+    std::atomic<bool> m_IsClosing;
+    std::atomic<bool> m_HasFailed;
+
+    // Only touched by the writer thread
+    std::vector<uint8_t> m_Encoded;
+
+private:
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+};
+
+
+#endif
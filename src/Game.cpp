@@ -1,37 +1,67 @@
 
-#include <utility>  // for std::pair
-#include <cmath>    // for std::sin
-#include <algorithm>  // for std::remove_if
+#include <algorithm>  // for std::min, std::max
+#include <cmath>      // for std::sin, std::floor, std::ceil, std::fabs, std::lround
 #include <iostream>
-#include <glm/geometric.hpp>  // for glm::length, glm::distance, glm::reflect
+#include <vector>
+
+#include <glm/vector_relational.hpp>  // for glm::equal, glm::all
 
 #include "Game.hpp"
+#include "BallSprite.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
+#include "Telemetry.hpp"
+#include "StateExport.hpp"
 #include "debug.hpp"
 
 
-// Todo: move to own file
-Ball::Ball(SDL_Texture *pTexture) :
-    position {0, 0},
-    velocity {0, 0},
-    m_pTexture {pTexture}
-{
-}
-
-BallForce::BallForce(Ball *pBall, glm::vec2 force, float duration) :
-    m_pBall {pBall},
-    m_Force {force},
-    m_Duration {duration}
-{
-}
+constexpr SDL_Color Game::POWER_BAR_FILL_COLOR;
+constexpr std::chrono::microseconds Game::AIM_BUDGET;
 
 
-Game::Game() :
+Game::Game(const GameOptions& options) :
+    m_Options {options},
     m_IsRunning {false},
+    m_FramePacer {},
     m_pWindow {nullptr},
     m_pRenderer {nullptr},
-    m_BallTextures {},
-    m_Balls {},
-    m_BallForces {},
+    m_ViewScale {1.0f},
+    m_ViewRect {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT},
+    m_PixelsPerPoint {1.0f},
+    m_Sprites {},
+    m_BallTexture {},
+    m_RenderQueue {},
+    m_RenderBackend {},
+    m_pBackgroundTexture {nullptr},
+    m_pFrameTexture {nullptr},
+    m_DrawnBalls {},
+    m_DrawnPowerBarHeight {0},
+    m_Damage {},
+    m_NeedsFullRedraw {true},
+    m_FrameBalls {},
+    m_FrameShotPower {0.0f},
+    m_FrameCanShoot {false},
+    m_MousePosition {},
+    m_IsMouseInWindow {false},
+    m_AimPredictor {},
+    m_AimBalls {},
+    m_AimTarget {},
+    m_AimShotPower {0.0f},
+    m_IsAiming {false},
+    m_ShowPartialAim {false},
+    m_CueAimPath {},
+    m_ObjectAimPath {},
+    m_DrawnAimRect {0, 0, 0, 0},
+    m_AimChanged {false},
+    m_IsProfilerShown {false},
+    m_pSimulationThread {nullptr},
+    m_IsSimulating {false},
+    m_Commands {},
+    m_Snapshots {},
+    m_Table {},
+    m_Rules {},
+    m_Rewind {REWIND_KEYFRAME_CAPACITY, REWIND_KEYFRAME_INTERVAL},
+    m_Audio {},
     m_ShotPower {0.0}
 {
 }
@@ -42,124 +72,66 @@ Game::~Game()
 }
 
 
-SDL_Texture* Game::createBallTexture(uint8_t red, uint8_t green, uint8_t blue, bool hasStripe)
+bool Game::createTextures()
 {
-    DEBUG_LOG("Creating ball texture: red=%u, green=%u, blue=%u, hasStripe=%s \n", red, green, blue, BOOL_STRING(hasStripe));
-
-    SDL_Texture *pTexture = SDL_CreateTexture(
-        m_pRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STATIC,
-        BALL_DIAMETER,
-        BALL_DIAMETER
-    );
-    if ( ! pTexture)
-    {
-        return nullptr;
-    }
+    LOG("Creating textures \n");
 
-    SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+    // Every sprite goes side by side in one atlas texture, so all of the
+    // balls can be drawn without switching textures. The first lot is
+    // needed straight away, so there's no point building it in the
+    // background.
+    return m_Sprites.load(m_pRenderer, getSpriteSize(m_ViewScale));
+}
 
-    const auto R = static_cast<int16_t>(BALL_DIAMETER / 2);
-    const auto R_EDGE = static_cast<int16_t>(R - 3);
-    const auto STRIPE_AREA_WIDTH = static_cast<int16_t>(BALL_DIAMETER / 3);
 
-    uint16_t i = 0;
-    uint8_t textureData[BALL_DIAMETER * BALL_DIAMETER * 4];
-    for (uint16_t y = 0; y < BALL_DIAMETER; ++y)
+bool Game::updateView()
+{
+    int outputWidth;
+    int outputHeight;
+    if (SDL_GetRendererOutputSize(m_pRenderer, &outputWidth, &outputHeight) != 0 || outputWidth <= 0 || outputHeight <= 0)
     {
-        for (uint16_t x = 0; x < BALL_DIAMETER; ++x)
-        {
-            // Fix coords for calculating the pixels inside the circle.
-            const auto x0 = static_cast<int16_t>(x - R);
-            const auto y0 = static_cast<int16_t>(y - R);
-            const auto r0 = static_cast<int16_t>((x0 * x0) + (y0 * y0));
+        // Minimised, probably. Keep the view we had.
+        return false;
+    }
 
-            const bool onEdge {r0 >= (R_EDGE * R_EDGE)};
-            const bool doDraw {r0 <= (R * R)};
+    int windowWidth;
+    int windowHeight;
+    SDL_GetWindowSize(m_pWindow, &windowWidth, &windowHeight);
+    m_PixelsPerPoint = windowWidth > 0 ? static_cast<float>(outputWidth) / windowWidth : 1.0f;
 
-            const bool inStripeArea {x < STRIPE_AREA_WIDTH || x > (BALL_DIAMETER - STRIPE_AREA_WIDTH)};
-            if (onEdge)
-            {
-                textureData[i++] = 0x00;
-                textureData[i++] = 0x00;
-                textureData[i++] = 0x00;
-            }
-            else if (hasStripe && inStripeArea)
-            {
-                textureData[i++] = 0xff;
-                textureData[i++] = 0xff;
-                textureData[i++] = 0xff;
-            }
-            else
-            {
-                textureData[i++] = blue;
-                textureData[i++] = green;
-                textureData[i++] = red;
-            }
-            textureData[i++] = doDraw ? 0xff : 0x00;  // Alpha
-        }
-    }
-    if (SDL_UpdateTexture(
-        pTexture,
-        NULL,
-        textureData,
-        4 * sizeof(uint8_t) * BALL_DIAMETER
-    ) != 0) {
-        SDL_DestroyTexture(pTexture);
-        return nullptr;
-    }
+    m_ViewScale = std::min(
+        static_cast<float>(outputWidth) / WINDOW_WIDTH,
+        static_cast<float>(outputHeight) / WINDOW_HEIGHT
+    );
+    const int viewWidth {std::max(1, static_cast<int>(std::lround(WINDOW_WIDTH * m_ViewScale)))};
+    const int viewHeight {std::max(1, static_cast<int>(std::lround(WINDOW_HEIGHT * m_ViewScale)))};
+    m_ViewRect = {(outputWidth - viewWidth) / 2, (outputHeight - viewHeight) / 2, viewWidth, viewHeight};
 
-    return pTexture;
+    LOG("View is %dx%d pixels, at a scale of %f \n", viewWidth, viewHeight, m_ViewScale);
+    return true;
 }
 
-
-bool Game::createTextures()
+SDL_Rect Game::toPhysical(const SDL_Rect& rect) const
 {
-    DEBUG_LOG("Creating textures \n");
-
-    struct BallColorProfile
-    {
-        uint8_t r, g, b;
-        bool hasStripe;
-    };
+    // Round outwards, so that everything the rect touches is included.
+    const int left {std::max(0, static_cast<int>(std::floor(rect.x * m_ViewScale)))};
+    const int top {std::max(0, static_cast<int>(std::floor(rect.y * m_ViewScale)))};
+    const int right {std::min(m_ViewRect.w, static_cast<int>(std::ceil((rect.x + rect.w) * m_ViewScale)))};
+    const int bottom {std::min(m_ViewRect.h, static_cast<int>(std::ceil((rect.y + rect.h) * m_ViewScale)))};
+    return SDL_Rect {left, top, std::max(0, right - left), std::max(0, bottom - top)};
+}
 
-    std::pair<BallType, BallColorProfile> profiles[] = {
-        std::make_pair(BallType::Cue,          BallColorProfile{255, 255, 255, false}),
-        std::make_pair(BallType::Black,        BallColorProfile{0,   0,   0,   false}),
-
-        std::make_pair(BallType::Yellow,       BallColorProfile{255, 204, 0,   false}),
-        std::make_pair(BallType::Blue,         BallColorProfile{0,   51,  153, false}),
-        std::make_pair(BallType::Red,          BallColorProfile{255, 0,   0,   false}),
-        std::make_pair(BallType::Purple,       BallColorProfile{61,  0,   153, false}),
-        std::make_pair(BallType::Orange,       BallColorProfile{255, 51,  0,   false}),
-        std::make_pair(BallType::Green,        BallColorProfile{0,   77,  0,   false}),
-        std::make_pair(BallType::Maroon,       BallColorProfile{153, 0,   0,   false}),
-
-        std::make_pair(BallType::YellowStripe, BallColorProfile{255, 204, 0,   true}),
-        std::make_pair(BallType::BlueStripe,   BallColorProfile{0,   51,  153, true}),
-        std::make_pair(BallType::RedStripe,    BallColorProfile{255, 0,   0,   true}),
-        std::make_pair(BallType::PurpleStripe, BallColorProfile{61,  0,   153, true}),
-        std::make_pair(BallType::OrangeStripe, BallColorProfile{255, 51,  0,   true}),
-        std::make_pair(BallType::GreenStripe,  BallColorProfile{0,   77,  0,   true}),
-        std::make_pair(BallType::MaroonStripe, BallColorProfile{153, 0,   0,   true}),
+glm::vec2 Game::toLogical(int x, int y) const
+{
+    return glm::vec2 {
+        (x * m_PixelsPerPoint - m_ViewRect.x) / m_ViewScale,
+        (y * m_PixelsPerPoint - m_ViewRect.y) / m_ViewScale
     };
-    for (const auto& profile : profiles)
-    {
-        SDL_Texture* pTexture = createBallTexture(
-            profile.second.r,
-            profile.second.g,
-            profile.second.b,
-            profile.second.hasStripe
-        );
-        if ( ! pTexture)
-        {
-            return false;
-        }
-        m_BallTextures[profile.first] = pTexture;
-    }
+}
 
-    return true;
+int Game::getSpriteSize(float scale)
+{
+    return std::max(1, static_cast<int>(std::lround(Table::BALL_DIAMETER * scale)));
 }
 
 
@@ -171,9 +143,15 @@ void Game::printHelp()
         << "----------------------------------------------------------------------- \n"
         << " - To launch the cue-ball, place the cursor over the intended \n"
            "   direction, then left-click. The power of the shot is determined \n"
-           "   by the bar on the right-hand side of the screen. \n\n"
+           "   by the bar on the right-hand side of the screen. The faint \n"
+           "   lines show where the cue ball and the first ball it hits will go. \n\n"
+           " - Players take turns at 8-ball. Pocket all of your group (solids \n"
+           "   or stripes), then the black, to win. Turns and fouls are \n"
+           "   printed here as you play. \n\n"
            " - Press \"R\" to reset the balls to their starting positions. \n\n"
            " - Press \"F\" to freeze the balls in their tracks! \n\n"
+           " - Press \"Left\" to wind the game back by a second. \n\n"
+           " - Press \"P\" to show where the frame time goes. \n\n"
            " - Press \"Escape\" or \"Q\" to exit.\n"
         << std::endl;
 }
@@ -181,339 +159,941 @@ void Game::printHelp()
 
 bool Game::initGame()
 {
-    DEBUG_LOG("Initializing Game \n");
+    LOG("Initializing Game \n");
 
+    updateView();
     if ( ! createTextures())
     {
         return false;
     }
 
-    createBalls();
+    if ( ! createRenderTargets())
+    {
+        return false;
+    }
+
+    m_Table.rackBalls();
+    m_Rules.rack();
+    m_Rewind.capture(m_Table, m_Rules);
+
+    // Give the render thread something to draw before the first step.
+    m_FrameBalls.reserve(BALL_TYPE_COUNT);
+    m_AimBalls.reserve(BALL_TYPE_COUNT);
+    m_CueAimPath.reserve(m_AimPredictor.getCuePath().capacity());
+    m_ObjectAimPath.reserve(m_AimPredictor.getObjectPath().capacity());
+    recordPreviousPositions();
+    publishSnapshot();
 
     printHelp();
+    printTurn();
 
     return true;
 }
 
-void Game::createBalls()
+void Game::teardownGame()
 {
-    DEBUG_LOG("Creating Balls \n");
+    m_Sprites.clear();
+    m_BallTexture.destroy();
+    SDL_DestroyTexture(m_pBackgroundTexture);
+    m_pBackgroundTexture = nullptr;
+    SDL_DestroyTexture(m_pFrameTexture);
+    m_pFrameTexture = nullptr;
+}
 
-    std::map<BallType, glm::vec2> spots;
-    spots[BallType::Cue] = glm::vec2{
-        FELT_LEFT_COORD + FELT_WIDTH * 0.15f,
-        FELT_TOP_COORD + FELT_HEIGHT / 2
-    };
+bool Game::createRenderTargets()
+{
+    // The window may have changed size, so work out where the table goes
+    // now, and ask for sprites to match. Until they're ready, the old ones
+    // get stretched.
+    updateView();
+    m_Sprites.request(getSpriteSize(m_ViewScale));
+    createBallTexture();
+
+    // Whatever was in the old frame is gone, so start again from scratch.
+    m_NeedsFullRedraw = true;
+    return createBackgroundTexture() && createFrameTexture();
+}
+
+// The rolling balls follow the sprites: their shader is built along with
+// each sheet, off this thread, and until then they're stretched too.
+void Game::createBallTexture()
+{
+    if ( ! m_BallTexture.create(m_pRenderer, m_Sprites.getCurrent().m_pShader))
+    {
+        LOG("Could not create the rolling ball texture: %s \n", SDL_GetError());
+    }
+}
+
+bool Game::createBackgroundTexture()
+{
+    LOG("Creating background texture \n");
+
+    SDL_DestroyTexture(m_pBackgroundTexture);
+    m_pBackgroundTexture = SDL_CreateTexture(
+        m_pRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        m_ViewRect.w,
+        m_ViewRect.h
+    );
+    if ( ! m_pBackgroundTexture)
+    {
+        return false;
+    }
+
+    // It covers the whole window, so there's nothing underneath to blend with.
+    SDL_SetTextureBlendMode(m_pBackgroundTexture, SDL_BLENDMODE_NONE);
+
+    if (SDL_SetRenderTarget(m_pRenderer, m_pBackgroundTexture) != 0)
+    {
+        return false;
+    }
+
+    // Switching targets resets the scale, so it has to be set every time.
+    SDL_RenderSetScale(m_pRenderer, m_ViewScale, m_ViewScale);
+    renderBackground();
+    return SDL_SetRenderTarget(m_pRenderer, nullptr) == 0;
+}
+
+bool Game::createFrameTexture()
+{
+    LOG("Creating frame texture \n");
 
-    auto positionBall = [this](int row, int position)
+    SDL_DestroyTexture(m_pFrameTexture);
+    m_pFrameTexture = SDL_CreateTexture(
+        m_pRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        m_ViewRect.w,
+        m_ViewRect.h
+    );
+    if ( ! m_pFrameTexture)
     {
-        static const float SPACING_MULTIPLIER {1.1f};
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(m_pFrameTexture, SDL_BLENDMODE_NONE);
+    return true;
+}
+
+std::array<Game::BackgroundRect, Game::BACKGROUND_RECT_COUNT> Game::getBackgroundRects()
+{
+    const SDL_Color POWER_BAR_BORDER_COLOR {16, 14, 14, 0xff};
+    const SDL_Color BUMPER_COLOR {125, 82, 9, 0xff};
+
+    return {{
+        // Clear
+        {{0, 0, WINDOW_WIDTH, WINDOW_HEIGHT}, {0x64, 0x95, 0xed, 0xff}},
+
+        // Inside of power bar
+        {{POWER_BAR_LEFT_COORD, POWER_BAR_TOP_COORD, POWER_BAR_WIDTH, POWER_BAR_HEIGHT}, {76, 76, 76, 0xff}},
+
+        // Power Bar Border Top
+        {
+            {
+                POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_TOP_COORD - POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_WIDTH + 2 * POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_BORDER_WIDTH
+            },
+            POWER_BAR_BORDER_COLOR
+        },
+
+        // Power Bar Border Bottom
+        {
+            {
+                POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_TOP_COORD + POWER_BAR_HEIGHT,
+                POWER_BAR_WIDTH + 2 * POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_BORDER_WIDTH
+            },
+            POWER_BAR_BORDER_COLOR
+        },
+
+        // Power Bar Border Left
+        {
+            {
+                POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_TOP_COORD,
+                POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_HEIGHT
+            },
+            POWER_BAR_BORDER_COLOR
+        },
+
+        // Power Bar Border Right
+        {
+            {
+                POWER_BAR_LEFT_COORD + POWER_BAR_WIDTH,
+                POWER_BAR_TOP_COORD,
+                POWER_BAR_BORDER_WIDTH,
+                POWER_BAR_HEIGHT
+            },
+            POWER_BAR_BORDER_COLOR
+        },
+
+        // Felt
+        {
+            {Table::FELT_LEFT_COORD, Table::FELT_TOP_COORD, Table::FELT_WIDTH, Table::FELT_HEIGHT},
+            {19, 132, 23, 0xff}
+        },
+
+        // Left Bumper
+        {
+            {
+                Table::FELT_LEFT_COORD - Table::BUMPER_WIDTH,
+                Table::FELT_TOP_COORD - Table::BUMPER_WIDTH / 2,
+                Table::BUMPER_WIDTH,
+                Table::FELT_HEIGHT + Table::BUMPER_WIDTH
+            },
+            BUMPER_COLOR
+        },
 
-        float baseX {FELT_LEFT_COORD + 0.6f * FELT_WIDTH};
-        float x {baseX + row * (SPACING_MULTIPLIER * BALL_DIAMETER)};
+        // Right Bumper
+        {
+            {
+                Table::FELT_LEFT_COORD + Table::FELT_WIDTH,
+                Table::FELT_TOP_COORD - Table::BUMPER_WIDTH / 2,
+                Table::BUMPER_WIDTH,
+                Table::FELT_HEIGHT + Table::BUMPER_WIDTH
+            },
+            BUMPER_COLOR
+        },
 
-        float baseY {FELT_TOP_COORD + FELT_HEIGHT / 2};
-        baseY -= static_cast<float>(row) / 2.0f * BALL_DIAMETER;
-        float y {baseY + SPACING_MULTIPLIER * BALL_DIAMETER * position};
+        // Top Bumper
+        {
+            {
+                Table::FELT_LEFT_COORD - Table::BUMPER_WIDTH / 2,
+                Table::FELT_TOP_COORD - Table::BUMPER_WIDTH,
+                Table::FELT_WIDTH + Table::BUMPER_WIDTH,
+                Table::BUMPER_WIDTH
+            },
+            BUMPER_COLOR
+        },
+
+        // Bottom Bumper
+        {
+            {
+                Table::FELT_LEFT_COORD - Table::BUMPER_WIDTH / 2,
+                Table::FELT_TOP_COORD + Table::FELT_HEIGHT,
+                Table::FELT_WIDTH + Table::BUMPER_WIDTH,
+                Table::BUMPER_WIDTH
+            },
+            BUMPER_COLOR
+        },
+    }};
+}
 
-        return glm::vec2{x, y};
+SDL_Rect Game::getPocketRect(const glm::vec2& pocket)
+{
+    return SDL_Rect {
+        static_cast<int>(pocket.x - Table::POCKET_RADIUS),
+        static_cast<int>(pocket.y - Table::POCKET_RADIUS),
+        static_cast<int>(2 * Table::POCKET_RADIUS),
+        static_cast<int>(2 * Table::POCKET_RADIUS)
     };
+}
 
-    spots[BallType::Yellow]       = positionBall(0, 0);
+int Game::getPowerBarFillHeight(float shotPower)
+{
+    return POWER_BAR_HEIGHT * shotPower + 1;
+}
 
-    spots[BallType::RedStripe]    = positionBall(1, 0);
-    spots[BallType::Red]          = positionBall(1, 1);
+SDL_Rect Game::getPowerBarFillRect(int height)
+{
+    return SDL_Rect {POWER_BAR_LEFT_COORD, POWER_BAR_TOP_COORD + POWER_BAR_HEIGHT - height, POWER_BAR_WIDTH, height};
+}
 
-    spots[BallType::Green]        = positionBall(2, 0);
-    spots[BallType::Black]        = positionBall(2, 1);
-    spots[BallType::GreenStripe]  = positionBall(2, 2);
+glm::vec2 Game::getShotForce(const glm::vec2& cueBall, const glm::vec2& target, float shotPower)
+{
+    return (target - cueBall) * (SHOT_POWER_MULTIPLIER * (shotPower + SHOT_POWER_OFFSET));
+}
 
-    spots[BallType::OrangeStripe] = positionBall(3, 0);
-    spots[BallType::MaroonStripe] = positionBall(3, 1);
-    spots[BallType::Purple]       = positionBall(3, 2);
-    spots[BallType::YellowStripe] = positionBall(3, 3);
+void Game::renderBackground()
+{
+    for (const auto& background : getBackgroundRects())
+    {
+        const SDL_Color& color = background.m_Color;
+        SDL_SetRenderDrawColor(m_pRenderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(m_pRenderer, &background.m_Rect);
+    }
 
-    spots[BallType::Maroon]       = positionBall(4, 0);
-    spots[BallType::Blue]         = positionBall(4, 1);
-    spots[BallType::BlueStripe]   = positionBall(4, 2);
-    spots[BallType::Orange]       = positionBall(4, 3);
-    spots[BallType::PurpleStripe] = positionBall(4, 4);
+    // Draw Pockets
+    const SpriteSheet& sprites = m_Sprites.getCurrent();
+    for (const auto& pocket : Table::getPocketPositions())
+    {
+        const SDL_Rect rect {getPocketRect(pocket)};
+        SDL_RenderCopy(m_pRenderer, sprites.m_pTexture, &sprites.m_PocketSpriteRect, &rect);
+    }
+}
+
+bool Game::renderFrame()
+{
+    PROFILE_SCOPE(Render);
+    ALLOCATION_SCOPE(Render);
+
+    collectDamage();
+    if (m_Damage.empty())
+    {
+        return false;
+    }
 
+    // Only the balls that turned since last time get shaded again.
+    m_BallTexture.update(m_FrameBalls);
 
-    for (const auto& pair : spots)
+    m_RenderQueue.clear();
+    queuePowerBar();
+    queueAimPaths();
+    queueBalls();
+    if (m_IsProfilerShown)
     {
-        auto pTexture = m_BallTextures[pair.first];
-        Ball ball {pTexture};
-        ball.position = pair.second;
-        m_Balls.push_back(ball);
+        queueProfilerOverlay();
     }
+    m_RenderQueue.sort();
 
+    m_RenderBackend.setRenderer(m_pRenderer);
+    m_RenderBackend.setTexture(RenderTexture::Sprites, m_Sprites.getCurrent().m_pTexture);
+    m_RenderBackend.setTexture(RenderTexture::Balls, m_BallTexture.getTexture());
+
+    // The window's back buffer isn't kept between presents, so the frame
+    // is patched up in a texture of its own and then copied over.
+    SDL_SetRenderTarget(m_pRenderer, m_pFrameTexture);
+    for (const auto& rect : m_Damage)
+    {
+        // The clip rect and the background are both in physical pixels, so
+        // that the copy is exactly one to one. Everything that never
+        // changes comes from the cached background.
+        const SDL_Rect physical {toPhysical(rect)};
+        SDL_RenderSetScale(m_pRenderer, 1.0f, 1.0f);
+        SDL_RenderSetClipRect(m_pRenderer, &physical);
+        SDL_RenderCopy(m_pRenderer, m_pBackgroundTexture, &physical, &physical);
+
+        SDL_RenderSetScale(m_pRenderer, m_ViewScale, m_ViewScale);
+        m_RenderQueue.submit(m_RenderBackend);
+    }
+    SDL_RenderSetClipRect(m_pRenderer, nullptr);
+    SDL_SetRenderTarget(m_pRenderer, nullptr);
+
+    // Fill in either side of the table if the window's a different shape.
+    const SDL_Color clear {getBackgroundRects()[0].m_Color};
+    SDL_SetRenderDrawColor(m_pRenderer, clear.r, clear.g, clear.b, clear.a);
+    SDL_RenderClear(m_pRenderer);
+    SDL_RenderCopy(m_pRenderer, m_pFrameTexture, NULL, &m_ViewRect);
+    m_Damage.clear();
+    return true;
 }
 
-void Game::teardownGame()
+void Game::queuePowerBar()
 {
-    for (auto const& pair : m_BallTextures)
-    {
-        SDL_DestroyTexture(pair.second);
-    }
-}
-
-void Game::renderFrame()
-{
-    SDL_Rect rect;
-
-    // Draw inside of power bar
-    SDL_SetRenderDrawColor(m_pRenderer, 76, 76, 76, 0xff);
-    rect.x = POWER_BAR_LEFT_COORD;
-    rect.y = POWER_BAR_TOP_COORD;
-    rect.w = POWER_BAR_WIDTH;
-    rect.h = POWER_BAR_HEIGHT;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Power Bar
-    SDL_SetRenderDrawColor(m_pRenderer, 206, 13, 13, 0xff);
-    rect.h = POWER_BAR_HEIGHT * m_ShotPower + 1;
-    rect.w = POWER_BAR_WIDTH;
-    rect.x = POWER_BAR_LEFT_COORD;
-    rect.y = POWER_BAR_TOP_COORD + POWER_BAR_HEIGHT - rect.h;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Power Bar Borders
-    SDL_SetRenderDrawColor(m_pRenderer, 16, 14, 14, 0xff);
-
-    // Draw Power Bar Border Top
-    rect.x = POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH;
-    rect.y = POWER_BAR_TOP_COORD - POWER_BAR_BORDER_WIDTH;
-    rect.w = POWER_BAR_WIDTH + 2 * POWER_BAR_BORDER_WIDTH;
-    rect.h = POWER_BAR_BORDER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Power Bar Border Bottom
-    rect.x = POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH;
-    rect.y = POWER_BAR_TOP_COORD + POWER_BAR_HEIGHT;
-    rect.w = POWER_BAR_WIDTH + 2 * POWER_BAR_BORDER_WIDTH;
-    rect.h = POWER_BAR_BORDER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Power Bar Border Left
-    rect.x = POWER_BAR_LEFT_COORD - POWER_BAR_BORDER_WIDTH;
-    rect.y = POWER_BAR_TOP_COORD;
-    rect.w = POWER_BAR_BORDER_WIDTH;
-    rect.h = POWER_BAR_HEIGHT;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Power Bar Border Left
-    rect.x = POWER_BAR_LEFT_COORD + POWER_BAR_WIDTH;
-    rect.y = POWER_BAR_TOP_COORD;
-    rect.w = POWER_BAR_BORDER_WIDTH;
-    rect.h = POWER_BAR_HEIGHT;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Felt
-    SDL_SetRenderDrawColor(m_pRenderer, 19, 132, 23, 0xff);
-    rect.x = FELT_LEFT_COORD;
-    rect.y = FELT_TOP_COORD;
-    rect.w = FELT_WIDTH;
-    rect.h = FELT_HEIGHT;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Bumpers
-    SDL_SetRenderDrawColor(m_pRenderer, 125, 82, 9, 0xff);
-
-    // Draw Left Bumper
-    rect.x = FELT_LEFT_COORD - BUMPER_WIDTH;
-    rect.y = FELT_TOP_COORD - BUMPER_WIDTH / 2;
-    rect.w = BUMPER_WIDTH;
-    rect.h = FELT_HEIGHT + BUMPER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Right Bumper
-    rect.x = FELT_LEFT_COORD + FELT_WIDTH;
-    rect.y = FELT_TOP_COORD - BUMPER_WIDTH / 2;
-    rect.w = BUMPER_WIDTH;
-    rect.h = FELT_HEIGHT + BUMPER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Top Bumper
-    rect.x = FELT_LEFT_COORD - BUMPER_WIDTH / 2;
-    rect.y = FELT_TOP_COORD - BUMPER_WIDTH;
-    rect.w = FELT_WIDTH + BUMPER_WIDTH;
-    rect.h = BUMPER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Bottom Bumper
-    rect.x = FELT_LEFT_COORD - BUMPER_WIDTH / 2;
-    rect.y = FELT_TOP_COORD + FELT_HEIGHT;
-    rect.w = FELT_WIDTH + BUMPER_WIDTH;
-    rect.h = BUMPER_WIDTH;
-    SDL_RenderFillRect(m_pRenderer, &rect);
-
-    // Draw Balls
-    rect.w = BALL_DIAMETER;
-    rect.h = BALL_DIAMETER;
-    for (const auto& ball : m_Balls)
+    m_RenderQueue.fillRect(RenderLayer::Background, getPowerBarFillRect(m_DrawnPowerBarHeight), POWER_BAR_FILL_COLOR);
+}
+
+void Game::queueAimPaths()
+{
+    // Drawn under the balls, so the cue ball sits on the end of its path.
+    m_RenderQueue.drawLines(RenderLayer::Paths, m_CueAimPath.data(), m_CueAimPath.size(), SDL_Color {0xff, 0xff, 0xff, 0x80});
+    m_RenderQueue.drawLines(RenderLayer::Paths, m_ObjectAimPath.data(), m_ObjectAimPath.size(), SDL_Color {0xff, 0xe0, 0x40, 0x80});
+}
+
+void Game::toggleProfilerOverlay()
+{
+    m_IsProfilerShown = ! m_IsProfilerShown;
+    Profiler::setEnabled(m_IsProfilerShown || m_Options.m_pProfilePath || m_Options.m_pTracePath);
+
+    // Rub it out, or draw it for the first time.
+    addDamage(getProfilerRect());
+
+    if (m_IsProfilerShown)
     {
-        // Draw balls relative to center
-        rect.x = ball.position.x - (BALL_DIAMETER / 2);
-        rect.y = ball.position.y - (BALL_DIAMETER / 2);
-        SDL_RenderCopy(m_pRenderer, ball.m_pTexture, NULL, &rect);
+        std::cout
+            << "Profiler bars, from the top: input (grey), ball pairs (red), cushions (orange), "
+            << "friction (yellow), integration (green), force cleanup (cyan), "
+            << "aim prediction (pink), render (blue), present (purple). "
+            << "Each is as long as its mean time, at " << PROFILER_POINTS_PER_MS << " points per ms, "
+            << "with a white tick at the 99th percentile and a grey one at the maximum."
+            << std::endl;
     }
+}
 
+SDL_Rect Game::getProfilerRect()
+{
+    // Above the top bumper, where there's nothing else
+    return SDL_Rect {10, 4, WINDOW_WIDTH - 20, static_cast<int>(PROFILE_PHASE_COUNT) * PROFILER_ROW_HEIGHT};
 }
 
-void Game::simulateFrame()
+void Game::queueProfilerOverlay()
 {
-    static float time {0.0};
-    time += 0.001;
+    static const std::array<SDL_Color, PROFILE_PHASE_COUNT> COLORS {{
+        {0xa0, 0xa0, 0xa0, 0xe0},
+        {0xe0, 0x30, 0x30, 0xe0},
+        {0xf0, 0x90, 0x20, 0xe0},
+        {0xf0, 0xe0, 0x30, 0xe0},
+        {0x40, 0xd0, 0x40, 0xe0},
+        {0x40, 0xd0, 0xe0, 0xe0},
+        {0xf0, 0x60, 0xa0, 0xe0},
+        {0x40, 0x70, 0xf0, 0xe0},
+        {0xc0, 0x50, 0xe0, 0xe0},
+    }};
+    const SDL_Color P99_COLOR {0xff, 0xff, 0xff, 0xff};
+    const SDL_Color MAX_COLOR {0x80, 0x80, 0x80, 0xff};
+
+    const SDL_Rect area {getProfilerRect()};
+    auto toWidth = [&area](double milliseconds)
+    {
+        return std::min(area.w, static_cast<int>(milliseconds * PROFILER_POINTS_PER_MS));
+    };
 
-    handleInput();
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i)
+    {
+        const ProfileStats stats {Profiler::getStats(static_cast<ProfilePhase>(i))};
+        const int top {area.y + static_cast<int>(i) * PROFILER_ROW_HEIGHT};
+        const int height {PROFILER_ROW_HEIGHT - 1};
 
-    simulatePhysics(time);
+        m_RenderQueue.fillRect(RenderLayer::Overlay, SDL_Rect {area.x, top, std::max(1, toWidth(stats.m_Mean)), height}, COLORS[i]);
+        m_RenderQueue.fillRect(RenderLayer::Overlay, SDL_Rect {area.x + toWidth(stats.m_P99), top, 2, height}, P99_COLOR);
+        m_RenderQueue.fillRect(RenderLayer::Overlay, SDL_Rect {area.x + toWidth(stats.m_Max), top, 1, height}, MAX_COLOR);
+    }
+}
 
-    m_ShotPower = 0.5 * (std::sin(8 * time) + 1.0);
+SDL_Rect Game::getPathRect(const std::vector<SDL_Point>& path)
+{
+    if (path.empty())
+    {
+        return SDL_Rect {0, 0, 0, 0};
+    }
+
+    SDL_Point low {path[0]};
+    SDL_Point high {path[0]};
+    for (const auto& point : path)
+    {
+        low.x = std::min(low.x, point.x);
+        low.y = std::min(low.y, point.y);
+        high.x = std::max(high.x, point.x);
+        high.y = std::max(high.y, point.y);
+    }
 
+    // A pixel of slack either side, in case the line drawing rounds outwards
+    return SDL_Rect {low.x - 1, low.y - 1, high.x - low.x + 3, high.y - low.y + 3};
 }
 
-void Game::simulatePhysics(float time)
+SDL_Rect Game::getBallRect(const glm::vec2& position)
 {
-    static float lastTime {0.0};
-    const float deltaTime {time - lastTime};
+    // Balls are drawn at sub-pixel positions, so allow an extra pixel
+    // either side for whatever they touch.
+    const int x {static_cast<int>(std::floor(position.x - Table::BALL_DIAMETER / 2.0f))};
+    const int y {static_cast<int>(std::floor(position.y - Table::BALL_DIAMETER / 2.0f))};
+    return SDL_Rect {x - 1, y - 1, Table::BALL_DIAMETER + 3, Table::BALL_DIAMETER + 3};
+}
 
-    // Check for collisions between balls
-    for (auto& ball : m_Balls)
+void Game::collectDamage()
+{
+    const auto& balls = m_FrameBalls;
+    if (balls.size() != m_DrawnBalls.size())
+    {
+        m_NeedsFullRedraw = true;
+        m_DrawnBalls = balls;
+    }
+
+    // A ball which moved needs to be rubbed out where it was, and drawn
+    // where it is now.
+    for (size_t i = 0; i < balls.size(); ++i)
     {
-        for (auto& otherBall : m_Balls)
+        const Ball& ball = balls[i];
+        Ball& drawn = m_DrawnBalls[i];
+        if (glm::all(glm::equal(ball.position, drawn.position)) &&
+            glm::all(glm::equal(ball.m_Orientation, drawn.m_Orientation)) &&
+            ball.m_Type == drawn.m_Type &&
+            ball.m_IsPocketed == drawn.m_IsPocketed)
         {
-            // Skip if same ball
-            if (&ball == &otherBall)
-            {
-                continue;
-            }
+            continue;
+        }
 
-            // If the circles don't intersect, then there is no collision
-            if (glm::distance(ball.position, otherBall.position) > static_cast<float>(BALL_DIAMETER))
-            {
-                continue;
-            }
+        if ( ! drawn.m_IsPocketed)
+        {
+            addDamage(getBallRect(drawn.position));
+        }
+        if ( ! ball.m_IsPocketed)
+        {
+            addDamage(getBallRect(ball.position));
+        }
+        drawn = ball;
+    }
 
-            // Perfectly elastic collision. Operates in the reference frame
-            // of the target (i.e. the target is at rest).
-            const auto speed = glm::length(ball.velocity);
-            auto force = 0.01f * (otherBall.position - ball.position) * speed * speed;
-            m_BallForces.push_back({&otherBall, force, 0.0f});
+    // Only the strip between the old and new fill levels changes.
+    const int powerBarHeight {getPowerBarFillHeight(m_FrameShotPower)};
+    if (powerBarHeight != m_DrawnPowerBarHeight)
+    {
+        const int highest {std::max(powerBarHeight, m_DrawnPowerBarHeight)};
+        const int lowest {std::min(powerBarHeight, m_DrawnPowerBarHeight)};
+        addDamage({
+            POWER_BAR_LEFT_COORD,
+            POWER_BAR_TOP_COORD + POWER_BAR_HEIGHT - highest,
+            POWER_BAR_WIDTH,
+            highest - lowest
+        });
+        m_DrawnPowerBarHeight = powerBarHeight;
+    }
 
-            // The equal and opposite reaction force (Newton's Third Law)
-            m_BallForces.push_back({&ball, -force, 0.0f});
+    // Rub out the old aim paths and draw the new ones.
+    if (m_AimChanged)
+    {
+        if ( ! SDL_RectEmpty(&m_DrawnAimRect))
+        {
+            addDamage(m_DrawnAimRect);
+        }
 
+        const SDL_Rect cueRect {getPathRect(m_CueAimPath)};
+        const SDL_Rect objectRect {getPathRect(m_ObjectAimPath)};
+        SDL_UnionRect(&cueRect, &objectRect, &m_DrawnAimRect);
+        if ( ! SDL_RectEmpty(&m_DrawnAimRect))
+        {
+            addDamage(m_DrawnAimRect);
         }
+        m_AimChanged = false;
     }
 
-    // Check for collisions between balls and bumpers
-    const auto BALL_RADIUS = static_cast<float>(BALL_DIAMETER) / 2.0f;
-    for (auto &ball : m_Balls)
+    // The overlay changes every frame while it's up.
+    if (m_IsProfilerShown)
     {
-        // Right Bumper
+        addDamage(getProfilerRect());
+    }
+
+    if (m_NeedsFullRedraw)
+    {
+        m_Damage.assign(1, SDL_Rect {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT});
+        m_NeedsFullRedraw = false;
+    }
+}
+
+void Game::addDamage(SDL_Rect rect)
+{
+    // Swallow up anything the new rect overlaps, so that nothing gets
+    // drawn twice. It might overlap more once it's grown, so start over.
+    size_t i {0};
+    while (i < m_Damage.size())
+    {
+        if (SDL_HasIntersection(&rect, &m_Damage[i]))
         {
-            // Check if the rightmost point of the circle is behind the line
-            // of the bumper.
-            const auto WALL_COORD = static_cast<float>(FELT_LEFT_COORD + FELT_WIDTH);
-            if (ball.position.x + BALL_RADIUS >= WALL_COORD)
-            {
-                // Do a simple reflection off of the surface: perfectly
-                // elastic collision. Doesn't impart a BallForce (for now).
-                ball.velocity = glm::reflect(ball.velocity, glm::vec2{-1.0f, 0.0f});
-                continue;
-            }
+            const SDL_Rect other {m_Damage[i]};
+            SDL_UnionRect(&rect, &other, &rect);
+            m_Damage[i] = m_Damage.back();
+            m_Damage.pop_back();
+            i = 0;
         }
+        else
+        {
+            ++i;
+        }
+    }
+    m_Damage.push_back(rect);
+}
 
-        // Left Bumper
+void Game::queueBalls()
+{
+    // The flat sprites are only there for when streaming textures aren't.
+    const RenderTexture texture {m_BallTexture.getTexture() ? RenderTexture::Balls : RenderTexture::Sprites};
+
+    const float SIZE {Table::BALL_DIAMETER};
+    for (size_t i = 0; i < m_FrameBalls.size(); ++i)
+    {
+        const Ball& ball = m_FrameBalls[i];
+        if (ball.m_IsPocketed)
         {
-            const auto WALL_COORD = static_cast<float>(FELT_LEFT_COORD);
-            if (ball.position.x - BALL_RADIUS <= WALL_COORD)
-            {
-                ball.velocity = glm::reflect(ball.velocity, glm::vec2{1.0f, 0.0f});
-                continue;
-            }
+            continue;
         }
 
-        // Top Bumper
+        // Draw balls relative to center
+        m_RenderQueue.drawSprite(
+            RenderLayer::Balls,
+            texture,
+            getBallSpriteRect(i),
+            ball.position.x - SIZE / 2,
+            ball.position.y - SIZE / 2,
+            SIZE,
+            SIZE
+        );
+    }
+}
+
+SDL_Rect Game::getBallSpriteRect(size_t ballIndex) const
+{
+    if (m_BallTexture.getTexture())
+    {
+        return m_BallTexture.getSpriteRect(ballIndex);
+    }
+    return m_Sprites.getCurrent().m_BallSpriteRects[static_cast<size_t>(m_FrameBalls[ballIndex].m_Type)];
+}
+
+int Game::simulationThread(void* pUserData)
+{
+    static_cast<Game*>(pUserData)->runSimulation();
+    return 0;
+}
+
+void Game::runSimulation()
+{
+    LOG("Simulation thread started \n");
+    Tracer::setThreadName("simulation");
+
+    const Uint64 frequency {SDL_GetPerformanceFrequency()};
+    const Uint64 ticksPerStep {frequency / STEPS_PER_SECOND};
+    Uint64 nextStep {SDL_GetPerformanceCounter()};
+    while (m_IsSimulating.load(std::memory_order_acquire))
+    {
+        const Uint64 now {SDL_GetPerformanceCounter()};
+        if (now < nextStep)
         {
-            const auto WALL_COORD = static_cast<float>(FELT_TOP_COORD);
-            if (ball.position.y - BALL_RADIUS <= WALL_COORD)
-            {
-                ball.velocity = glm::reflect(ball.velocity, glm::vec2{0.0f, -1.0f});
-                continue;
-            }
+            SDL_Delay(static_cast<Uint32>((nextStep - now) * 1000 / frequency));
+            continue;
         }
 
-        // Bottom Bumper
+        simulateStep();
+        nextStep += ticksPerStep;
+
+        // If we've fallen a long way behind (stopped in a debugger, say)
+        // don't try to catch it all up at once.
+        if (now > nextStep + frequency / 10)
         {
-            const auto WALL_COORD = static_cast<float>(FELT_TOP_COORD + FELT_HEIGHT);
-            if (ball.position.y + BALL_RADIUS >= WALL_COORD)
+            nextStep = now;
+        }
+    }
+
+    LOG("Simulation thread stopped \n");
+}
+
+void Game::simulateStep()
+{
+    TRACE_SCOPE("step", "simulation");
+    ALLOCATION_SCOPE(Simulation);
+
+    static float time {0.0};
+    time += 0.001;
+
+    Command command {};
+    while (m_Commands.pop(command))
+    {
+        handleCommand(command);
+    }
+
+    recordPreviousPositions();
+    m_Table.step();
+    if (m_Table.getEvents().getDroppedCount() > 0)
+    {
+        LOG("Dropped %zu table events \n", m_Table.getEvents().getDroppedCount());
+    }
+    playCollisionSounds();
+    updateRules();
+
+    m_Rewind.record(m_Table, m_Rules);
+    StateExport::publish(m_Table);
+
+    m_ShotPower = 0.5 * (std::sin(8 * time) + 1.0);
+
+    publishSnapshot();
+}
+
+void Game::handleCommand(const Command& command)
+{
+    switch (command.m_Type)
+    {
+        case CommandType::Shoot:
+        {
+            const Ball& cueBall = m_Table.getBalls()[0];
+            const glm::vec2 force {getShotForce(cueBall.position, command.m_Target, m_ShotPower)};
+
+            // Hitting the cue ball again while it's still moving just
+            // counts as part of the same shot.
+            if (m_Table.isAtRest() && ! m_Rules.isShotInProgress() && ! m_Rules.isGameOver())
             {
-                ball.velocity = glm::reflect(ball.velocity, glm::vec2{0.0f, 1.0f});
-                continue;
+                m_Rules.beginShot();
             }
+            m_Table.applyForce(0, force);
+            m_Rewind.capture(m_Table, m_Rules);
+            break;
+        }
+
+        case CommandType::Rack:
+        {
+            m_Table.rackBalls();
+            m_Rules.rack();
+            m_Rewind.capture(m_Table, m_Rules);
+            printTurn();
+            break;
+        }
+
+        case CommandType::Freeze:
+        {
+            m_Table.freezeBalls();
+            m_Rewind.capture(m_Table, m_Rules);
+            break;
+        }
+
+        case CommandType::Rewind:
+        {
+            rewind(1.0f);
+            break;
         }
     }
+}
+
+void Game::recordPreviousPositions()
+{
+    // Where the balls are before the step, for the render thread to
+    // interpolate from. Anything that teleports a ball (a rack, a rewind,
+    // ...) has already happened by now, so those don't get smeared out.
+    auto& snapshot = m_Snapshots.getWriteBuffer();
+    snapshot.m_PreviousPositions.clear();
+    for (const auto& ball : m_Table.getBalls())
+    {
+        snapshot.m_PreviousPositions.push_back(ball.position);
+    }
+}
+
+void Game::publishSnapshot()
+{
+    auto& snapshot = m_Snapshots.getWriteBuffer();
+    snapshot.m_Balls.assign(m_Table.getBalls().begin(), m_Table.getBalls().end());
+    snapshot.m_PublishedAt = SDL_GetPerformanceCounter();
+    snapshot.m_StepCount = m_Table.getStepCount();
+    snapshot.m_TableStats = m_Table.getStats();
+    snapshot.m_ShotPower = m_ShotPower;
+    snapshot.m_CanShoot = m_Table.isAtRest() && ! m_Rules.isShotInProgress() && ! m_Rules.isGameOver();
+    m_Snapshots.publish();
+}
+
+void Game::updateFrameBalls()
+{
+    m_Snapshots.update();
+    const FrameSnapshot& snapshot = m_Snapshots.getReadBuffer();
+
+    // Draw the balls part of the way between the last two steps, depending
+    // on how long it's been since the newest one. That's never ahead of the
+    // simulation, just up to a step behind it, but it moves smoothly even
+    // when the frame rate and step rate don't line up.
+    const Uint64 now {SDL_GetPerformanceCounter()};
+    const Uint64 elapsed {now > snapshot.m_PublishedAt ? now - snapshot.m_PublishedAt : 0};
+    const Uint64 ticksPerStep {SDL_GetPerformanceFrequency() / STEPS_PER_SECOND};
+    const float alpha {std::min(1.0f, static_cast<float>(elapsed) / ticksPerStep)};
+
+    m_FrameBalls.assign(snapshot.m_Balls.begin(), snapshot.m_Balls.end());
+    for (size_t i = 0; i < m_FrameBalls.size() && i < snapshot.m_PreviousPositions.size(); ++i)
+    {
+        // Written this way round so that a ball which hasn't moved ends up
+        // exactly where it was, and doesn't get redrawn.
+        const glm::vec2& previous = snapshot.m_PreviousPositions[i];
+        m_FrameBalls[i].position = previous + (m_FrameBalls[i].position - previous) * alpha;
+    }
+    m_FrameShotPower = snapshot.m_ShotPower;
+    m_FrameCanShoot = snapshot.m_CanShoot;
+}
+
+void Game::updateAimPrediction()
+{
+    PROFILE_SCOPE(Prediction);
 
-    // Apply friction forces
-    for (auto& ball : m_Balls)
+    const bool hasCueBall {! m_FrameBalls.empty() && ! m_FrameBalls[0].m_IsPocketed};
+    if ( ! m_FrameCanShoot || ! m_IsMouseInWindow || ! hasCueBall)
     {
-        const auto speed = glm::length(ball.velocity);
+        m_IsAiming = false;
+        clearAimPaths();
+        return;
+    }
 
-        // This is a rough (bad) analog of static friction.
-        if (speed < STATIC_FRICTION_THRESHOLD)
+    bool ballsMoved {! m_IsAiming || m_AimBalls.size() != m_FrameBalls.size()};
+    for (size_t i = 0; i < m_FrameBalls.size() && ! ballsMoved; ++i)
+    {
+        ballsMoved =
+            ! glm::all(glm::equal(m_FrameBalls[i].position, m_AimBalls[i].position)) ||
+            m_FrameBalls[i].m_IsPocketed != m_AimBalls[i].m_IsPocketed;
+    }
+    const bool targetMoved {! glm::all(glm::equal(m_MousePosition, m_AimTarget))};
+    const bool powerDrifted {std::fabs(m_FrameShotPower - m_AimShotPower) > AIM_SHOT_POWER_TOLERANCE};
+
+    if (ballsMoved || targetMoved || powerDrifted)
+    {
+        // A new aim should show up straight away, even half worked out.
+        // If it's only the power that changed, the old paths are close
+        // enough to leave up until the new ones are done, which saves them
+        // flickering back to nothing every time.
+        m_ShowPartialAim = m_ShowPartialAim || ballsMoved || targetMoved;
+
+        m_AimBalls.assign(m_FrameBalls.begin(), m_FrameBalls.end());
+        m_AimTarget = m_MousePosition;
+        m_AimShotPower = m_FrameShotPower;
+        m_AimPredictor.start(m_AimBalls, getShotForce(m_AimBalls[0].position, m_AimTarget, m_AimShotPower));
+        m_IsAiming = true;
+    }
+
+    if (m_AimPredictor.isComplete())
+    {
+        return;
+    }
+
+    const bool isComplete {m_AimPredictor.refine(AIM_BUDGET)};
+    if (isComplete || m_ShowPartialAim)
+    {
+        showAimPaths();
+    }
+    if (isComplete)
+    {
+        m_ShowPartialAim = false;
+    }
+}
+
+void Game::showAimPaths()
+{
+    auto toPoints = [](const std::vector<glm::vec2>& path, std::vector<SDL_Point>& points)
+    {
+        points.clear();
+        for (const auto& position : path)
         {
-            ball.velocity = {0.0f, 0.0f};
+            points.push_back({static_cast<int>(std::lround(position.x)), static_cast<int>(std::lround(position.y))});
         }
-        else
+    };
+    toPoints(m_AimPredictor.getCuePath(), m_CueAimPath);
+    toPoints(m_AimPredictor.getObjectPath(), m_ObjectAimPath);
+    m_AimChanged = true;
+}
+
+void Game::clearAimPaths()
+{
+    if ( ! m_CueAimPath.empty() || ! m_ObjectAimPath.empty())
+    {
+        m_CueAimPath.clear();
+        m_ObjectAimPath.clear();
+        m_AimChanged = true;
+    }
+}
+
+void Game::playCollisionSounds()
+{
+    for (const auto& event : m_Table.getEvents())
+    {
+        // A ball dropping into a pocket has no sound of its own (yet), and
+        // shouldn't thud like a cushion.
+        if (event.m_Type == TableEventType::Pocket)
         {
-            // This is a rough analog of dynamic friction.
-            // F = (coefficient)(normal force)
-            //   The normal force is, on a flat pool table, just gravity.
-            //   This can be approximated with the mass of the ball.
+            continue;
+        }
+
+        const Sound sound {
+            event.m_Type == TableEventType::BallContact ? Sound::BallClick : Sound::CushionThud
+        };
+        m_Audio.play(sound, event.m_RelativeSpeed / LOUDEST_IMPACT_SPEED);
+    }
+}
 
-            // The friction should oppose the direction of motion, but
-            // I'm not sure how the proper physics equations work at the
-            // moment. I'll just fake it for now.
-            const glm::vec2 friction = -ball.velocity * (FRICTION_COEFFICIENT / BALL_MASS / speed);
-            m_BallForces.push_back({&ball, friction, 0.0f});
+void Game::updateRules()
+{
+    if (m_Rules.isShotInProgress())
+    {
+        m_Rules.consume(m_Table.getEvents(), m_Table.getBalls());
+        if (m_Table.isAtRest())
+        {
+            finishShot();
         }
     }
+}
 
-    // (Poorly) integrate acceleration
-    for (auto& force : m_BallForces)
+void Game::finishShot()
+{
+    const ShotResult result = m_Rules.endShot();
+
+    if (result.m_ReRack)
     {
-        // F = ma  =>  a = F/m
-        // V = (integral of a from t=0 to t=time) = (sum acceleration from each frame)
-        glm::vec2 acceleration = force.m_Force / BALL_MASS;
-        force.m_pBall->velocity += acceleration;
+        std::cout << "The black went down on the break! Re-racking. \n";
+        m_Table.rackBalls();
+        m_Rewind.capture(m_Table, m_Rules);
+        printTurn();
+        return;
     }
 
-    for (auto& ball : m_Balls)
+    if (result.m_CueBallPocketed)
     {
-        ball.position += 1000.0f * deltaTime * ball.velocity;
+        m_Table.respotBall(0, Table::getCueSpot());
     }
+    m_Rewind.capture(m_Table, m_Rules);
 
-    // Update forces, removing expired ones
-    for (auto& force : m_BallForces)
+    if (result.m_Foul != Foul::None)
     {
-        force.m_Duration -= deltaTime;
+        std::cout << "Foul: " << getFoulDescription(result.m_Foul) << ". \n";
     }
-    auto it = std::remove_if(begin(m_BallForces), end(m_BallForces), [](const auto& force)
+
+    if (result.m_GameOver)
     {
-        return force.m_Duration < 0.0f;
-    });
-    m_BallForces.erase(it, end(m_BallForces));
+        std::cout
+            << "Player " << (result.m_Winner + 1) << " wins! "
+            << "Press \"R\" to play again. \n"
+            << std::endl;
+        return;
+    }
 
-    // printf("# forces = %zu \n", m_BallForces.size());
+    printTurn();
+}
+
+void Game::rewind(float seconds)
+{
+    const auto steps = static_cast<uint64_t>(seconds / Table::TIME_STEP);
+    const uint64_t now {m_Table.getStepCount()};
+    uint64_t target {now > steps ? now - steps : 0};
+    if (target < m_Rewind.getOldestStep())
+    {
+        target = m_Rewind.getOldestStep();
+    }
 
-    lastTime = time;
+    if ( ! m_Rewind.restore(m_Table, m_Rules, target))
+    {
+        return;
+    }
+
+    // The keyframe is probably a little before the target, so play the
+    // rest of the way forward (keeping score as we go).
+    while (m_Table.getStepCount() < target)
+    {
+        m_Table.step();
+        updateRules();
+    }
+}
+
+void Game::printTurn()
+{
+    const uint8_t player {m_Rules.getCurrentPlayer()};
+    std::cout << "Player " << (player + 1) << " to shoot";
+    switch (m_Rules.getPlayerGroup(player))
+    {
+        case BallGroup::Solids:  std::cout << " (solids)";  break;
+        case BallGroup::Stripes: std::cout << " (stripes)"; break;
+        case BallGroup::None:    std::cout << " (open table)"; break;
+    }
+    std::cout << std::endl;
+}
+
+void Game::printFrameStats()
+{
+    const FrameStats stats = m_FramePacer.getStats();
+    std::cout
+        << "Frames: " << stats.m_FrameCount
+        << " at a target of " << m_FramePacer.getTargetFrameRate() << " per second, "
+        << stats.m_MissedCount << " late \n"
+        << "Frame time (ms): "
+        << "min " << stats.m_MinFrameTime
+        << ", mean " << stats.m_MeanFrameTime
+        << ", 99th percentile " << stats.m_P99FrameTime
+        << ", max " << stats.m_MaxFrameTime
+        << ", mean work " << stats.m_MeanWorkTime
+        << std::endl;
+
+    if (m_Options.m_pFrameStatsPath && ! m_FramePacer.writeHistogram(m_Options.m_pFrameStatsPath))
+    {
+        std::cerr << "Could not write frame stats to " << m_Options.m_pFrameStatsPath << std::endl;
+    }
 }
 
 void Game::handleInput()
 {
+    PROFILE_SCOPE(Input);
+    ALLOCATION_SCOPE(Input);
+
     SDL_Event event;
     while (SDL_PollEvent(&event))
     {
@@ -531,6 +1111,47 @@ void Game::handleInput()
                 break;
             }
 
+            case SDL_WINDOWEVENT:
+            {
+                if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                {
+                    createRenderTargets();
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                {
+                    // The window needs repainting even if nothing moved.
+                    m_NeedsFullRedraw = true;
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_ENTER)
+                {
+                    m_IsMouseInWindow = true;
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_LEAVE)
+                {
+                    m_IsMouseInWindow = false;
+                }
+                break;
+            }
+
+            // Only the latest position matters; the aim is updated from it
+            // once per frame.
+            case SDL_MOUSEMOTION:
+            {
+                m_MousePosition = toLogical(event.motion.x, event.motion.y);
+                m_IsMouseInWindow = true;
+                break;
+            }
+
+            // Some renderers lose the contents of target textures when
+            // the device is reset, so the background and frame have to be
+            // redrawn.
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+            {
+                createRenderTargets();
+                break;
+            }
+
             // case SDL_MOUSEBUTTONUP:
             case SDL_MOUSEBUTTONDOWN:
             {
@@ -554,19 +1175,25 @@ void Game::handleKeyPress(SDL_Keycode keycode)
 
         case SDLK_r:
         {
-            m_BallForces.clear();
-            m_Balls.clear();
-            createBalls();
+            sendCommand({CommandType::Rack, {}});
             break;
         }
 
         case SDLK_f:
         {
-            for (auto& ball : m_Balls)
-            {
-                ball.velocity = {0, 0};
-            }
-            m_BallForces.clear();
+            sendCommand({CommandType::Freeze, {}});
+            break;
+        }
+
+        case SDLK_LEFT:
+        {
+            sendCommand({CommandType::Rewind, {}});
+            break;
+        }
+
+        case SDLK_p:
+        {
+            toggleProfilerOverlay();
             break;
         }
 
@@ -585,46 +1212,84 @@ void Game::handleMouseClick(const SDL_MouseButtonEvent* pEvent)
     {
         case SDL_BUTTON_LEFT:
         {
-            Ball *pCueBall = &m_Balls[0];
-
-            glm::vec2 force {
-                (pEvent->x - pCueBall->position.x),
-                (pEvent->y - pCueBall->position.y)
-            };
-            force *= SHOT_POWER_MULTIPLIER * (m_ShotPower + SHOT_POWER_OFFSET);
-
-            m_BallForces.push_back({pCueBall, force, 0.0f});
-
+            const glm::vec2 target {toLogical(pEvent->x, pEvent->y)};
+            sendCommand({CommandType::Shoot, target});
             break;
         }
 
     }
 }
 
+void Game::sendCommand(const Command& command)
+{
+    if ( ! m_Commands.push(command))
+    {
+        LOG("Dropped a command; the simulation isn't keeping up \n");
+    }
+}
+
 
 bool Game::start()
 {
-    DEBUG_LOG("Starting game \n");
+    LOG("Starting game \n");
 
     if ( ! initGame())
     {
         return false;
     }
 
+    m_IsSimulating.store(true, std::memory_order_release);
+    m_pSimulationThread = SDL_CreateThread(simulationThread, "simulation", this);
+    if ( ! m_pSimulationThread)
+    {
+        teardownGame();
+        return false;
+    }
+
     m_IsRunning = true;
     while (m_IsRunning)
     {
-        simulateFrame();
+        TRACE_SCOPE("frame", "frame");
+        m_FramePacer.beginFrame();
 
-        SDL_SetRenderDrawColor(m_pRenderer, 0x64, 0x95, 0xed, 0xff);
-        SDL_RenderClear(m_pRenderer);
-        renderFrame();
-        SDL_RenderPresent(m_pRenderer);
+        handleInput();
 
-        SDL_Delay(2);
+        // Sprites for a new window size get built in the background; once
+        // they're ready, the rolling balls and the pockets in the
+        // background need them too.
+        if (m_Sprites.update(m_pRenderer))
+        {
+            createBallTexture();
+            createBackgroundTexture();
+            m_NeedsFullRedraw = true;
+        }
+
+        updateFrameBalls();
+        updateAimPrediction();
+
+        // Don't present at all if nothing on screen has changed.
+        const bool presented {renderFrame()};
+        if (presented)
+        {
+            PROFILE_SCOPE(Present);
+            SDL_RenderPresent(m_pRenderer);
+        }
+        Profiler::collect();
+        Tracer::writeIfRequested();
+        AllocationTracker::endFrame();
+
+        const FrameSnapshot& snapshot = m_Snapshots.getReadBuffer();
+        Telemetry::publish(snapshot.m_TableStats, snapshot.m_StepCount);
+
+        m_FramePacer.endFrame(presented);
     }
 
+    m_IsSimulating.store(false, std::memory_order_release);
+    SDL_WaitThread(m_pSimulationThread, nullptr);
+    m_pSimulationThread = nullptr;
+
     teardownGame();
+    printFrameStats();
 
     return true;
 }
@@ -632,7 +1297,7 @@ bool Game::start()
 
 bool Game::setupSDL()
 {
-    DEBUG_LOG("Setting up SDL \n");
+    LOG("Setting up SDL \n");
 
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
     {
@@ -645,29 +1310,62 @@ bool Game::setupSDL()
         SDL_WINDOWPOS_UNDEFINED,
         WINDOW_WIDTH,
         WINDOW_HEIGHT,
-        SDL_WINDOW_SHOWN
+        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
     );
     if ( ! m_pWindow)
     {
         return false;
     }
-
-    m_pRenderer = SDL_CreateRenderer(m_pWindow, -1, SDL_RENDERER_ACCELERATED);
+    SDL_SetWindowMinimumSize(m_pWindow, WINDOW_WIDTH / 4, WINDOW_HEIGHT / 4);
+
+    // With no frame rate given, let the display set the pace.
+    const bool wantVsync {m_Options.m_FrameRate <= 0.0};
+    m_pRenderer = SDL_CreateRenderer(
+        m_pWindow,
+        -1,
+        SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | (wantVsync ? SDL_RENDERER_PRESENTVSYNC : 0)
+    );
     if ( ! m_pRenderer)
     {
         return false;
     }
 
+    // Not every renderer can do vsync, so check whether we actually got it.
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(m_pRenderer, &info) == 0)
+    {
+        m_FramePacer.setVsync((info.flags & SDL_RENDERER_PRESENTVSYNC) != 0);
+    }
+
+    if (wantVsync)
+    {
+        SDL_DisplayMode mode;
+        const bool knowsRefreshRate {SDL_GetWindowDisplayMode(m_pWindow, &mode) == 0 && mode.refresh_rate > 0};
+        m_FramePacer.setTargetFrameRate(knowsRefreshRate ? mode.refresh_rate : 60.0);
+    }
+    else
+    {
+        m_FramePacer.setTargetFrameRate(m_Options.m_FrameRate);
+    }
+
     if (SDL_SetRenderDrawBlendMode(m_pRenderer, SDL_BLENDMODE_BLEND) != 0)
     {
         return false;
     }
 
+    // The game is still playable without sound.
+    if ( ! m_Audio.open())
+    {
+        LOG("Could not open audio device: %s \n", SDL_GetError());
+    }
+
     return true;
 }
 
 void Game::teardownSDL()
 {
+    m_Audio.close();
+
     if (m_pRenderer)
     {
         SDL_DestroyRenderer(m_pRenderer);
@@ -3,120 +3,346 @@
 #define GAME_HPP
 
 #include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <vector>
-#include <map>
 
 #include <SDL2/SDL.h>
 #include <glm/vec2.hpp>
 
-
-enum class BallType
+#include "Table.hpp"
+#include "Audio.hpp"
+#include "Rules.hpp"
+#include "Rewind.hpp"
+#include "SpscRing.hpp"
+#include "TripleBuffer.hpp"
+#include "FramePacer.hpp"
+#include "AimPredictor.hpp"
+#include "SpriteCache.hpp"
+#include "BallTexture.hpp"
+#include "RenderQueue.hpp"
+#include "Profiler.hpp"
+
+
+// Settings from the command line
+struct GameOptions
 {
-    Cue,
-    Black,
-
-    Yellow,
-    Blue,
-    Red,
-    Purple,
-    Orange,
-    Green,
-    Maroon,
-
-    YellowStripe,
-    BlueStripe,
-    RedStripe,
-    PurpleStripe,
-    OrangeStripe,
-    GreenStripe,
-    MaroonStripe,
-};
-
-
-struct Ball
-{
-    glm::vec2 position, velocity;
-    SDL_Texture* m_pTexture;
-
-    Ball(SDL_Texture* pTexture);
-};
-
-
-struct BallForce
-{
-    Ball *m_pBall;
-    glm::vec2 m_Force;
-    float m_Duration;  // Time left before force stops (0.0 for one frame)
-
-    BallForce(Ball *pBall, glm::vec2 force, float duration);
+    // Frames per second to aim for. Zero means match the display, and
+    // wait for vsync.
+    double m_FrameRate;
+
+    // If set, the frame time histogram is written here as CSV on exit.
+    const char* m_pFrameStatsPath;
+
+    // If set, play a game by itself with no window, and record it here
+    // instead. Files ending in ".y4m" are written as Y4M video, and
+    // anything else as a stream of PPM images.
+    const char* m_pCapturePath;
+    float m_CaptureSeconds;
+    int m_CaptureFrameRate;
+
+    // If set, time the phases of every frame from the start, and write
+    // the stats here as CSV on exit.
+    const char* m_pProfilePath;
+
+    // If set, record a timeline of every thread from the start, and write
+    // it here as Chrome trace-event JSON on exit (or on SIGUSR1).
+    const char* m_pTracePath;
+
+    // If set, count heap allocations by frame and subsystem, and write the
+    // counts here as CSV on exit. In strict mode, abort if the simulation
+    // or rendering allocates at all once they've warmed up.
+    const char* m_pAllocationStatsPath;
+    bool m_IsAllocationStrict;
+
+    // If set, write log messages here ("-" for stderr). Debug builds log
+    // to stderr regardless.
+    const char* m_pLogPath;
+
+    // Publish live counters through shared memory, for billiards-top.
+    bool m_IsTelemetryEnabled;
+
+    // Publish every step's ball positions and velocities through shared
+    // memory, for external tools.
+    bool m_IsStateExportEnabled;
+
+    // If non-zero, play this many games by themselves, side by side,
+    // instead of one interactive one.
+    size_t m_TournamentSize;
+    bool m_IsTournamentBenchmark;
+
+    GameOptions() :
+        m_FrameRate {0.0},
+        m_pFrameStatsPath {nullptr},
+        m_pCapturePath {nullptr},
+        m_CaptureSeconds {30.0f},
+        m_CaptureFrameRate {60},
+        m_pProfilePath {nullptr},
+        m_pTracePath {nullptr},
+        m_pAllocationStatsPath {nullptr},
+        m_IsAllocationStrict {false},
+        m_pLogPath {nullptr},
+        m_IsTelemetryEnabled {false},
+        m_IsStateExportEnabled {false},
+        m_TournamentSize {0},
+        m_IsTournamentBenchmark {false}
+    {
+    }
 };
 
 
 class Game
 {
 public:
-    Game();
+    explicit Game(const GameOptions& options);
     ~Game();
 
     bool start();
     bool setupSDL();
 
 private:
+    // Input that changes the table, sent from the render thread to the
+    // simulation thread.
+    enum class CommandType : uint8_t
+    {
+        Shoot,   // Towards m_Target
+        Rack,
+        Freeze,
+        Rewind,
+    };
+
+    struct Command
+    {
+        CommandType m_Type;
+        glm::vec2 m_Target;
+    };
+
+    // Everything the render thread needs to draw the table, published by
+    // the simulation thread after every step.
+    struct FrameSnapshot
+    {
+        std::vector<Ball> m_Balls;
+        std::vector<glm::vec2> m_PreviousPositions;  // One step earlier, for interpolating
+        uint64_t m_PublishedAt;  // Performance counter
+        uint64_t m_StepCount;
+        TableStats m_TableStats;
+        float m_ShotPower;
+        bool m_CanShoot;  // Everything's stopped and it's someone's turn
+
+        FrameSnapshot() :
+            m_Balls {},
+            m_PreviousPositions {},
+            m_PublishedAt {0},
+            m_StepCount {0},
+            m_TableStats {},
+            m_ShotPower {0.0f},
+            m_CanShoot {false}
+        {
+            // Nothing should need to allocate once the game is running.
+            m_Balls.reserve(BALL_TYPE_COUNT);
+            m_PreviousPositions.reserve(BALL_TYPE_COUNT);
+        }
+    };
+
     void teardownSDL();
 
+    bool updateView();
+    SDL_Rect toPhysical(const SDL_Rect& rect) const;
+    glm::vec2 toLogical(int x, int y) const;
+
     bool initGame();
-    void simulateFrame();
-    void renderFrame();
+
+    static int simulationThread(void* pUserData);
+    void runSimulation();
+    void simulateStep();
+    void handleCommand(const Command& command);
+    void recordPreviousPositions();
+    void publishSnapshot();
+    void updateFrameBalls();
+    void updateAimPrediction();
+    void showAimPaths();
+    void clearAimPaths();
+
+    void renderBackground();
+    bool renderFrame();
+    void queuePowerBar();
+    void queueAimPaths();
+    void queueBalls();
+    void queueProfilerOverlay();
+    void toggleProfilerOverlay();
+    SDL_Rect getBallSpriteRect(size_t ballIndex) const;
+    void collectDamage();
+    void addDamage(SDL_Rect rect);
+    static SDL_Rect getBallRect(const glm::vec2& position);
+    static SDL_Rect getPathRect(const std::vector<SDL_Point>& path);
     void teardownGame();
 
     void printHelp();
 
-    void simulatePhysics(float time);
-
-    SDL_Texture* createBallTexture(uint8_t red, uint8_t green, uint8_t blue, bool hasStripe);
     bool createTextures();
-
-    void createBalls();
+    void createBallTexture();
+    bool createBackgroundTexture();
+    bool createFrameTexture();
+    bool createRenderTargets();
+
+    void playCollisionSounds();
+    void updateRules();
+    void finishShot();
+    void rewind(float seconds);
+    void printTurn();
+    void printFrameStats();
 
     void handleInput();
+    void sendCommand(const Command& command);
     void handleKeyPress(SDL_Keycode sym);
     void handleMouseClick(const SDL_MouseButtonEvent* pEvent);
 
 public:
+    // Everything is laid out in logical units, in a space this big. The
+    // window opens at this size (in points), but can be resized; the whole
+    // space is then scaled to fit, keeping its shape.
     static const uint16_t WINDOW_WIDTH {1100};
     static const uint16_t WINDOW_HEIGHT {600};
 
+    // Roughly the rate the old single-threaded loop managed, so shots
+    // still feel the same.
+    static const uint32_t STEPS_PER_SECOND {400};
+
+    // Where everything goes on screen. These are shared with the software
+    // compositor, so that captures look just like the game.
+    struct BackgroundRect
+    {
+        SDL_Rect m_Rect;
+        SDL_Color m_Color;
+    };
+    static const size_t BACKGROUND_RECT_COUNT {11};
+
+    // The flat-coloured parts of the background, back to front.
+    static std::array<BackgroundRect, BACKGROUND_RECT_COUNT> getBackgroundRects();
+    static SDL_Rect getPocketRect(const glm::vec2& pocket);
+
+    static int getPowerBarFillHeight(float shotPower);
+    static SDL_Rect getPowerBarFillRect(int height);
+    static constexpr SDL_Color POWER_BAR_FILL_COLOR {206, 13, 13, 0xff};
+
+    static const uint16_t POWER_BAR_LEFT_COORD {Table::FELT_WIDTH + Table::BUMPER_WIDTH + 150};
+    static const uint16_t POWER_BAR_TOP_COORD {Table::FELT_TOP_COORD};
+    static const uint16_t POWER_BAR_HEIGHT {Table::FELT_HEIGHT};
+    static const uint16_t POWER_BAR_WIDTH {40};
+    static const uint16_t POWER_BAR_BORDER_WIDTH {10};
+
+    // The push a shot towards `target` gets from the cue
+    static glm::vec2 getShotForce(const glm::vec2& cueBall, const glm::vec2& target, float shotPower);
+
+    // Ball sprites for a view drawn at `scale` pixels per logical unit
+    static int getSpriteSize(float scale);
+
 private:
+    GameOptions m_Options;
     bool m_IsRunning;
+    FramePacer m_FramePacer;
 
     SDL_Window* m_pWindow;
     SDL_Renderer* m_pRenderer;
 
-    std::map<BallType, SDL_Texture*> m_BallTextures;
-    std::vector<Ball> m_Balls;
-    std::vector<BallForce> m_BallForces;
+    // Logical to physical (renderer output) coordinates: scale by
+    // m_ViewScale, then offset to m_ViewRect, which is centred in the
+    // window. Mouse events come in points, which on a high-DPI display
+    // aren't the same as pixels, hence m_PixelsPerPoint.
+    float m_ViewScale;
+    SDL_Rect m_ViewRect;
+    float m_PixelsPerPoint;
+
+    // All of the ball sprites (and the pocket) live in one texture, drawn
+    // at the size they appear on screen. The balls are normally drawn
+    // rolling, from m_BallTexture instead; the flat ones are only for if
+    // that can't be made.
+    SpriteCache m_Sprites;
+    BallTexture m_BallTexture;
+
+    // Everything that moves is queued up once a frame, then drawn into
+    // each damaged part of the frame in turn.
+    RenderQueue m_RenderQueue;
+    SdlRenderBackend m_RenderBackend;
+
+    SDL_Texture* m_pBackgroundTexture;  // Felt, bumpers, pockets and power bar frame
+
+    // The last frame drawn, at the physical size of m_ViewRect. Only the
+    // parts which changed since then are redrawn into it, and it's only
+    // copied to the window if something did. Damage is kept in logical
+    // units.
+    SDL_Texture* m_pFrameTexture;
+    std::vector<Ball> m_DrawnBalls;  // The balls as they are in m_pFrameTexture
+    int m_DrawnPowerBarHeight;
+    std::vector<SDL_Rect> m_Damage;  // Never overlapping
+    bool m_NeedsFullRedraw;
+
+    // The balls for this frame, interpolated between the last two steps
+    std::vector<Ball> m_FrameBalls;
+    float m_FrameShotPower;
+    bool m_FrameCanShoot;
+
+    // Mouse motion just updates the position; the aim is only worked out
+    // again once per frame, however many events there were.
+    glm::vec2 m_MousePosition;
+    bool m_IsMouseInWindow;
+
+    // Where the shot under the mouse would go. The prediction runs a bit
+    // at a time, within AIM_BUDGET each frame, from the balls, target and
+    // power in m_AimBalls, m_AimTarget and m_AimShotPower.
+    AimPredictor m_AimPredictor;
+    std::vector<Ball> m_AimBalls;
+    glm::vec2 m_AimTarget;
+    float m_AimShotPower;
+    bool m_IsAiming;
+    bool m_ShowPartialAim;  // Draw the prediction as it grows, rather than the last finished one
+
+    // The paths as they are on screen
+    std::vector<SDL_Point> m_CueAimPath;
+    std::vector<SDL_Point> m_ObjectAimPath;
+    SDL_Rect m_DrawnAimRect;
+    bool m_AimChanged;
+
+    static constexpr std::chrono::microseconds AIM_BUDGET {1000};
+
+    // The power bar never sits still, so only start the prediction over
+    // once it's drifted this far.
+    static constexpr float AIM_SHOT_POWER_TOLERANCE {0.1f};
+
+    // The profiler's overlay: a bar per phase across the top of the
+    // window, as long as the phase's mean time, with ticks at the 99th
+    // percentile and the maximum.
+    bool m_IsProfilerShown;
+    static SDL_Rect getProfilerRect();
+    static constexpr float PROFILER_POINTS_PER_MS {100.0f};
+    static const int PROFILER_ROW_HEIGHT {5};
+
+    // Physics runs on a thread of its own, at a fixed rate. Input goes to
+    // it through m_Commands, and it hands back what to draw through
+    // m_Snapshots. Neither side ever waits for the other.
+    SDL_Thread* m_pSimulationThread;
+    std::atomic<bool> m_IsSimulating;
+    SpscRing<Command, 64> m_Commands;
+    TripleBuffer<FrameSnapshot> m_Snapshots;
+
+    // Everything from here down belongs to the simulation thread while
+    // it's running.
+    Table m_Table;
+    EightBallRules m_Rules;
+
+    // About a minute and a half of history, at ten keyframes per second
+    static const size_t REWIND_KEYFRAME_CAPACITY {1024};
+    static const uint32_t REWIND_KEYFRAME_INTERVAL {100};
+    RewindBuffer<EightBallRules> m_Rewind;
+    AudioMixer m_Audio;
 
     static constexpr float SHOT_POWER_OFFSET {0.2f};
     static constexpr float SHOT_POWER_MULTIPLIER {0.05f};
     float m_ShotPower;
 
-    static constexpr float BALL_MASS {15.0f};
-    static constexpr float FRICTION_COEFFICIENT {0.04f};
-    static constexpr float STATIC_FRICTION_THRESHOLD {0.002f};
-
-    static const uint16_t BUMPER_WIDTH {50};
-    static const uint16_t FELT_LEFT_COORD {BUMPER_WIDTH * 2};
-    static const uint16_t FELT_TOP_COORD {100};
-    static const uint16_t FELT_WIDTH {800};
-    static const uint16_t FELT_HEIGHT {400};
-
-    static const uint16_t BALL_DIAMETER {35};
-
-    static const uint16_t POWER_BAR_LEFT_COORD {FELT_WIDTH + BUMPER_WIDTH + 150};
-    static const uint16_t POWER_BAR_TOP_COORD {FELT_TOP_COORD};
-    static const uint16_t POWER_BAR_HEIGHT {FELT_HEIGHT};
-    static const uint16_t POWER_BAR_WIDTH {40};
-    static const uint16_t POWER_BAR_BORDER_WIDTH {10};
+    // Relative speed at which an impact is played at full volume
+    static constexpr float LOUDEST_IMPACT_SPEED {1.5f};
 
 
 private:
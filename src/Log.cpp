@@ -0,0 +1,385 @@
+
+#include <stdio.h>
+#include <algorithm>  // for std::sort, std::min
+#include <array>
+#include <cstring>    // for std::memcpy, std::strlen, std::strchr
+#include <thread>
+#include <vector>
+
+#include "Log.hpp"
+#include "SpscRing.hpp"
+
+
+std::atomic<bool> Log::s_IsEnabled {false};
+Log::Clock::time_point Log::s_Epoch {};
+
+
+enum class LogThreadState : int
+{
+    Free,
+    InUse,
+    Retired,  // Its thread has exited, but there may be messages left in it
+};
+
+static const size_t LOG_RING_CAPACITY {1024};
+
+struct LogThread
+{
+    SpscRing<LogRecord, LOG_RING_CAPACITY> m_Ring;
+    std::atomic<LogThreadState> m_State;
+    std::atomic<uint64_t> m_DroppedCount;
+
+    LogThread() :
+        m_Ring {},
+        m_State {LogThreadState::Free},
+        m_DroppedCount {0}
+    {
+    }
+};
+
+// Threads come and go (a sprite build for every window size, say), so a
+// ring goes back in the pool once its thread has exited and everything in
+// it has been written out.
+static const size_t MAX_LOGGING_THREADS {16};
+static std::array<LogThread, MAX_LOGGING_THREADS> s_Threads;
+
+
+// Gives the thread's ring back when the thread exits.
+class LogThreadHandle
+{
+public:
+    LogThreadHandle() :
+        m_pThread {nullptr},
+        m_HasThread {false}
+    {
+    }
+
+    ~LogThreadHandle()
+    {
+        if (m_pThread)
+        {
+            m_pThread->m_State.store(LogThreadState::Retired, std::memory_order_release);
+            m_pThread = nullptr;
+        }
+    }
+
+    LogThread* get()
+    {
+        if ( ! m_HasThread)
+        {
+            m_HasThread = true;
+            for (auto& thread : s_Threads)
+            {
+                LogThreadState expected {LogThreadState::Free};
+                if (thread.m_State.compare_exchange_strong(expected, LogThreadState::InUse, std::memory_order_acquire))
+                {
+                    m_pThread = &thread;
+                    break;
+                }
+            }
+        }
+        return m_pThread;
+    }
+
+private:
+    LogThread* m_pThread;  // Null if every ring was taken
+    bool m_HasThread;
+
+private:
+    LogThreadHandle(const LogThreadHandle&) = delete;
+    LogThreadHandle& operator=(const LogThreadHandle&) = delete;
+
+};
+
+static thread_local LogThreadHandle t_Thread;
+static std::atomic<uint64_t> s_UnregisteredDroppedCount {0};
+
+
+// Only touched by the background thread, and by start() and stop() while
+// it isn't running.
+static FILE* s_pFile {nullptr};
+static std::thread s_Thread {};
+static std::atomic<bool> s_IsRunning {false};
+static std::vector<LogRecord> s_Batch {};
+static uint64_t s_FreedDroppedCount {0};  // Dropped from rings that have gone back in the pool
+static uint64_t s_ReportedDroppedCount {0};
+
+static const std::chrono::milliseconds FLUSH_INTERVAL {5};
+
+
+void Log::push(const LogRecord& record)
+{
+    LogThread* pThread {t_Thread.get()};
+    if ( ! pThread)
+    {
+        s_UnregisteredDroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if ( ! pThread->m_Ring.push(record))
+    {
+        pThread->m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Log::addString(LogRecord& record, const char* pString)
+{
+    const size_t offset {record.m_TextSize};
+    const size_t length {pString ? std::min(std::strlen(pString), LOG_TEXT_SIZE - 1 - offset) : 0};
+    if (length > 0)
+    {
+        std::memcpy(record.m_Text + offset, pString, length);
+    }
+    record.m_Text[offset + length] = '\0';
+    record.m_TextSize = static_cast<uint8_t>(std::min(offset + length + 1, LOG_TEXT_SIZE - 1));
+
+    record.m_ArgTypes[record.m_ArgCount] = LogArgType::String;
+    record.m_Args[record.m_ArgCount++] = offset;
+}
+
+
+// Formats one conversion, `spec` (say "%-8.3lf"), with `arg`. The length
+// modifier in the format string is ignored; each argument was stored at
+// its widest, so that's what it's printed as.
+static void writeArg(FILE* pFile, const char* pSpec, size_t specLength, const LogRecord& record, size_t arg)
+{
+    const char conversion {pSpec[specLength - 1]};
+
+    // The flags, width and precision, without any length modifier.
+    char spec[32];
+    size_t length {0};
+    for (size_t i = 0; i + 1 < specLength && length + 4 < sizeof(spec); ++i)
+    {
+        if ( ! std::strchr("hljztL", pSpec[i]))
+        {
+            spec[length++] = pSpec[i];
+        }
+    }
+
+    const LogArgType type {record.m_ArgTypes[arg]};
+    const uint64_t value {record.m_Args[arg]};
+    switch (conversion)
+    {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        {
+            spec[length++] = 'l';
+            spec[length++] = 'l';
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            if (type == LogArgType::Int)
+            {
+                fprintf(pFile, spec, static_cast<long long>(value));
+            }
+            else
+            {
+                fprintf(pFile, spec, static_cast<unsigned long long>(value));
+            }
+            return;
+        }
+
+        case 'c':
+        {
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            fprintf(pFile, spec, static_cast<int>(value));
+            return;
+        }
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            double number {0.0};
+            if (type == LogArgType::Double)
+            {
+                std::memcpy(&number, &value, sizeof(number));
+            }
+            else
+            {
+                number = static_cast<double>(static_cast<int64_t>(value));
+            }
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            fprintf(pFile, spec, number);
+            return;
+        }
+
+        case 's':
+        {
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            fprintf(pFile, spec, type == LogArgType::String ? record.m_Text + value : "?");
+            return;
+        }
+
+        case 'p':
+        {
+            fprintf(pFile, "%p", reinterpret_cast<const void*>(static_cast<uintptr_t>(value)));
+            return;
+        }
+    }
+    fwrite(pSpec, 1, specLength, pFile);
+}
+
+static void writeRecord(FILE* pFile, const LogRecord& record)
+{
+    fprintf(pFile, "[%12.6f] ", record.m_Time / 1e9);
+
+    size_t arg {0};
+    const char* p {record.m_pFormat};
+    while (*p)
+    {
+        const char* pPercent {std::strchr(p, '%')};
+        if ( ! pPercent)
+        {
+            fputs(p, pFile);
+            break;
+        }
+        fwrite(p, 1, static_cast<size_t>(pPercent - p), pFile);
+
+        if (pPercent[1] == '%')
+        {
+            fputc('%', pFile);
+            p = pPercent + 2;
+            continue;
+        }
+
+        // Up to and including the conversion character
+        size_t specLength {1};
+        while (pPercent[specLength] && ! std::strchr("diuxXocfFeEgGaAsp", pPercent[specLength]))
+        {
+            ++specLength;
+        }
+        if ( ! pPercent[specLength])
+        {
+            fputs(pPercent, pFile);
+            break;
+        }
+        ++specLength;
+
+        if (arg < record.m_ArgCount)
+        {
+            writeArg(pFile, pPercent, specLength, record, arg++);
+        }
+        else
+        {
+            fwrite(pPercent, 1, specLength, pFile);
+        }
+        p = pPercent + specLength;
+    }
+}
+
+// Collects everything waiting in every thread's ring, and writes it out in
+// the order it was logged.
+static void flush()
+{
+    s_Batch.clear();
+    uint64_t droppedCount {s_UnregisteredDroppedCount.load(std::memory_order_relaxed)};
+    for (auto& thread : s_Threads)
+    {
+        const LogThreadState state {thread.m_State.load(std::memory_order_acquire)};
+        if (state == LogThreadState::Free)
+        {
+            continue;
+        }
+
+        LogRecord record;
+        while (thread.m_Ring.pop(record))
+        {
+            s_Batch.push_back(record);
+        }
+
+        // Its thread can't add any more, so it's empty for good. Its drops
+        // still count, but the next thread to get it starts from nothing.
+        if (state == LogThreadState::Retired)
+        {
+            s_FreedDroppedCount += thread.m_DroppedCount.load(std::memory_order_relaxed);
+            thread.m_DroppedCount.store(0, std::memory_order_relaxed);
+            thread.m_State.store(LogThreadState::Free, std::memory_order_release);
+        }
+        else
+        {
+            droppedCount += thread.m_DroppedCount.load(std::memory_order_relaxed);
+        }
+    }
+    droppedCount += s_FreedDroppedCount;
+
+    std::sort(s_Batch.begin(), s_Batch.end(), [](const LogRecord& a, const LogRecord& b)
+    {
+        return a.m_Time < b.m_Time;
+    });
+    for (const auto& record : s_Batch)
+    {
+        writeRecord(s_pFile, record);
+    }
+
+    if (droppedCount > s_ReportedDroppedCount)
+    {
+        fprintf(s_pFile, "(dropped %llu log messages) \n",
+            static_cast<unsigned long long>(droppedCount - s_ReportedDroppedCount));
+        s_ReportedDroppedCount = droppedCount;
+    }
+    fflush(s_pFile);
+}
+
+static void run()
+{
+    while (s_IsRunning.load(std::memory_order_acquire))
+    {
+        flush();
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+    flush();
+}
+
+
+bool Log::start(const char* pPath)
+{
+    if (s_IsRunning.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    s_pFile = pPath ? fopen(pPath, "w") : stderr;
+    if ( ! s_pFile)
+    {
+        s_pFile = nullptr;
+        return false;
+    }
+
+    // A ring's worth from each thread, so that steady logging never has
+    // to grow it.
+    s_Batch.reserve(LOG_RING_CAPACITY * MAX_LOGGING_THREADS);
+    s_Epoch = Clock::now();
+    s_IsRunning.store(true, std::memory_order_release);
+    s_Thread = std::thread {run};
+    s_IsEnabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void Log::stop()
+{
+    if ( ! s_IsRunning.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    s_IsEnabled.store(false, std::memory_order_relaxed);
+    s_IsRunning.store(false, std::memory_order_release);
+    s_Thread.join();
+
+    if (s_pFile != stderr)
+    {
+        fclose(s_pFile);
+    }
+    s_pFile = nullptr;
+}
@@ -0,0 +1,147 @@
+
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>  // for std::memcpy
+#include <type_traits>
+
+
+enum class LogArgType : uint8_t
+{
+    Int,
+    Unsigned,
+    Double,
+    String,   // Copied into the record's text
+    Pointer,
+};
+
+static const size_t MAX_LOG_ARGS {8};
+static const size_t LOG_TEXT_SIZE {32};
+
+// One message, as the thread that logged it left it: the format string
+// (which lives forever, being a literal, so its address is as good as an
+// ID) and the raw arguments. The logger's own thread does the formatting.
+struct LogRecord
+{
+    const char* m_pFormat;
+    int64_t m_Time;  // Nanoseconds since logging started
+    uint8_t m_ArgCount;
+    uint8_t m_TextSize;
+    LogArgType m_ArgTypes[MAX_LOG_ARGS];
+    uint64_t m_Args[MAX_LOG_ARGS];  // For a string, where it starts in m_Text
+    char m_Text[LOG_TEXT_SIZE];
+};
+
+
+// Printf-style logging, cheap enough for the physics step.
+//
+// LOG() doesn't format anything. It copies the format string's address,
+// a timestamp and its arguments into a lock-free ring that belongs to the
+// calling thread, and goes on its way. A background thread collects the
+// messages from every thread's ring a few hundred times a second, puts
+// them in order, formats them and writes them out. If a thread logs so
+// much that its ring fills up, the extra messages are dropped (and
+// counted) rather than holding it up.
+//
+// Strings are copied, up to a total of LOG_TEXT_SIZE bytes a message, so
+// they don't have to outlive the call. Anything past that is cut off.
+//
+// Logging is off until start(). Until then, or after stop(), LOG() costs
+// one relaxed load and a branch.
+class Log
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Write messages to the file at `pPath`, or to stderr if it's null.
+    // Returns false if the file couldn't be opened.
+    static bool start(const char* pPath);
+
+    // Write out whatever's left, and stop the background thread.
+    static void stop();
+
+    static bool isEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+
+    template<typename... Args>
+    static void write(const char* pFormat, Args... args)
+    {
+        static_assert(sizeof...(Args) <= MAX_LOG_ARGS, "Too many arguments to log");
+
+        LogRecord record;
+        record.m_pFormat = pFormat;
+        record.m_Time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s_Epoch).count();
+        record.m_ArgCount = 0;
+        record.m_TextSize = 0;
+        const int expand[] {0, (addArg(record, args), 0)...};
+        static_cast<void>(expand);
+        push(record);
+    }
+
+    // Only there for LOG() to check its arguments against the format
+    // string, in an unevaluated context. It's never defined.
+    static void checkFormat(const char* pFormat, ...) __attribute__((format(printf, 1, 2)));
+
+private:
+    static void push(const LogRecord& record);
+    static void addString(LogRecord& record, const char* pString);
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    addArg(LogRecord& record, T value)
+    {
+        record.m_ArgTypes[record.m_ArgCount] = LogArgType::Int;
+        record.m_Args[record.m_ArgCount++] = static_cast<uint64_t>(static_cast<int64_t>(value));
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+    addArg(LogRecord& record, T value)
+    {
+        record.m_ArgTypes[record.m_ArgCount] = LogArgType::Unsigned;
+        record.m_Args[record.m_ArgCount++] = static_cast<uint64_t>(value);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    addArg(LogRecord& record, T value)
+    {
+        const double wide {static_cast<double>(value)};
+        record.m_ArgTypes[record.m_ArgCount] = LogArgType::Double;
+        std::memcpy(&record.m_Args[record.m_ArgCount++], &wide, sizeof(wide));
+    }
+
+    static void addArg(LogRecord& record, const char* pString)
+    {
+        addString(record, pString);
+    }
+
+    static void addArg(LogRecord& record, const void* pPointer)
+    {
+        record.m_ArgTypes[record.m_ArgCount] = LogArgType::Pointer;
+        record.m_Args[record.m_ArgCount++] = reinterpret_cast<uintptr_t>(pPointer);
+    }
+
+    static std::atomic<bool> s_IsEnabled;
+    static Clock::time_point s_Epoch;
+
+};
+
+
+// The arguments are checked against the format string as if for printf,
+// but nothing is formatted here.
+#define LOG(...) \
+    do \
+    { \
+        static_cast<void>(sizeof(Log::checkFormat(__VA_ARGS__), 0)); \
+        if (Log::isEnabled()) \
+        { \
+            Log::write(__VA_ARGS__); \
+        } \
+    } while (false)
+
+
+#endif
@@ -0,0 +1,180 @@
+
+#include <algorithm>  // for std::min, std::max, std::nth_element
+#include <array>
+#include <fstream>
+
+#include "Profiler.hpp"
+#include "SpscRing.hpp"
+#include "Tracer.hpp"
+#include "debug.hpp"
+
+
+std::atomic<bool> Profiler::s_IsEnabled {false};
+const size_t Profiler::WINDOW_SIZE;
+
+
+const char* getProfilePhaseName(ProfilePhase phase)
+{
+    switch (phase)
+    {
+        case ProfilePhase::Input:        return "input";
+        case ProfilePhase::BallPairs:    return "ball_pairs";
+        case ProfilePhase::Cushions:     return "cushions";
+        case ProfilePhase::Friction:     return "friction";
+        case ProfilePhase::Integration:  return "integration";
+        case ProfilePhase::ForceCleanup: return "force_cleanup";
+        case ProfilePhase::Prediction:   return "prediction";
+        case ProfilePhase::Render:       return "render";
+        case ProfilePhase::Present:      return "present";
+    }
+    return "unknown";
+}
+
+
+struct ProfileSample
+{
+    ProfilePhase m_Phase;
+    uint64_t m_Nanoseconds;
+};
+
+// Each thread that records anything gets the next of these. A thread past
+// the last one just doesn't get profiled.
+static const size_t MAX_PROFILED_THREADS {16};
+static std::array<SpscRing<ProfileSample, 2048>, MAX_PROFILED_THREADS> s_Rings;
+static std::atomic<size_t> s_ThreadCount {0};
+
+// Added to from any thread, when a ring is full
+static std::array<std::atomic<uint64_t>, PROFILE_PHASE_COUNT> s_DroppedCounts;
+
+static thread_local bool t_HasRing {false};
+static thread_local SpscRing<ProfileSample, 2048>* t_pRing {nullptr};
+
+// Only touched by the main thread
+struct ProfileWindow
+{
+    std::array<uint64_t, Profiler::WINDOW_SIZE> m_Samples;
+    size_t m_Next;
+    size_t m_Count;
+    uint64_t m_TotalCount;
+};
+static std::array<ProfileWindow, PROFILE_PHASE_COUNT> s_Windows;
+static std::array<uint64_t, Profiler::WINDOW_SIZE> s_Scratch;
+
+
+void Profiler::setEnabled(bool isEnabled)
+{
+    s_IsEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+void Profiler::record(ProfilePhase phase, Clock::time_point start, Clock::time_point end)
+{
+    if ( ! t_HasRing)
+    {
+        t_HasRing = true;
+        const size_t slot {s_ThreadCount.fetch_add(1, std::memory_order_relaxed)};
+        if (slot < MAX_PROFILED_THREADS)
+        {
+            t_pRing = &s_Rings[slot];
+        }
+        else
+        {
+            LOG("Too many threads to profile; ignoring this one \n");
+        }
+    }
+
+    if (t_pRing)
+    {
+        const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        if ( ! t_pRing->push(ProfileSample {phase, static_cast<uint64_t>(duration.count())}))
+        {
+            s_DroppedCounts[static_cast<size_t>(phase)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (Tracer::isEnabled())
+    {
+        Tracer::complete(getProfilePhaseName(phase), "phase", start, end);
+    }
+}
+
+
+void Profiler::collect()
+{
+    const size_t threadCount {std::min(s_ThreadCount.load(std::memory_order_relaxed), MAX_PROFILED_THREADS)};
+    ProfileSample sample;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        while (s_Rings[i].pop(sample))
+        {
+            ProfileWindow& window = s_Windows[static_cast<size_t>(sample.m_Phase)];
+            window.m_Samples[window.m_Next] = sample.m_Nanoseconds;
+            window.m_Next = (window.m_Next + 1) % WINDOW_SIZE;
+            window.m_Count = std::min(window.m_Count + 1, WINDOW_SIZE);
+            ++window.m_TotalCount;
+        }
+    }
+}
+
+ProfileStats Profiler::getStats(ProfilePhase phase)
+{
+    const ProfileWindow& window = s_Windows[static_cast<size_t>(phase)];
+    ProfileStats stats {
+        window.m_TotalCount,
+        s_DroppedCounts[static_cast<size_t>(phase)].load(std::memory_order_relaxed),
+        window.m_Count,
+        0.0, 0.0, 0.0, 0.0
+    };
+    if (window.m_Count == 0)
+    {
+        return stats;
+    }
+
+    // Which samples are in the window doesn't matter, only their values.
+    uint64_t total {0};
+    uint64_t low {window.m_Samples[0]};
+    uint64_t high {window.m_Samples[0]};
+    for (size_t i = 0; i < window.m_Count; ++i)
+    {
+        const uint64_t sample {window.m_Samples[i]};
+        s_Scratch[i] = sample;
+        total += sample;
+        low = std::min(low, sample);
+        high = std::max(high, sample);
+    }
+
+    const size_t p99Index {std::min(window.m_Count - 1, window.m_Count * 99 / 100)};
+    std::nth_element(s_Scratch.begin(), s_Scratch.begin() + p99Index, s_Scratch.begin() + window.m_Count);
+
+    const double NANOSECONDS_PER_MILLISECOND {1e6};
+    stats.m_Min = low / NANOSECONDS_PER_MILLISECOND;
+    stats.m_Mean = total / NANOSECONDS_PER_MILLISECOND / window.m_Count;
+    stats.m_P99 = s_Scratch[p99Index] / NANOSECONDS_PER_MILLISECOND;
+    stats.m_Max = high / NANOSECONDS_PER_MILLISECOND;
+    return stats;
+}
+
+bool Profiler::writeCsv(const char* path)
+{
+    std::ofstream file {path};
+    if ( ! file)
+    {
+        return false;
+    }
+
+    file << "phase,samples,dropped,window,min_ms,mean_ms,p99_ms,max_ms\n";
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i)
+    {
+        const auto phase = static_cast<ProfilePhase>(i);
+        const ProfileStats stats {getStats(phase)};
+        file
+            << getProfilePhaseName(phase) << ","
+            << stats.m_TotalCount << ","
+            << stats.m_DroppedCount << ","
+            << stats.m_WindowCount << ","
+            << stats.m_Min << ","
+            << stats.m_Mean << ","
+            << stats.m_P99 << ","
+            << stats.m_Max << "\n";
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,173 @@
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+
+// The parts of a frame (or of a simulation step) that get timed.
+enum class ProfilePhase : uint8_t
+{
+    Input,
+    BallPairs,     // Testing every pair of balls for contact
+    Cushions,      // Bouncing off the bumpers, and dropping into pockets
+    Friction,
+    Integration,
+    ForceCleanup,  // Ageing the forces, and dropping the expired ones
+    Prediction,    // Looking ahead for the aim overlay, on its own table
+    Render,
+    Present,
+};
+static const size_t PROFILE_PHASE_COUNT {9};
+
+const char* getProfilePhaseName(ProfilePhase phase);
+
+
+// Over the most recent samples of a phase, in milliseconds
+struct ProfileStats
+{
+    uint64_t m_TotalCount;  // Every sample since profiling started
+    uint64_t m_DroppedCount;  // Samples lost because a thread's ring was full
+    size_t m_WindowCount;   // How many of them the rest is worked out from
+    double m_Min;
+    double m_Mean;
+    double m_P99;
+    double m_Max;
+};
+
+
+// Times the phases of each frame, on whichever threads they run.
+//
+// Each thread records its timings into a lock-free ring of its own, so
+// recording never waits on anything. Once a frame, collect() drains the
+// rings into a rolling window per phase, on the main thread.
+//
+// A thread that records more in a frame than its ring holds loses the
+// rest, and the losses are counted.
+//
+// When profiling is switched off, a timer costs one relaxed load and a
+// branch. Build with -DNPROFILE to leave the timers out altogether.
+class Profiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static bool isEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool isEnabled);
+
+    static void record(ProfilePhase phase, Clock::time_point start, Clock::time_point end);
+
+    // Main thread only, from here on.
+    static void collect();
+    static ProfileStats getStats(ProfilePhase phase);
+
+    // One row per phase. Returns false if the file couldn't be written.
+    static bool writeCsv(const char* path);
+
+    // Samples kept per phase for the rolling stats
+    static const size_t WINDOW_SIZE {1024};
+
+private:
+    static std::atomic<bool> s_IsEnabled;
+
+};
+
+
+// Times the scope it's declared in.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfilePhase phase) :
+        m_Phase {phase},
+        m_Start {}
+    {
+        if (Profiler::isEnabled())
+        {
+            m_Start = Profiler::Clock::now();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_Start != Profiler::Clock::time_point {})
+        {
+            Profiler::record(m_Phase, m_Start, Profiler::Clock::now());
+        }
+    }
+
+private:
+    ProfilePhase m_Phase;
+    Profiler::Clock::time_point m_Start;
+
+private:
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+};
+
+
+// Times a run of phases which follow straight on from each other, reading
+// the clock once at each boundary. The last phase ends with the scope.
+class ProfileLap
+{
+public:
+    // If `isEnabled` is false, the lap times nothing, whether or not
+    // profiling is on.
+    explicit ProfileLap(ProfilePhase phase, bool isEnabled = true) :
+        m_Phase {phase},
+        m_Start {}
+    {
+        if (isEnabled && Profiler::isEnabled())
+        {
+            m_Start = Profiler::Clock::now();
+        }
+    }
+
+    ~ProfileLap()
+    {
+        lap(m_Phase);
+    }
+
+    // End the current phase, and start `next`.
+    void lap(ProfilePhase next)
+    {
+        if (m_Start != Profiler::Clock::time_point {})
+        {
+            const Profiler::Clock::time_point now {Profiler::Clock::now()};
+            Profiler::record(m_Phase, m_Start, now);
+            m_Start = now;
+        }
+        m_Phase = next;
+    }
+
+private:
+    ProfilePhase m_Phase;
+    Profiler::Clock::time_point m_Start;
+
+private:
+    ProfileLap(const ProfileLap&) = delete;
+    ProfileLap& operator=(const ProfileLap&) = delete;
+
+};
+
+
+#define PROFILE_CONCAT_INNER(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef NPROFILE
+#define PROFILE_SCOPE(phase)
+#define PROFILE_LAP_BEGIN(name, phase)
+#define PROFILE_LAP_BEGIN_IF(name, phase, condition)
+#define PROFILE_LAP(name, phase)
+#else
+#define PROFILE_SCOPE(phase) const ProfileScope PROFILE_CONCAT(profileScope, __LINE__) {ProfilePhase::phase}
+#define PROFILE_LAP_BEGIN(name, phase) ProfileLap name {ProfilePhase::phase}
+#define PROFILE_LAP_BEGIN_IF(name, phase, condition) ProfileLap name {ProfilePhase::phase, condition}
+#define PROFILE_LAP(name, phase) name.lap(ProfilePhase::phase)
+#endif
+
+
+#endif
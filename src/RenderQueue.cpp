@@ -0,0 +1,307 @@
+
+#include <algorithm>  // for std::sort
+#include <cmath>      // for std::lround
+
+#include "RenderQueue.hpp"
+
+
+RenderQueue::RenderQueue() :
+    m_Commands {},
+    m_Points {},
+    m_Rects {},
+    m_Sprites {}
+{
+    // Enough for a frame of the game, so it shouldn't ever need to grow.
+    m_Commands.reserve(64);
+    m_Points.reserve(1024);
+    m_Rects.reserve(64);
+    m_Sprites.reserve(64);
+}
+
+
+void RenderQueue::clear()
+{
+    m_Commands.clear();
+    m_Points.clear();
+}
+
+void RenderQueue::add(RenderCommand& command, RenderLayer layer)
+{
+    const uint32_t sequence {static_cast<uint32_t>(m_Commands.size()) & ((1u << SEQUENCE_BITS) - 1)};
+    command.m_Key =
+        (static_cast<uint32_t>(layer) << 24) |
+        (static_cast<uint32_t>(command.m_Blend) << 22) |
+        (static_cast<uint32_t>(command.m_Texture) << 19) |
+        (static_cast<uint32_t>(command.m_Type) << SEQUENCE_BITS) |
+        sequence;
+    m_Commands.push_back(command);
+}
+
+void RenderQueue::fillRect(RenderLayer layer, const SDL_Rect& rect, SDL_Color color, RenderBlend blend)
+{
+    RenderCommand command {};
+    command.m_Type = RenderCommandType::FillRect;
+    command.m_Texture = RenderTexture::None;
+    command.m_Blend = blend;
+    command.m_Color = color;
+    command.m_Rect = rect;
+    add(command, layer);
+}
+
+void RenderQueue::drawSprite(
+    RenderLayer layer,
+    RenderTexture texture,
+    const SDL_Rect& source,
+    float x,
+    float y,
+    float w,
+    float h,
+    RenderBlend blend
+)
+{
+    RenderCommand command {};
+    command.m_Type = RenderCommandType::Sprite;
+    command.m_Texture = texture;
+    command.m_Blend = blend;
+    command.m_Rect = source;
+    command.m_X = x;
+    command.m_Y = y;
+    command.m_W = w;
+    command.m_H = h;
+    add(command, layer);
+}
+
+void RenderQueue::drawLines(RenderLayer layer, const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend)
+{
+    if (count < 2)
+    {
+        return;
+    }
+
+    RenderCommand command {};
+    command.m_Type = RenderCommandType::Lines;
+    command.m_Texture = RenderTexture::None;
+    command.m_Blend = blend;
+    command.m_Color = color;
+    command.m_FirstPoint = static_cast<uint32_t>(m_Points.size());
+    command.m_PointCount = static_cast<uint32_t>(count);
+    m_Points.insert(m_Points.end(), pPoints, pPoints + count);
+    add(command, layer);
+}
+
+
+void RenderQueue::sort()
+{
+    // Keys are all different (the order they were added in is part of
+    // them), so this comes out the same as a stable sort would, without
+    // the stable sort's scratch space.
+    std::sort(m_Commands.begin(), m_Commands.end(), [](const RenderCommand& a, const RenderCommand& b)
+    {
+        return a.m_Key < b.m_Key;
+    });
+}
+
+void RenderQueue::submit(RenderBackend& backend)
+{
+    size_t first {0};
+    while (first < m_Commands.size())
+    {
+        // Find the run of commands that can go in one call: the same kind
+        // of thing, with the same texture and blend mode (and for fills,
+        // the same colour).
+        const RenderCommand& head = m_Commands[first];
+        size_t end {first + 1};
+        while (end < m_Commands.size())
+        {
+            const RenderCommand& next = m_Commands[end];
+            const bool matches {
+                next.m_Type == head.m_Type &&
+                next.m_Texture == head.m_Texture &&
+                next.m_Blend == head.m_Blend &&
+                (head.m_Type != RenderCommandType::FillRect || (
+                    next.m_Color.r == head.m_Color.r &&
+                    next.m_Color.g == head.m_Color.g &&
+                    next.m_Color.b == head.m_Color.b &&
+                    next.m_Color.a == head.m_Color.a
+                )) &&
+                // Separate lines can't be joined up.
+                head.m_Type != RenderCommandType::Lines
+            };
+            if ( ! matches)
+            {
+                break;
+            }
+            ++end;
+        }
+
+        switch (head.m_Type)
+        {
+            case RenderCommandType::FillRect:
+            {
+                m_Rects.clear();
+                for (size_t i = first; i < end; ++i)
+                {
+                    m_Rects.push_back(m_Commands[i].m_Rect);
+                }
+                backend.fillRects(m_Rects.data(), m_Rects.size(), head.m_Color, head.m_Blend);
+                break;
+            }
+
+            case RenderCommandType::Sprite:
+            {
+                m_Sprites.clear();
+                for (size_t i = first; i < end; ++i)
+                {
+                    const RenderCommand& command = m_Commands[i];
+                    m_Sprites.push_back(RenderSprite {command.m_Rect, command.m_X, command.m_Y, command.m_W, command.m_H});
+                }
+                backend.drawSprites(head.m_Texture, m_Sprites.data(), m_Sprites.size(), head.m_Blend);
+                break;
+            }
+
+            case RenderCommandType::Lines:
+            {
+                backend.drawLines(&m_Points[head.m_FirstPoint], head.m_PointCount, head.m_Color, head.m_Blend);
+                break;
+            }
+        }
+
+        first = end;
+    }
+}
+
+
+SdlRenderBackend::SdlRenderBackend() :
+    m_pRenderer {nullptr},
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    m_Vertices {},
+    m_Indices {},
+#endif
+    m_Textures {}
+{
+}
+
+void SdlRenderBackend::setTexture(RenderTexture name, SDL_Texture* pTexture)
+{
+    Texture& texture = m_Textures[static_cast<size_t>(name)];
+    texture.m_pTexture = pTexture;
+    texture.m_Width = 1;
+    texture.m_Height = 1;
+    if (pTexture)
+    {
+        SDL_QueryTexture(pTexture, nullptr, nullptr, &texture.m_Width, &texture.m_Height);
+    }
+}
+
+static SDL_BlendMode toSdlBlendMode(RenderBlend blend)
+{
+    return blend == RenderBlend::Blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE;
+}
+
+void SdlRenderBackend::fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend)
+{
+    SDL_SetRenderDrawBlendMode(m_pRenderer, toSdlBlendMode(blend));
+    SDL_SetRenderDrawColor(m_pRenderer, color.r, color.g, color.b, color.a);
+    SDL_RenderFillRects(m_pRenderer, pRects, static_cast<int>(count));
+}
+
+void SdlRenderBackend::drawSprites(RenderTexture name, const RenderSprite* pSprites, size_t count, RenderBlend blend)
+{
+    const Texture& texture = m_Textures[static_cast<size_t>(name)];
+    if ( ! texture.m_pTexture)
+    {
+        return;
+    }
+    SDL_SetTextureBlendMode(texture.m_pTexture, toSdlBlendMode(blend));
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // One quad per sprite, all in a single call. The vectors keep their
+    // capacity between frames.
+    m_Vertices.clear();
+    m_Indices.clear();
+
+    const float width {static_cast<float>(texture.m_Width)};
+    const float height {static_cast<float>(texture.m_Height)};
+    const SDL_Color WHITE {0xff, 0xff, 0xff, 0xff};
+    for (size_t i = 0; i < count; ++i)
+    {
+        const RenderSprite& sprite = pSprites[i];
+        const float u0 {sprite.m_Source.x / width};
+        const float v0 {sprite.m_Source.y / height};
+        const float u1 {(sprite.m_Source.x + sprite.m_Source.w) / width};
+        const float v1 {(sprite.m_Source.y + sprite.m_Source.h) / height};
+
+        const float x0 {sprite.m_X};
+        const float y0 {sprite.m_Y};
+        const float x1 {sprite.m_X + sprite.m_W};
+        const float y1 {sprite.m_Y + sprite.m_H};
+
+        const auto first = static_cast<int>(m_Vertices.size());
+        m_Vertices.push_back({{x0, y0}, WHITE, {u0, v0}});
+        m_Vertices.push_back({{x1, y0}, WHITE, {u1, v0}});
+        m_Vertices.push_back({{x1, y1}, WHITE, {u1, v1}});
+        m_Vertices.push_back({{x0, y1}, WHITE, {u0, v1}});
+
+        m_Indices.push_back(first);
+        m_Indices.push_back(first + 1);
+        m_Indices.push_back(first + 2);
+        m_Indices.push_back(first);
+        m_Indices.push_back(first + 2);
+        m_Indices.push_back(first + 3);
+    }
+
+    if (SDL_RenderGeometry(
+        m_pRenderer,
+        texture.m_pTexture,
+        m_Vertices.data(),
+        static_cast<int>(m_Vertices.size()),
+        m_Indices.data(),
+        static_cast<int>(m_Indices.size())
+    ) == 0) {
+        return;
+    }
+#endif
+
+    // Older SDL (or a renderer without geometry support): one copy per
+    // sprite. They're all from the same texture, so at least the renderer
+    // never has to switch in between.
+    for (size_t i = 0; i < count; ++i)
+    {
+        const RenderSprite& sprite = pSprites[i];
+        const SDL_Rect rect {
+            static_cast<int>(std::lround(sprite.m_X)),
+            static_cast<int>(std::lround(sprite.m_Y)),
+            static_cast<int>(std::lround(sprite.m_W)),
+            static_cast<int>(std::lround(sprite.m_H))
+        };
+        SDL_RenderCopy(m_pRenderer, texture.m_pTexture, &sprite.m_Source, &rect);
+    }
+}
+
+void SdlRenderBackend::drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend)
+{
+    SDL_SetRenderDrawBlendMode(m_pRenderer, toSdlBlendMode(blend));
+    SDL_SetRenderDrawColor(m_pRenderer, color.r, color.g, color.b, color.a);
+    SDL_RenderDrawLines(m_pRenderer, pPoints, static_cast<int>(count));
+}
+
+
+RenderRecorder::RenderRecorder() :
+    m_Calls {}
+{
+}
+
+void RenderRecorder::fillRects(const SDL_Rect*, size_t count, SDL_Color color, RenderBlend blend)
+{
+    m_Calls.push_back(Call {RenderCommandType::FillRect, RenderTexture::None, blend, color, count});
+}
+
+void RenderRecorder::drawSprites(RenderTexture texture, const RenderSprite*, size_t count, RenderBlend blend)
+{
+    m_Calls.push_back(Call {RenderCommandType::Sprite, texture, blend, SDL_Color {0xff, 0xff, 0xff, 0xff}, count});
+}
+
+void RenderRecorder::drawLines(const SDL_Point*, size_t count, SDL_Color color, RenderBlend blend)
+{
+    m_Calls.push_back(Call {RenderCommandType::Lines, RenderTexture::None, blend, color, count});
+}
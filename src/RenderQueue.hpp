@@ -0,0 +1,213 @@
+
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+
+// Things are drawn a layer at a time, back to front.
+enum class RenderLayer : uint8_t
+{
+    Background,
+    Paths,
+    Balls,
+    Overlay,
+};
+
+enum class RenderBlend : uint8_t
+{
+    None,
+    Blend,
+};
+
+// Textures are named rather than passed around, so that the same commands
+// can be drawn by anything that knows what the names stand for.
+enum class RenderTexture : uint8_t
+{
+    None,
+    Background,
+    Sprites,   // Flat ball sprites and the pocket
+    Balls,     // One sprite per ball, by ball index
+};
+static const size_t RENDER_TEXTURE_COUNT {4};
+
+enum class RenderCommandType : uint8_t
+{
+    FillRect,
+    Sprite,
+    Lines,
+};
+
+
+struct RenderCommand
+{
+    // Layer, then blend mode, texture and type, then the order it was
+    // added in. Sorting on this alone gets the drawing order right.
+    uint32_t m_Key;
+
+    RenderCommandType m_Type;
+    RenderTexture m_Texture;
+    RenderBlend m_Blend;
+    SDL_Color m_Color;
+
+    // For FillRect, the rect to fill. For Sprite, where in the texture to
+    // take it from.
+    SDL_Rect m_Rect;
+
+    // Where a Sprite goes, which needn't be whole pixels
+    float m_X;
+    float m_Y;
+    float m_W;
+    float m_H;
+
+    // For Lines, where in the queue's points they are
+    uint32_t m_FirstPoint;
+    uint32_t m_PointCount;
+};
+
+// Where a sprite comes from and where it goes, for a backend to draw.
+struct RenderSprite
+{
+    SDL_Rect m_Source;
+    float m_X;
+    float m_Y;
+    float m_W;
+    float m_H;
+};
+
+
+// Something that can carry out draw commands. The queue hands it runs of
+// commands which all share a texture and blend mode, so that each run can
+// be drawn in one go.
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() {}
+
+    virtual void fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend) = 0;
+    virtual void drawSprites(RenderTexture texture, const RenderSprite* pSprites, size_t count, RenderBlend blend) = 0;
+    virtual void drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend) = 0;
+};
+
+
+// A frame's worth of draw commands, kept until the next clear().
+//
+// Commands can be added in any order. sort() puts them in layer order and
+// groups them by texture and blend mode, and submit() then draws each group
+// with as few backend calls as it can. A queue can be submitted more than
+// once (to draw the same frame under several clip rects, say). Nothing is
+// freed between frames, so once it's big enough, it never allocates.
+class RenderQueue
+{
+public:
+    RenderQueue();
+
+    void clear();
+
+    void fillRect(RenderLayer layer, const SDL_Rect& rect, SDL_Color color, RenderBlend blend = RenderBlend::Blend);
+    void drawSprite(
+        RenderLayer layer,
+        RenderTexture texture,
+        const SDL_Rect& source,
+        float x,
+        float y,
+        float w,
+        float h,
+        RenderBlend blend = RenderBlend::Blend
+    );
+    void drawLines(RenderLayer layer, const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend = RenderBlend::Blend);
+
+    void sort();
+    void submit(RenderBackend& backend);
+
+    size_t getCommandCount() const { return m_Commands.size(); }
+
+private:
+    void add(RenderCommand& command, RenderLayer layer);
+
+private:
+    std::vector<RenderCommand> m_Commands;
+    std::vector<SDL_Point> m_Points;
+
+    // Each run of commands is gathered up here before it goes to the backend.
+    std::vector<SDL_Rect> m_Rects;
+    std::vector<RenderSprite> m_Sprites;
+
+    // The order a command was added in only gets this many bits of the
+    // key, which is far more than a frame ever has.
+    static const uint32_t SEQUENCE_BITS {16};
+
+};
+
+
+// Draws commands with an SDL renderer, at whatever scale and clip rect it's
+// been set to.
+class SdlRenderBackend : public RenderBackend
+{
+public:
+    SdlRenderBackend();
+
+    void setRenderer(SDL_Renderer* pRenderer) { m_pRenderer = pRenderer; }
+    void setTexture(RenderTexture name, SDL_Texture* pTexture);
+
+    void fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend) override;
+    void drawSprites(RenderTexture texture, const RenderSprite* pSprites, size_t count, RenderBlend blend) override;
+    void drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend) override;
+
+private:
+    struct Texture
+    {
+        SDL_Texture* m_pTexture;
+        int m_Width;
+        int m_Height;
+    };
+
+    SDL_Renderer* m_pRenderer;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    std::vector<SDL_Vertex> m_Vertices;
+    std::vector<int> m_Indices;
+#endif
+    std::array<Texture, RENDER_TEXTURE_COUNT> m_Textures;
+
+private:
+    SdlRenderBackend(const SdlRenderBackend&) = delete;
+    SdlRenderBackend& operator=(const SdlRenderBackend&) = delete;
+
+};
+
+
+// Keeps a note of everything it's asked to draw, without drawing any of it.
+// Handy for checking what a frame turns into, or how many calls it takes.
+class RenderRecorder : public RenderBackend
+{
+public:
+    struct Call
+    {
+        RenderCommandType m_Type;
+        RenderTexture m_Texture;
+        RenderBlend m_Blend;
+        SDL_Color m_Color;
+        size_t m_Count;
+    };
+
+    RenderRecorder();
+
+    void clear() { m_Calls.clear(); }
+    const std::vector<Call>& getCalls() const { return m_Calls; }
+
+    void fillRects(const SDL_Rect* pRects, size_t count, SDL_Color color, RenderBlend blend) override;
+    void drawSprites(RenderTexture texture, const RenderSprite* pSprites, size_t count, RenderBlend blend) override;
+    void drawLines(const SDL_Point* pPoints, size_t count, SDL_Color color, RenderBlend blend) override;
+
+private:
+    std::vector<Call> m_Calls;
+
+};
+
+
+#endif
@@ -0,0 +1,227 @@
+
+#ifndef REWIND_HPP
+#define REWIND_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/vector_relational.hpp>  // for glm::equal, glm::all
+
+#include "Table.hpp"
+
+
+// Remembers the last few seconds of a Table so that play can be wound back.
+//
+// A keyframe of the table is captured every `keyframeInterval` steps into a
+// fixed-size ring. The steps in between aren't stored at all; since the
+// simulation is deterministic they can be regenerated by stepping forward
+// from the keyframe before them. That only holds if nothing outside the
+// simulation touched the table in between, so capture() should also be
+// called straight after any input (a shot, a reset, ...) is applied.
+//
+// Balls are stored copy-on-write: each ball keeps its own history of
+// records, and a new record is only written when the ball has changed
+// since its last one. Balls which are sleeping (or already pocketed) cost
+// nothing per keyframe.
+//
+// `State` is any other small, copyable game state (e.g. the score) which
+// should be wound back along with the table.
+template<typename State>
+class RewindBuffer
+{
+public:
+    RewindBuffer(size_t keyframeCapacity, uint32_t keyframeInterval) :
+        m_Keyframes(keyframeCapacity),
+        m_KeyframeCount {0},
+        m_NextKeyframeNumber {0},
+        m_BallHistories {},
+        m_KeyframeInterval {keyframeInterval}
+    {
+        for (auto& keyframe : m_Keyframes)
+        {
+            keyframe.m_Forces.reserve(INITIAL_FORCE_CAPACITY);
+        }
+    }
+
+    // Call after every step. Almost always this is just a comparison.
+    void record(const Table& table, const State& state)
+    {
+        if (m_KeyframeCount > 0 && table.getStepCount() < getKeyframe(m_NextKeyframeNumber - 1).m_Step + m_KeyframeInterval)
+        {
+            return;
+        }
+        capture(table, state);
+    }
+
+    // Capture a keyframe right now, regardless of the interval.
+    void capture(const Table& table, const State& state)
+    {
+        const auto& balls = table.m_Balls;
+        if (balls.size() != m_BallHistories.size())
+        {
+            // Histories can't be shared between different sets of balls.
+            clear();
+            m_BallHistories.resize(balls.size());
+            for (auto& history : m_BallHistories)
+            {
+                history.m_Records.assign(m_Keyframes.size() + 1, BallRecord {0, Ball {BallType::Cue}});
+            }
+        }
+
+        // Overwrite the oldest keyframe once the ring is full.
+        if (m_KeyframeCount == m_Keyframes.size())
+        {
+            --m_KeyframeCount;
+        }
+        const uint64_t number {m_NextKeyframeNumber++};
+        ++m_KeyframeCount;
+
+        auto& keyframe = getKeyframe(number);
+        keyframe.m_Step = table.m_StepCount;
+        keyframe.m_Forces.assign(table.m_BallForces.begin(), table.m_BallForces.end());
+        keyframe.m_State = state;
+
+        for (size_t i = 0; i < balls.size(); ++i)
+        {
+            auto& history = m_BallHistories[i];
+            if (history.m_Count > 0 && isSameBall(history.getRecord(history.m_Count - 1).m_Ball, balls[i]))
+            {
+                continue;
+            }
+
+            // A ball needs its newest record from before the oldest keyframe
+            // to be kept, but anything older than that can go. There are
+            // never more records than keyframes within the ring, so with
+            // one spare slot dropping the oldest record is always safe.
+            if (history.m_Count == history.m_Records.size())
+            {
+                history.m_Start = (history.m_Start + 1) % history.m_Records.size();
+                --history.m_Count;
+            }
+            history.getRecord(history.m_Count++) = BallRecord {number, balls[i]};
+        }
+    }
+
+    // Put the table (and state) back how they were at the last keyframe at
+    // or before `step`, or the oldest keyframe if `step` is older than that.
+    // Everything recorded after that keyframe is forgotten. Step the table
+    // forward from there to reach `step` exactly. Returns false if nothing
+    // has been recorded.
+    bool restore(Table& table, State& state, uint64_t step)
+    {
+        if (m_KeyframeCount == 0)
+        {
+            return false;
+        }
+
+        // Binary search for the newest keyframe no later than `step`.
+        uint64_t low {m_NextKeyframeNumber - m_KeyframeCount};
+        uint64_t high {m_NextKeyframeNumber - 1};
+        while (low < high)
+        {
+            const uint64_t middle {low + (high - low + 1) / 2};
+            if (getKeyframe(middle).m_Step <= step)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle - 1;
+            }
+        }
+        const uint64_t number {low};
+        const auto& keyframe = getKeyframe(number);
+
+        table.m_Balls.clear();
+        for (auto& history : m_BallHistories)
+        {
+            // Drop the records that are about to be rewritten, then the
+            // newest one left is the one in effect at this keyframe.
+            while (history.m_Count > 1 && history.getRecord(history.m_Count - 1).m_KeyframeNumber > number)
+            {
+                --history.m_Count;
+            }
+            table.m_Balls.push_back(history.getRecord(history.m_Count - 1).m_Ball);
+        }
+        table.m_BallForces.assign(keyframe.m_Forces.begin(), keyframe.m_Forces.end());
+        table.m_Events.clear();
+        table.m_StepCount = keyframe.m_Step;
+        table.m_PendingTime = 0.0f;
+        state = keyframe.m_State;
+
+        m_KeyframeCount -= m_NextKeyframeNumber - (number + 1);
+        m_NextKeyframeNumber = number + 1;
+        return true;
+    }
+
+    uint64_t getOldestStep() const
+    {
+        return m_KeyframeCount > 0 ? getKeyframe(m_NextKeyframeNumber - m_KeyframeCount).m_Step : 0;
+    }
+
+    void clear()
+    {
+        m_KeyframeCount = 0;
+        for (auto& history : m_BallHistories)
+        {
+            history.m_Start = 0;
+            history.m_Count = 0;
+        }
+    }
+
+private:
+    struct Keyframe
+    {
+        uint64_t m_Step;
+        std::vector<BallForce> m_Forces;
+        State m_State;
+
+        Keyframe() : m_Step {0}, m_Forces {}, m_State {} {}
+    };
+
+    struct BallRecord
+    {
+        uint64_t m_KeyframeNumber;
+        Ball m_Ball;
+    };
+
+    struct BallHistory
+    {
+        std::vector<BallRecord> m_Records;  // Ring, oldest at m_Start
+        size_t m_Start;
+        size_t m_Count;
+
+        BallHistory() : m_Records {}, m_Start {0}, m_Count {0} {}
+
+        BallRecord& getRecord(size_t i) { return m_Records[(m_Start + i) % m_Records.size()]; }
+    };
+
+    Keyframe& getKeyframe(uint64_t number) { return m_Keyframes[number % m_Keyframes.size()]; }
+    const Keyframe& getKeyframe(uint64_t number) const { return m_Keyframes[number % m_Keyframes.size()]; }
+
+    static bool isSameBall(const Ball& a, const Ball& b)
+    {
+        return
+            glm::all(glm::equal(a.position, b.position)) &&
+            glm::all(glm::equal(a.velocity, b.velocity)) &&
+            a.m_Type == b.m_Type &&
+            a.m_IsPocketed == b.m_IsPocketed;
+    }
+
+    // Forces only outlive a step when something outside the simulation
+    // applied them, so there are rarely more than one or two of these.
+    static const size_t INITIAL_FORCE_CAPACITY {16};
+
+    std::vector<Keyframe> m_Keyframes;  // Ring, indexed by keyframe number
+    size_t m_KeyframeCount;
+    uint64_t m_NextKeyframeNumber;
+
+    std::vector<BallHistory> m_BallHistories;
+
+    uint32_t m_KeyframeInterval;
+
+};
+
+
+#endif
@@ -0,0 +1,238 @@
+
+#include "Rules.hpp"
+
+
+BallGroup getBallGroup(BallType type)
+{
+    // The solids all come before the stripes in BallType.
+    if (type >= BallType::YellowStripe)
+    {
+        return BallGroup::Stripes;
+    }
+    if (type >= BallType::Yellow)
+    {
+        return BallGroup::Solids;
+    }
+    return BallGroup::None;
+}
+
+const char* getFoulDescription(Foul foul)
+{
+    switch (foul)
+    {
+        case Foul::None:                  return "no foul";
+        case Foul::NoContact:             return "the cue ball didn't hit anything";
+        case Foul::WrongBallFirst:        return "the cue ball hit the wrong ball first";
+        case Foul::NoCushionAfterContact: return "no ball was pocketed or hit a cushion after contact";
+        case Foul::Scratch:               return "the cue ball was pocketed";
+    }
+    return "unknown foul";
+}
+
+
+EightBallRules::EightBallRules() :
+    m_CurrentPlayer {0},
+    m_PlayerGroups {},
+    m_RemainingBalls {},
+    m_IsBreak {true},
+    m_IsGameOver {false},
+    m_ShotInProgress {false},
+    m_HasContact {false},
+    m_FirstContact {BallType::Cue},
+    m_CushionAfterContact {false},
+    m_CueBallPocketed {false},
+    m_BlackPocketed {false},
+    m_FirstPocketedGroup {BallGroup::None},
+    m_PocketedThisShot {}
+{
+    rack();
+}
+
+
+void EightBallRules::rack()
+{
+    m_CurrentPlayer = 0;
+    m_PlayerGroups = {{BallGroup::None, BallGroup::None}};
+    m_RemainingBalls = {{0, 7, 7}};
+    m_IsBreak = true;
+    m_IsGameOver = false;
+    m_ShotInProgress = false;
+}
+
+void EightBallRules::beginShot()
+{
+    m_ShotInProgress = true;
+    m_HasContact = false;
+    m_FirstContact = BallType::Cue;
+    m_CushionAfterContact = false;
+    m_CueBallPocketed = false;
+    m_BlackPocketed = false;
+    m_FirstPocketedGroup = BallGroup::None;
+    m_PocketedThisShot = {{0, 0, 0}};
+}
+
+void EightBallRules::consume(const EventBuffer& events, const std::vector<Ball>& balls)
+{
+    for (const auto& event : events)
+    {
+        const BallType type {balls[event.m_BallIndex].m_Type};
+        switch (event.m_Type)
+        {
+            case TableEventType::BallContact:
+            {
+                if (m_HasContact)
+                {
+                    break;
+                }
+
+                // Only the cue ball's first contact matters.
+                const BallType otherType {balls[event.m_Other].m_Type};
+                if (type == BallType::Cue || otherType == BallType::Cue)
+                {
+                    m_HasContact = true;
+                    m_FirstContact = (type == BallType::Cue) ? otherType : type;
+                }
+                break;
+            }
+
+            case TableEventType::Cushion:
+            {
+                if (m_HasContact)
+                {
+                    m_CushionAfterContact = true;
+                }
+                break;
+            }
+
+            case TableEventType::Pocket:
+            {
+                if (type == BallType::Cue)
+                {
+                    m_CueBallPocketed = true;
+                }
+                else if (type == BallType::Black)
+                {
+                    m_BlackPocketed = true;
+                }
+                else
+                {
+                    const BallGroup group {getBallGroup(type)};
+                    if (m_FirstPocketedGroup == BallGroup::None)
+                    {
+                        m_FirstPocketedGroup = group;
+                    }
+                    ++m_PocketedThisShot[static_cast<size_t>(group)];
+                    --m_RemainingBalls[static_cast<size_t>(group)];
+                }
+                break;
+            }
+        }
+    }
+}
+
+ShotResult EightBallRules::endShot()
+{
+    ShotResult result {getFoulSoFar(), false, m_CueBallPocketed, false, false, 0};
+
+    const uint8_t shooter {m_CurrentPlayer};
+    const uint8_t opponent {static_cast<uint8_t>(1 - shooter)};
+
+    const bool anyPocketed {m_FirstPocketedGroup != BallGroup::None || m_BlackPocketed};
+    if (result.m_Foul == Foul::None && ! anyPocketed && ! m_CushionAfterContact)
+    {
+        result.m_Foul = Foul::NoCushionAfterContact;
+    }
+
+    if (m_BlackPocketed)
+    {
+        if (m_IsBreak)
+        {
+            result.m_ReRack = true;
+        }
+        else
+        {
+            // Sinking the black wins, but only legally and only once the
+            // rest of your group is gone.
+            const bool wasOnBlack {isLegalFirstContact(BallType::Black)};
+            result.m_GameOver = true;
+            result.m_Winner = (wasOnBlack && result.m_Foul == Foul::None) ? shooter : opponent;
+            m_IsGameOver = true;
+        }
+    }
+
+    // The table stays open until somebody legally pockets a ball after the break.
+    if (isTableOpen() && ! m_IsBreak && result.m_Foul == Foul::None &&
+        m_FirstPocketedGroup != BallGroup::None)
+    {
+        m_PlayerGroups[shooter] = m_FirstPocketedGroup;
+        m_PlayerGroups[opponent] =
+            (m_FirstPocketedGroup == BallGroup::Solids) ? BallGroup::Stripes : BallGroup::Solids;
+    }
+
+    // Keep shooting after legally pocketing one of your own balls (or any
+    // ball at all, on the break).
+    const BallGroup group {m_PlayerGroups[shooter]};
+    const bool pocketedOwn {
+        (m_IsBreak || group == BallGroup::None) ?
+            m_FirstPocketedGroup != BallGroup::None :
+            m_PocketedThisShot[static_cast<size_t>(group)] > 0
+    };
+    result.m_TurnPasses = result.m_Foul != Foul::None || ! pocketedOwn;
+    if (result.m_TurnPasses)
+    {
+        m_CurrentPlayer = opponent;
+    }
+
+    if (result.m_ReRack)
+    {
+        // Everything sunk goes back on the table, so start the count again,
+        // with whoever's turn it now is to break.
+        const uint8_t breaker {m_CurrentPlayer};
+        rack();
+        m_CurrentPlayer = breaker;
+        return result;
+    }
+
+    m_IsBreak = false;
+    m_ShotInProgress = false;
+    return result;
+}
+
+
+Foul EightBallRules::getFoulSoFar() const
+{
+    if ( ! m_HasContact)
+    {
+        return Foul::NoContact;
+    }
+    if ( ! isLegalFirstContact(m_FirstContact))
+    {
+        return Foul::WrongBallFirst;
+    }
+    if (m_CueBallPocketed)
+    {
+        return Foul::Scratch;
+    }
+    return Foul::None;
+}
+
+bool EightBallRules::isLegalFirstContact(BallType type) const
+{
+    if (m_IsBreak)
+    {
+        return true;
+    }
+
+    const BallGroup group {m_PlayerGroups[m_CurrentPlayer]};
+    if (group == BallGroup::None)
+    {
+        // On an open table anything but the black will do.
+        return type != BallType::Black;
+    }
+
+    // The count includes anything from the group pocketed during this
+    // shot, since what matters is whether the group was cleared before it.
+    const auto groupIndex = static_cast<size_t>(group);
+    const bool onBlack {m_RemainingBalls[groupIndex] + m_PocketedThisShot[groupIndex] == 0};
+    return onBlack ? type == BallType::Black : getBallGroup(type) == group;
+}
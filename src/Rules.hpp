@@ -0,0 +1,106 @@
+
+#ifndef RULES_HPP
+#define RULES_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <vector>
+
+#include "Table.hpp"
+
+
+enum class BallGroup : uint8_t
+{
+    None,  // The cue ball and the black
+    Solids,
+    Stripes,
+};
+
+BallGroup getBallGroup(BallType type);
+
+
+enum class Foul : uint8_t
+{
+    None,
+    NoContact,
+    WrongBallFirst,
+    NoCushionAfterContact,
+    Scratch,
+};
+
+const char* getFoulDescription(Foul foul);
+
+
+struct ShotResult
+{
+    Foul m_Foul;
+    bool m_TurnPasses;
+    bool m_CueBallPocketed;
+    bool m_ReRack;  // The black went down on the break, so the balls go back on
+    bool m_GameOver;
+    uint8_t m_Winner;
+};
+
+
+// Keeps score in a game of 8-ball.
+//
+// Instead of looking back over the whole shot when it ends, the rules are
+// updated from each step's events as they happen, so every question about
+// the shot in progress (which ball was hit first, has a cushion been hit
+// since, ...) is answered from a handful of flags.
+class EightBallRules
+{
+public:
+    EightBallRules();
+
+    // Start a new game, with player 0 to break.
+    void rack();
+
+    void beginShot();
+    void consume(const EventBuffer& events, const std::vector<Ball>& balls);
+
+    // On a re-rack, the rules start the game again themselves; only the
+    // table is left to the caller.
+    ShotResult endShot();
+
+    bool isShotInProgress() const { return m_ShotInProgress; }
+    bool isGameOver() const { return m_IsGameOver; }
+    bool isTableOpen() const { return m_PlayerGroups[m_CurrentPlayer] == BallGroup::None; }
+
+    uint8_t getCurrentPlayer() const { return m_CurrentPlayer; }
+    BallGroup getPlayerGroup(uint8_t player) const { return m_PlayerGroups[player]; }
+    uint8_t getRemainingBalls(BallGroup group) const { return m_RemainingBalls[static_cast<size_t>(group)]; }
+
+    // The shot so far
+    bool hasContact() const { return m_HasContact; }
+    BallType getFirstContact() const { return m_FirstContact; }
+    bool wasCushionHitAfterContact() const { return m_CushionAfterContact; }
+    bool wasCueBallPocketed() const { return m_CueBallPocketed; }
+
+    // Whether the shot would be a foul if it ended now, other than for not
+    // yet having pocketed a ball or hit a cushion after contact.
+    Foul getFoulSoFar() const;
+
+private:
+    bool isLegalFirstContact(BallType type) const;
+
+    uint8_t m_CurrentPlayer;
+    std::array<BallGroup, 2> m_PlayerGroups;
+    std::array<uint8_t, 3> m_RemainingBalls;  // Indexed by BallGroup
+    bool m_IsBreak;
+    bool m_IsGameOver;
+
+    bool m_ShotInProgress;
+    bool m_HasContact;
+    BallType m_FirstContact;
+    bool m_CushionAfterContact;
+    bool m_CueBallPocketed;
+    bool m_BlackPocketed;
+    BallGroup m_FirstPocketedGroup;
+    std::array<uint8_t, 3> m_PocketedThisShot;  // Indexed by BallGroup
+
+};
+
+
+#endif
@@ -0,0 +1,220 @@
+
+#include "SpriteCache.hpp"
+#include "debug.hpp"
+
+
+SpriteCache::SpriteCache() :
+    m_Sheets {},
+    m_Current {0},
+    m_UseCount {0},
+    m_WantedSize {0},
+    m_pBuildThread {nullptr},
+    m_BuildSize {0},
+    m_BuiltAtlas {},
+    m_pBuiltShader {},
+    m_IsBuildDone {false}
+{
+    m_Sheets.reserve(CAPACITY + 1);
+
+    // So that getCurrent() always has something to return
+    m_Sheets.emplace_back();
+}
+
+SpriteCache::~SpriteCache()
+{
+    clear();
+}
+
+
+bool SpriteCache::load(SDL_Renderer* pRenderer, int spriteSize)
+{
+    m_WantedSize = spriteSize;
+
+    size_t index;
+    if (find(spriteSize, index))
+    {
+        use(index);
+        return true;
+    }
+    return upload(pRenderer, buildBallAtlas(spriteSize), std::make_shared<const BallShader>(spriteSize));
+}
+
+void SpriteCache::request(int spriteSize)
+{
+    m_WantedSize = spriteSize;
+
+    size_t index;
+    if (find(spriteSize, index))
+    {
+        use(index);
+    }
+    else if ( ! m_pBuildThread)
+    {
+        startBuild(spriteSize);
+    }
+
+    // Otherwise update() starts on it once the current build is done.
+}
+
+bool SpriteCache::update(SDL_Renderer* pRenderer)
+{
+    const int previousSize {getCurrent().m_SpriteSize};
+
+    if (m_pBuildThread && m_IsBuildDone.load(std::memory_order_acquire))
+    {
+        SDL_WaitThread(m_pBuildThread, nullptr);
+        m_pBuildThread = nullptr;
+        if ( ! upload(pRenderer, m_BuiltAtlas, m_pBuiltShader))
+        {
+            // Don't keep trying; the old sprites will do.
+            LOG("Could not upload %d pixel ball sprites: %s \n", m_BuildSize, SDL_GetError());
+            m_WantedSize = previousSize;
+        }
+        m_BuiltAtlas = BallAtlas {};
+        m_pBuiltShader.reset();
+    }
+
+    size_t index;
+    if (find(m_WantedSize, index))
+    {
+        use(index);
+    }
+    else
+    {
+        // The window changed size again while that was building. Keep it
+        // for later, but stay with what we had until the right one's done.
+        if (find(previousSize, index))
+        {
+            use(index);
+        }
+        if ( ! m_pBuildThread && m_WantedSize > 0)
+        {
+            startBuild(m_WantedSize);
+        }
+    }
+
+    return getCurrent().m_SpriteSize != previousSize;
+}
+
+void SpriteCache::clear()
+{
+    if (m_pBuildThread)
+    {
+        SDL_WaitThread(m_pBuildThread, nullptr);
+        m_pBuildThread = nullptr;
+    }
+
+    for (auto& sheet : m_Sheets)
+    {
+        SDL_DestroyTexture(sheet.m_pTexture);
+    }
+    m_Sheets.assign(1, SpriteSheet {});
+    m_Current = 0;
+}
+
+
+int SpriteCache::buildThread(void* pUserData)
+{
+    SpriteCache* pCache = static_cast<SpriteCache*>(pUserData);
+    pCache->m_BuiltAtlas = buildBallAtlas(pCache->m_BuildSize);
+    pCache->m_pBuiltShader = std::make_shared<const BallShader>(pCache->m_BuildSize);
+    pCache->m_IsBuildDone.store(true, std::memory_order_release);
+    return 0;
+}
+
+void SpriteCache::startBuild(int spriteSize)
+{
+    LOG("Building %d pixel ball sprites \n", spriteSize);
+
+    m_BuildSize = spriteSize;
+    m_IsBuildDone.store(false, std::memory_order_relaxed);
+    m_pBuildThread = SDL_CreateThread(buildThread, "sprite build", this);
+    if ( ! m_pBuildThread)
+    {
+        // Keep drawing with what we've got.
+        LOG("Could not start the sprite build thread: %s \n", SDL_GetError());
+        m_WantedSize = getCurrent().m_SpriteSize;
+    }
+}
+
+bool SpriteCache::upload(SDL_Renderer* pRenderer, const BallAtlas& atlas, const std::shared_ptr<const BallShader>& pShader)
+{
+    SpriteSheet sheet;
+    sheet.m_pTexture = SDL_CreateTexture(
+        pRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC,
+        atlas.m_Width,
+        atlas.m_Height
+    );
+    if ( ! sheet.m_pTexture)
+    {
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(sheet.m_pTexture, SDL_BLENDMODE_BLEND);
+    if (SDL_UpdateTexture(sheet.m_pTexture, NULL, atlas.m_Pixels.data(), 4 * atlas.m_Width) != 0)
+    {
+        SDL_DestroyTexture(sheet.m_pTexture);
+        return false;
+    }
+
+    const int size {atlas.m_SpriteSize};
+    sheet.m_SpriteSize = size;
+    sheet.m_Width = atlas.m_Width;
+    sheet.m_Height = atlas.m_Height;
+    for (size_t i = 0; i < BALL_TYPE_COUNT; ++i)
+    {
+        sheet.m_BallSpriteRects[i] = {atlas.m_BallSpriteX[i], 0, size, size};
+    }
+    sheet.m_PocketSpriteRect = {atlas.m_PocketSpriteX, 0, size, size};
+    sheet.m_pShader = pShader;
+
+    // The first sheet is the empty placeholder, until there's a real one.
+    if ( ! m_Sheets[0].m_pTexture)
+    {
+        m_Sheets.clear();
+    }
+    else if (m_Sheets.size() >= CAPACITY)
+    {
+        // Throw out whichever sheet has gone longest without being drawn
+        // with, other than the one that's drawn with now.
+        size_t stalest {m_Current == 0 ? 1u : 0u};
+        for (size_t i = 0; i < m_Sheets.size(); ++i)
+        {
+            if (i != m_Current && m_Sheets[i].m_LastUsed < m_Sheets[stalest].m_LastUsed)
+            {
+                stalest = i;
+            }
+        }
+        SDL_DestroyTexture(m_Sheets[stalest].m_pTexture);
+        m_Sheets.erase(m_Sheets.begin() + stalest);
+        if (m_Current > stalest)
+        {
+            --m_Current;
+        }
+    }
+
+    m_Sheets.push_back(sheet);
+    use(m_Sheets.size() - 1);
+    return true;
+}
+
+void SpriteCache::use(size_t index)
+{
+    m_Current = index;
+    m_Sheets[index].m_LastUsed = ++m_UseCount;
+}
+
+bool SpriteCache::find(int spriteSize, size_t& index) const
+{
+    for (size_t i = 0; i < m_Sheets.size(); ++i)
+    {
+        if (m_Sheets[i].m_pTexture && m_Sheets[i].m_SpriteSize == spriteSize)
+        {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
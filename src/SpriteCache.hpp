@@ -0,0 +1,113 @@
+
+#ifndef SPRITE_CACHE_HPP
+#define SPRITE_CACHE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "Table.hpp"
+#include "BallShader.hpp"
+#include "BallSprite.hpp"
+
+
+// An atlas of ball sprites, uploaded to a texture, and a shader for rolling
+// balls of the same size.
+struct SpriteSheet
+{
+    SDL_Texture* m_pTexture;
+    int m_SpriteSize;
+    int m_Width;
+    int m_Height;
+    std::array<SDL_Rect, BALL_TYPE_COUNT> m_BallSpriteRects;
+    SDL_Rect m_PocketSpriteRect;
+    std::shared_ptr<const BallShader> m_pShader;
+    uint64_t m_LastUsed;  // When it was last made the current sheet
+
+    SpriteSheet() :
+        m_pTexture {nullptr},
+        m_SpriteSize {0},
+        m_Width {0},
+        m_Height {0},
+        m_BallSpriteRects {},
+        m_PocketSpriteRect {},
+        m_pShader {},
+        m_LastUsed {0}
+    {
+    }
+
+    // The cache owns the texture, and the shader is shared, so copies are
+    // fine.
+    SpriteSheet(const SpriteSheet&) = default;
+    SpriteSheet& operator=(const SpriteSheet&) = default;
+};
+
+
+// Ball sprites at whatever size the window needs, so balls are drawn from
+// a texture close to their size on screen rather than a stretched one.
+//
+// Each size is rasterised on a thread of its own, along with the shader's
+// tables for that size, and drawing carries on with the sheet it already
+// has until the new one is ready. Sheets are kept
+// around afterwards, so going back to a size (dragging the window between
+// monitors, say) is instant.
+class SpriteCache
+{
+public:
+    SpriteCache();
+    ~SpriteCache();
+
+    // Build and upload a sheet right away, and make it the current one.
+    bool load(SDL_Renderer* pRenderer, int spriteSize);
+
+    // Switch to sprites of `spriteSize`, building them in the background if
+    // they aren't cached already.
+    void request(int spriteSize);
+
+    // Pick up a finished build, if there is one. Returns true if the
+    // current sheet changed. Call this on the thread that renders.
+    bool update(SDL_Renderer* pRenderer);
+
+    const SpriteSheet& getCurrent() const { return m_Sheets[m_Current]; }
+
+    // Destroy every texture.
+    void clear();
+
+private:
+    static int buildThread(void* pUserData);
+    bool upload(SDL_Renderer* pRenderer, const BallAtlas& atlas, const std::shared_ptr<const BallShader>& pShader);
+    bool find(int spriteSize, size_t& index) const;
+    void startBuild(int spriteSize);
+    void use(size_t index);
+
+private:
+    std::vector<SpriteSheet> m_Sheets;
+    size_t m_Current;
+    uint64_t m_UseCount;
+
+    // What we'd like to be drawing with, once it's built
+    int m_WantedSize;
+
+    // Written by the build thread, and only read once m_IsBuildDone is set.
+    SDL_Thread* m_pBuildThread;
+    int m_BuildSize;
+    BallAtlas m_BuiltAtlas;
+    std::shared_ptr<const BallShader> m_pBuiltShader;
+    std::atomic<bool> m_IsBuildDone;
+
+    // Anything past this many sheets pushes out the least recently used one.
+    static const size_t CAPACITY {4};
+
+private:
+    SpriteCache(const SpriteCache&) = delete;
+    SpriteCache& operator=(const SpriteCache&) = delete;
+
+};
+
+
+#endif
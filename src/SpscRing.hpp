@@ -0,0 +1,72 @@
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <stddef.h>
+#include <array>
+#include <atomic>
+
+
+// A fixed-size, lock-free queue for exactly one producer thread and one
+// consumer thread. Neither side ever blocks or allocates, so it is safe to
+// use from inside an audio callback.
+template<typename T, size_t CAPACITY>
+class SpscRing
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() :
+        m_Items {},
+        m_Head {0},
+        m_Tail {0}
+    {
+    }
+
+    // Producer side. Returns false (and drops the item) if the ring is full.
+    bool push(const T& item)
+    {
+        const size_t tail {m_Tail.load(std::memory_order_relaxed)};
+        if (tail - m_Head.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+        m_Items[tail & (CAPACITY - 1)] = item;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T& item)
+    {
+        const size_t head {m_Head.load(std::memory_order_relaxed)};
+        if (head == m_Tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = m_Items[head & (CAPACITY - 1)];
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, CAPACITY> m_Items;
+
+    // Keep the two indices on separate cache lines so the producer and
+    // consumer don't keep stealing the line from each other.
+    alignas(64) std::atomic<size_t> m_Head;
+    alignas(64) std::atomic<size_t> m_Tail;
+
+private:
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+};
+
+
+#endif
@@ -0,0 +1,238 @@
+
+#include <fcntl.h>     // for O_* constants
+#include <sys/mman.h>  // for shm_open, mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for ftruncate, getpid
+#include <chrono>
+#include <cstring>     // for std::memcpy
+#include <new>
+
+#include "StateExport.hpp"
+#include "debug.hpp"
+
+
+StateRing* StateExport::s_pRing {nullptr};
+
+// Only touched by the thread that publishes
+static uint64_t s_PublishedCount {0};
+
+
+bool StateExport::start()
+{
+    const int fd {shm_open(STATE_SHM_NAME, O_CREAT | O_RDWR, 0644)};
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(StateRing)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* pMemory {mmap(nullptr, sizeof(StateRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+    close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The magic number goes in last, so that a reader never takes a half
+    // set up ring for a real one.
+    StateRing* pRing {new (pMemory) StateRing {}};
+    pRing->m_Version = StateRing::VERSION;
+    pRing->m_RecordSize = sizeof(StateRecord);
+    pRing->m_Capacity = STATE_RING_CAPACITY;
+    pRing->m_ProcessId = static_cast<uint64_t>(getpid());
+    std::atomic_thread_fence(std::memory_order_release);
+    pRing->m_Magic = StateRing::MAGIC;
+
+    s_PublishedCount = 0;
+    s_pRing = pRing;
+
+    LOG("Exporting table state to %s \n", STATE_SHM_NAME);
+    return true;
+}
+
+void StateExport::stop()
+{
+    if ( ! s_pRing)
+    {
+        return;
+    }
+
+    munmap(s_pRing, sizeof(StateRing));
+    shm_unlink(STATE_SHM_NAME);
+    s_pRing = nullptr;
+}
+
+
+void StateExport::publish(const Table& table)
+{
+    if ( ! s_pRing)
+    {
+        return;
+    }
+
+    StateRecord record {};
+    record.m_StepCount = table.getStepCount();
+    record.m_PublishedAt = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count());
+
+    const std::vector<Ball>& balls = table.getBalls();
+    for (size_t i = 0; i < balls.size() && i < BALL_TYPE_COUNT; ++i)
+    {
+        const Ball& ball = balls[i];
+        StateBall& stateBall = record.m_Balls[i];
+        stateBall.m_PositionX = ball.position.x;
+        stateBall.m_PositionY = ball.position.y;
+        stateBall.m_VelocityX = ball.velocity.x;
+        stateBall.m_VelocityY = ball.velocity.y;
+        stateBall.m_Type = static_cast<uint32_t>(ball.m_Type);
+        stateBall.m_Flags = ball.m_IsPocketed ? STATE_BALL_POCKETED : 0;
+        ++record.m_BallCount;
+    }
+
+    uint64_t words[STATE_RECORD_WORD_COUNT];
+    std::memcpy(words, &record, sizeof(words));
+
+    const uint64_t index {s_PublishedCount};
+    StateSlot& slot = s_pRing->m_Slots[index % STATE_RING_CAPACITY];
+    slot.m_Sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < STATE_RECORD_WORD_COUNT; ++i)
+    {
+        slot.m_Words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.m_Sequence.store(2 * index + 2, std::memory_order_release);
+
+    s_PublishedCount = index + 1;
+    s_pRing->m_PublishedCount.store(s_PublishedCount, std::memory_order_release);
+}
+
+
+StateReader::StateReader() :
+    m_pRing {nullptr},
+    m_NextIndex {0},
+    m_LostCount {0}
+{
+}
+
+StateReader::~StateReader()
+{
+    close();
+}
+
+bool StateReader::open()
+{
+    close();
+
+    const int fd {shm_open(STATE_SHM_NAME, O_RDONLY, 0)};
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(StateRing))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* pMemory {mmap(nullptr, sizeof(StateRing), PROT_READ, MAP_SHARED, fd, 0)};
+    ::close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const StateRing* pRing {static_cast<const StateRing*>(pMemory)};
+    const bool isValid {pRing->m_Magic == StateRing::MAGIC};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if ( ! isValid ||
+        pRing->m_Version != StateRing::VERSION ||
+        pRing->m_RecordSize != sizeof(StateRecord) ||
+        pRing->m_Capacity != STATE_RING_CAPACITY
+    ) {
+        munmap(pMemory, sizeof(StateRing));
+        return false;
+    }
+
+    m_pRing = pRing;
+    const uint64_t publishedCount {m_pRing->m_PublishedCount.load(std::memory_order_acquire)};
+    m_NextIndex = publishedCount > 0 ? publishedCount - 1 : 0;
+    m_LostCount = 0;
+    return true;
+}
+
+void StateReader::close()
+{
+    if (m_pRing)
+    {
+        munmap(const_cast<void*>(static_cast<const void*>(m_pRing)), sizeof(StateRing));
+        m_pRing = nullptr;
+    }
+}
+
+uint64_t StateReader::getProcessId() const
+{
+    return m_pRing ? m_pRing->m_ProcessId : 0;
+}
+
+
+bool StateReader::next(StateRecord& record)
+{
+    if ( ! m_pRing)
+    {
+        return false;
+    }
+
+    const uint64_t publishedCount {m_pRing->m_PublishedCount.load(std::memory_order_acquire)};
+    if (publishedCount > STATE_RING_CAPACITY && m_NextIndex < publishedCount - STATE_RING_CAPACITY)
+    {
+        // Lapped: skip straight to the oldest record that's still there.
+        const uint64_t oldest {publishedCount - STATE_RING_CAPACITY};
+        m_LostCount += oldest - m_NextIndex;
+        m_NextIndex = oldest;
+    }
+
+    while (m_NextIndex < publishedCount)
+    {
+        const uint64_t index {m_NextIndex++};
+        if (read(index, record))
+        {
+            return true;
+        }
+
+        // Overwritten while we were getting to it, or copying it out.
+        ++m_LostCount;
+    }
+    return false;
+}
+
+bool StateReader::read(uint64_t index, StateRecord& record) const
+{
+    const StateSlot& slot = m_pRing->m_Slots[index % STATE_RING_CAPACITY];
+    const uint64_t expected {2 * index + 2};
+    if (slot.m_Sequence.load(std::memory_order_acquire) != expected)
+    {
+        return false;
+    }
+
+    uint64_t words[STATE_RECORD_WORD_COUNT];
+    for (size_t i = 0; i < STATE_RECORD_WORD_COUNT; ++i)
+    {
+        words[i] = slot.m_Words[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.m_Sequence.load(std::memory_order_relaxed) != expected)
+    {
+        return false;
+    }
+
+    std::memcpy(&record, words, sizeof(words));
+    return true;
+}
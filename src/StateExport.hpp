@@ -0,0 +1,136 @@
+
+#ifndef STATE_EXPORT_HPP
+#define STATE_EXPORT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+#include "Table.hpp"
+
+
+// One ball, as of the end of a step.
+struct StateBall
+{
+    float m_PositionX;
+    float m_PositionY;
+    float m_VelocityX;
+    float m_VelocityY;
+    uint32_t m_Type;   // BallType
+    uint32_t m_Flags;  // STATE_BALL_POCKETED
+};
+
+static const uint32_t STATE_BALL_POCKETED {1 << 0};
+
+// The whole table, as of the end of a step.
+struct StateRecord
+{
+    uint64_t m_StepCount;    // Goes backwards on a rewind
+    uint64_t m_PublishedAt;  // Microseconds since the Unix epoch
+    uint32_t m_BallCount;
+    uint32_t m_Reserved;
+    StateBall m_Balls[BALL_TYPE_COUNT];
+};
+
+static_assert(sizeof(StateRecord) % sizeof(uint64_t) == 0, "A record has to be a whole number of words");
+static const size_t STATE_RECORD_WORD_COUNT {sizeof(StateRecord) / sizeof(uint64_t)};
+
+// About ten seconds of play.
+static const size_t STATE_RING_CAPACITY {4096};
+
+
+// A slot in the ring. Its sequence number is 2n + 1 while record n is
+// being written into it, and 2n + 2 once that's done.
+struct StateSlot
+{
+    std::atomic<uint64_t> m_Sequence;
+    std::array<std::atomic<uint64_t>, STATE_RECORD_WORD_COUNT> m_Words;
+};
+
+// The layout of the shared memory segment: a header, then the slots.
+//
+// Record n goes in slot n % STATE_RING_CAPACITY, overwriting whatever was
+// there, and then m_PublishedCount becomes n + 1. The game never looks at
+// the readers, so one that falls more than a ring behind just loses
+// records: it can tell from the slot's sequence number, which won't be the
+// one it expected, either before or after it copies the record out.
+//
+// The words are the same bytes as a StateRecord (the atomics are lock-free,
+// so they're plain uint64_t underneath), which lets a tool in any language
+// map the segment and read the records in place, as long as it checks the
+// sequence numbers around each one.
+struct StateRing
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint32_t m_RecordSize;
+    uint32_t m_Capacity;
+    uint64_t m_ProcessId;
+    std::atomic<uint64_t> m_PublishedCount;
+    std::array<StateSlot, STATE_RING_CAPACITY> m_Slots;
+
+    static const uint32_t MAGIC {0x53544154};  // "STAT"
+    static const uint32_t VERSION {1};
+};
+
+// Where the game exports to, under /dev/shm on Linux.
+static const char* const STATE_SHM_NAME {"/billiards-state"};
+
+
+// The game's side: publishes every step of one table.
+class StateExport
+{
+public:
+    // Create the shared memory segment. Returns false if it couldn't be.
+    static bool start();
+    static void stop();
+
+    static bool isEnabled() { return s_pRing != nullptr; }
+
+    // From the thread that steps the table, after every step. Does nothing
+    // unless started.
+    static void publish(const Table& table);
+
+private:
+    static StateRing* s_pRing;
+
+};
+
+
+// A reader's side. Reads the records in order, skipping any the game has
+// already overwritten.
+class StateReader
+{
+public:
+    StateReader();
+    ~StateReader();
+
+    // Returns false if no game is exporting, or it's an incompatible one.
+    // Starts from the latest record.
+    bool open();
+    void close();
+
+    uint64_t getProcessId() const;
+
+    // Copy out the next record. Returns false if there isn't one yet.
+    bool next(StateRecord& record);
+
+    // Records the game overwrote before they could be read
+    uint64_t getLostCount() const { return m_LostCount; }
+
+private:
+    bool read(uint64_t index, StateRecord& record) const;
+
+    const StateRing* m_pRing;
+    uint64_t m_NextIndex;
+    uint64_t m_LostCount;
+
+private:
+    StateReader(const StateReader&) = delete;
+    StateReader& operator=(const StateReader&) = delete;
+
+};
+
+
+#endif
@@ -0,0 +1,521 @@
+
+#include <cmath>      // for std::floor
+#include <algorithm>  // for std::remove_if
+#include <glm/geometric.hpp>  // for glm::length, glm::distance, glm::reflect
+#include <glm/vec3.hpp>
+
+#include "Table.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+#include "debug.hpp"
+
+
+Ball::Ball(BallType type) :
+    position {0, 0},
+    velocity {0, 0},
+    m_Orientation {1.0f, 0.0f, 0.0f, 0.0f},
+    m_Type {type},
+    m_IsPocketed {false}
+{
+}
+
+BallForce::BallForce(size_t ballIndex, glm::vec2 force, float duration) :
+    m_BallIndex {ballIndex},
+    m_Force {force},
+    m_Duration {duration}
+{
+}
+
+
+constexpr float Table::TIME_STEP;
+constexpr float Table::REST_ENERGY_THRESHOLD;
+constexpr float Table::POCKET_RADIUS;
+
+
+Table::Table() :
+    m_Balls {},
+    m_BallForces {},
+    m_Events {EVENT_BUFFER_CAPACITY},
+    m_StepCount {0},
+    m_PendingTime {0.0f},
+    m_Stats {},
+    m_IsInstrumented {true}
+{
+    // Enough for a rack that's all touching, so the forces never have to
+    // grow during play.
+    m_Balls.reserve(BALL_TYPE_COUNT);
+    m_BallForces.reserve(INITIAL_FORCE_CAPACITY);
+}
+
+
+void Table::rackBalls()
+{
+    LOG("Racking Balls \n");
+
+    removeAllBalls();
+
+    // Indexed by BallType
+    std::array<glm::vec2, BALL_TYPE_COUNT> spots;
+    auto spot = [&spots](BallType type) -> glm::vec2&
+    {
+        return spots[static_cast<size_t>(type)];
+    };
+    spot(BallType::Cue) = getCueSpot();
+
+    auto positionBall = [](int row, int position)
+    {
+        static const float SPACING_MULTIPLIER {1.1f};
+
+        float baseX {FELT_LEFT_COORD + 0.6f * FELT_WIDTH};
+        float x {baseX + row * (SPACING_MULTIPLIER * BALL_DIAMETER)};
+
+        float baseY {FELT_TOP_COORD + FELT_HEIGHT / 2};
+        baseY -= static_cast<float>(row) / 2.0f * BALL_DIAMETER;
+        float y {baseY + SPACING_MULTIPLIER * BALL_DIAMETER * position};
+
+        return glm::vec2{x, y};
+    };
+
+    spot(BallType::Yellow)       = positionBall(0, 0);
+
+    spot(BallType::RedStripe)    = positionBall(1, 0);
+    spot(BallType::Red)          = positionBall(1, 1);
+
+    spot(BallType::Green)        = positionBall(2, 0);
+    spot(BallType::Black)        = positionBall(2, 1);
+    spot(BallType::GreenStripe)  = positionBall(2, 2);
+
+    spot(BallType::OrangeStripe) = positionBall(3, 0);
+    spot(BallType::MaroonStripe) = positionBall(3, 1);
+    spot(BallType::Purple)       = positionBall(3, 2);
+    spot(BallType::YellowStripe) = positionBall(3, 3);
+
+    spot(BallType::Maroon)       = positionBall(4, 0);
+    spot(BallType::Blue)         = positionBall(4, 1);
+    spot(BallType::BlueStripe)   = positionBall(4, 2);
+    spot(BallType::Orange)       = positionBall(4, 3);
+    spot(BallType::PurpleStripe) = positionBall(4, 4);
+
+
+    // In BallType order, so the cue ball is always ball 0.
+    for (size_t i = 0; i < spots.size(); ++i)
+    {
+        addBall(static_cast<BallType>(i), spots[i], glm::vec2{0.0f, 0.0f});
+    }
+
+}
+
+void Table::addBall(BallType type, glm::vec2 position, glm::vec2 velocity)
+{
+    Ball ball {type};
+    ball.position = position;
+    ball.velocity = velocity;
+    m_Balls.push_back(ball);
+}
+
+void Table::removeAllBalls()
+{
+    m_BallForces.clear();
+    m_Balls.clear();
+}
+
+void Table::respotBall(size_t ballIndex, glm::vec2 position)
+{
+    auto& ball = m_Balls[ballIndex];
+    ball.position = position;
+    ball.velocity = {0.0f, 0.0f};
+    ball.m_IsPocketed = false;
+}
+
+void Table::applyForce(size_t ballIndex, glm::vec2 force)
+{
+    m_BallForces.push_back({ballIndex, force, 0.0f});
+}
+
+void Table::freezeBalls()
+{
+    for (auto& ball : m_Balls)
+    {
+        ball.velocity = {0, 0};
+    }
+    m_BallForces.clear();
+}
+
+
+void Table::step(uint32_t count)
+{
+    m_Events.clear();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        simulatePhysics();
+    }
+}
+
+uint32_t Table::advance(float seconds)
+{
+    m_PendingTime += seconds;
+
+    const auto count = static_cast<uint32_t>(std::floor(m_PendingTime / TIME_STEP));
+    m_PendingTime -= count * TIME_STEP;
+
+    step(count);
+    return count;
+}
+
+uint32_t Table::runUntilRest(float maxTime)
+{
+    const auto maxSteps = static_cast<uint32_t>(maxTime / TIME_STEP);
+
+    m_Events.clear();
+
+    uint32_t count = 0;
+    while (count < maxSteps && ! isAtRest())
+    {
+        simulatePhysics();
+        ++count;
+    }
+    return count;
+}
+
+
+glm::vec2 Table::getCueSpot()
+{
+    return glm::vec2{
+        FELT_LEFT_COORD + FELT_WIDTH * 0.15f,
+        FELT_TOP_COORD + FELT_HEIGHT / 2
+    };
+}
+
+std::array<glm::vec2, Table::POCKET_COUNT> Table::getPocketPositions()
+{
+    const float left {FELT_LEFT_COORD};
+    const float right {FELT_LEFT_COORD + FELT_WIDTH};
+    const float middle {FELT_LEFT_COORD + FELT_WIDTH / 2};
+    const float top {FELT_TOP_COORD};
+    const float bottom {FELT_TOP_COORD + FELT_HEIGHT};
+
+    return {{
+        {left,   top},
+        {middle, top},
+        {right,  top},
+        {left,   bottom},
+        {middle, bottom},
+        {right,  bottom},
+    }};
+}
+
+
+float Table::getKineticEnergy() const
+{
+    // E = (1/2)mv^2, and every ball has the same mass.
+    float sumSquaredSpeeds {0.0f};
+    for (const auto& ball : m_Balls)
+    {
+        sumSquaredSpeeds += glm::dot(ball.velocity, ball.velocity);
+    }
+    return 0.5f * BALL_MASS * sumSquaredSpeeds;
+}
+
+bool Table::isAtRest() const
+{
+    // A pending force (e.g. a shot that hasn't been integrated yet) will
+    // set things moving again, so that doesn't count as rest.
+    return m_BallForces.empty() && getKineticEnergy() < REST_ENERGY_THRESHOLD;
+}
+
+
+#ifndef NPROFILE
+// Put a step's collisions on the trace's timeline.
+static void traceEvents(const EventBuffer& events, size_t first)
+{
+    for (size_t i = first; i < events.size(); ++i)
+    {
+        const TableEvent& event = events[i];
+        switch (event.m_Type)
+        {
+            case TableEventType::BallContact:
+                Tracer::instant("ball_contact", "collision", "ball", event.m_BallIndex, "other", event.m_Other);
+                break;
+            case TableEventType::Cushion:
+                Tracer::instant("cushion", "collision", "ball", event.m_BallIndex, "cushion", event.m_Other);
+                break;
+            case TableEventType::Pocket:
+                Tracer::instant("pocket", "collision", "ball", event.m_BallIndex, "pocket", event.m_Other);
+                break;
+        }
+    }
+}
+#endif
+
+void Table::simulatePhysics()
+{
+    const float deltaTime {TIME_STEP};
+#ifndef NPROFILE
+    const size_t firstEvent {m_Events.size()};
+#endif
+
+    // Check for collisions between balls
+    PROFILE_LAP_BEGIN_IF(lap, BallPairs, m_IsInstrumented);
+    uint64_t pairTests {0};
+    for (size_t i = 0; i < m_Balls.size(); ++i)
+    {
+        const auto& ball = m_Balls[i];
+        if (ball.m_IsPocketed)
+        {
+            continue;
+        }
+
+        for (size_t j = 0; j < m_Balls.size(); ++j)
+        {
+            // Skip if same ball
+            if (i == j)
+            {
+                continue;
+            }
+            const auto& otherBall = m_Balls[j];
+            if (otherBall.m_IsPocketed)
+            {
+                continue;
+            }
+            ++pairTests;
+
+            // If the circles don't intersect, then there is no collision
+            if (glm::distance(ball.position, otherBall.position) > static_cast<float>(BALL_DIAMETER))
+            {
+                continue;
+            }
+
+            // Perfectly elastic collision. Operates in the reference frame
+            // of the target (i.e. the target is at rest).
+            const auto speed = glm::length(ball.velocity);
+            auto force = 0.01f * (otherBall.position - ball.position) * speed * speed;
+            m_BallForces.push_back({j, force, 0.0f});
+
+            // The equal and opposite reaction force (Newton's Third Law)
+            m_BallForces.push_back({i, -force, 0.0f});
+
+            // Only report the step on which the balls first touch, which
+            // is when they weren't yet touching at their previous positions.
+            if (i < j)
+            {
+                const auto lastPosition = ball.position - 1000.0f * deltaTime * ball.velocity;
+                const auto otherLastPosition = otherBall.position - 1000.0f * deltaTime * otherBall.velocity;
+                if (glm::distance(lastPosition, otherLastPosition) > static_cast<float>(BALL_DIAMETER))
+                {
+                    ++m_Stats.m_Contacts;
+                    m_Events.push({
+                        TableEventType::BallContact,
+                        static_cast<uint32_t>(i),
+                        static_cast<uint32_t>(j),
+                        0.5f * (ball.position + otherBall.position),
+                        getTime(),
+                        glm::distance(ball.velocity, otherBall.velocity)
+                    });
+                }
+            }
+
+        }
+    }
+
+    m_Stats.m_PairTests += pairTests;
+
+    // Check for collisions between balls and bumpers
+    PROFILE_LAP(lap, Cushions);
+    const auto BALL_RADIUS = static_cast<float>(BALL_DIAMETER) / 2.0f;
+    // The normal points out of the bumper, towards the middle of the table.
+    auto hitCushion = [this, BALL_RADIUS](size_t ballIndex, Cushion cushion, glm::vec2 normal)
+    {
+        auto& ball = m_Balls[ballIndex];
+
+        // A ball which is still inside the bumper after bouncing will be
+        // reflected again, but only the bounce into the bumper is a hit.
+        const float approachSpeed {-glm::dot(ball.velocity, normal)};
+        if (approachSpeed > 0.0f)
+        {
+            ++m_Stats.m_CushionHits;
+            m_Events.push({
+                TableEventType::Cushion,
+                static_cast<uint32_t>(ballIndex),
+                static_cast<uint32_t>(cushion),
+                ball.position - BALL_RADIUS * normal,
+                getTime(),
+                approachSpeed
+            });
+        }
+
+        ball.velocity = glm::reflect(ball.velocity, normal);
+    };
+    for (size_t i = 0; i < m_Balls.size(); ++i)
+    {
+        const auto& ball = m_Balls[i];
+        if (ball.m_IsPocketed || checkPockets(i))
+        {
+            continue;
+        }
+
+        // Right Bumper
+        {
+            // Check if the rightmost point of the circle is behind the line
+            // of the bumper.
+            const auto WALL_COORD = static_cast<float>(FELT_LEFT_COORD + FELT_WIDTH);
+            if (ball.position.x + BALL_RADIUS >= WALL_COORD)
+            {
+                // Do a simple reflection off of the surface: perfectly
+                // elastic collision. Doesn't impart a BallForce (for now).
+                hitCushion(i, Cushion::Right, glm::vec2{-1.0f, 0.0f});
+                continue;
+            }
+        }
+
+        // Left Bumper
+        {
+            const auto WALL_COORD = static_cast<float>(FELT_LEFT_COORD);
+            if (ball.position.x - BALL_RADIUS <= WALL_COORD)
+            {
+                hitCushion(i, Cushion::Left, glm::vec2{1.0f, 0.0f});
+                continue;
+            }
+        }
+
+        // Top Bumper
+        {
+            const auto WALL_COORD = static_cast<float>(FELT_TOP_COORD);
+            if (ball.position.y - BALL_RADIUS <= WALL_COORD)
+            {
+                hitCushion(i, Cushion::Top, glm::vec2{0.0f, 1.0f});
+                continue;
+            }
+        }
+
+        // Bottom Bumper
+        {
+            const auto WALL_COORD = static_cast<float>(FELT_TOP_COORD + FELT_HEIGHT);
+            if (ball.position.y + BALL_RADIUS >= WALL_COORD)
+            {
+                hitCushion(i, Cushion::Bottom, glm::vec2{0.0f, -1.0f});
+                continue;
+            }
+        }
+    }
+
+    // Apply friction forces
+    PROFILE_LAP(lap, Friction);
+    uint32_t movingBalls {0};
+    for (size_t i = 0; i < m_Balls.size(); ++i)
+    {
+        auto& ball = m_Balls[i];
+        const auto speed = glm::length(ball.velocity);
+
+        // This is a rough (bad) analog of static friction.
+        if (speed < STATIC_FRICTION_THRESHOLD)
+        {
+            ball.velocity = {0.0f, 0.0f};
+        }
+        else
+        {
+            // This is a rough analog of dynamic friction.
+            // F = (coefficient)(normal force)
+            //   The normal force is, on a flat pool table, just gravity.
+            //   This can be approximated with the mass of the ball.
+
+            // The friction should oppose the direction of motion, but
+            // I'm not sure how the proper physics equations work at the
+            // moment. I'll just fake it for now.
+            const glm::vec2 friction = -ball.velocity * (FRICTION_COEFFICIENT / BALL_MASS / speed);
+            m_BallForces.push_back({i, friction, 0.0f});
+            ++movingBalls;
+        }
+    }
+    m_Stats.m_MovingBalls = movingBalls;
+    m_Stats.m_ForceCount = static_cast<uint32_t>(m_BallForces.size());
+
+    // (Poorly) integrate acceleration
+    PROFILE_LAP(lap, Integration);
+    for (auto& force : m_BallForces)
+    {
+        // F = ma  =>  a = F/m
+        // V = (integral of a from t=0 to t=time) = (sum acceleration from each frame)
+        glm::vec2 acceleration = force.m_Force / BALL_MASS;
+        m_Balls[force.m_BallIndex].velocity += acceleration;
+    }
+
+    for (auto& ball : m_Balls)
+    {
+        if (ball.m_IsPocketed)
+        {
+            // Forces from this step may still have been applied to it.
+            ball.velocity = {0.0f, 0.0f};
+            continue;
+        }
+        const glm::vec2 movement {1000.0f * deltaTime * ball.velocity};
+        ball.position += movement;
+
+        // Rolling without slipping turns the ball about the line across
+        // the felt at right angles to its motion, by the distance it went
+        // over its radius.
+        const float distance {glm::length(movement)};
+        if (distance > 0.0f)
+        {
+            const glm::vec3 axis {movement.y / distance, -movement.x / distance, 0.0f};
+            ball.m_Orientation = glm::normalize(glm::angleAxis(distance / BALL_RADIUS, axis) * ball.m_Orientation);
+        }
+    }
+
+    // Update forces, removing expired ones
+    PROFILE_LAP(lap, ForceCleanup);
+    for (auto& force : m_BallForces)
+    {
+        force.m_Duration -= deltaTime;
+    }
+    auto it = std::remove_if(begin(m_BallForces), end(m_BallForces), [](const auto& force)
+    {
+        return force.m_Duration < 0.0f;
+    });
+    m_BallForces.erase(it, end(m_BallForces));
+
+#ifndef NPROFILE
+    if (Tracer::isEnabled() && m_IsInstrumented)
+    {
+        traceEvents(m_Events, firstEvent);
+    }
+#endif
+
+    ++m_StepCount;
+}
+
+bool Table::checkPockets(size_t ballIndex)
+{
+    auto& ball = m_Balls[ballIndex];
+
+    // Most of the time the ball is nowhere near a rail, let alone a pocket.
+    const float left {FELT_LEFT_COORD + POCKET_RADIUS};
+    const float right {FELT_LEFT_COORD + FELT_WIDTH - POCKET_RADIUS};
+    const float top {FELT_TOP_COORD + POCKET_RADIUS};
+    const float bottom {FELT_TOP_COORD + FELT_HEIGHT - POCKET_RADIUS};
+    if (ball.position.x > left && ball.position.x < right &&
+        ball.position.y > top && ball.position.y < bottom)
+    {
+        return false;
+    }
+
+    const auto pockets = getPocketPositions();
+    for (size_t i = 0; i < pockets.size(); ++i)
+    {
+        if (glm::distance(ball.position, pockets[i]) < POCKET_RADIUS)
+        {
+            m_Events.push({
+                TableEventType::Pocket,
+                static_cast<uint32_t>(ballIndex),
+                static_cast<uint32_t>(i),
+                pockets[i],
+                getTime(),
+                glm::length(ball.velocity)
+            });
+
+            ball.m_IsPocketed = true;
+            ball.velocity = {0.0f, 0.0f};
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,192 @@
+
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TableEvent.hpp"
+
+
+enum class BallType
+{
+    Cue,
+    Black,
+
+    Yellow,
+    Blue,
+    Red,
+    Purple,
+    Orange,
+    Green,
+    Maroon,
+
+    YellowStripe,
+    BlueStripe,
+    RedStripe,
+    PurpleStripe,
+    OrangeStripe,
+    GreenStripe,
+    MaroonStripe,
+};
+
+static const size_t BALL_TYPE_COUNT {16};
+
+
+struct Ball
+{
+    glm::vec2 position, velocity;
+
+    // How far the ball has rolled, as a rotation from its own frame to the
+    // table's: x along the table, y down it, z into the felt. It's only for
+    // drawing, and has no effect on the simulation.
+    glm::quat m_Orientation;
+
+    BallType m_Type;
+    bool m_IsPocketed;
+
+    Ball(BallType type);
+};
+
+
+struct BallForce
+{
+    size_t m_BallIndex;
+    glm::vec2 m_Force;
+    float m_Duration;  // Time left before force stops (0.0 for one frame)
+
+    BallForce(size_t ballIndex, glm::vec2 force, float duration);
+};
+
+
+// Running totals of what the physics has been up to, for telemetry
+struct TableStats
+{
+    uint64_t m_PairTests;    // Pairs of balls checked for contact
+    uint64_t m_Contacts;     // Pairs of balls coming into contact
+    uint64_t m_CushionHits;
+    uint32_t m_MovingBalls;  // As of the last step
+    uint32_t m_ForceCount;   // Forces applied in the last step
+};
+
+
+// The simulated state of a billiards table. This knows nothing about SDL,
+// so it can be stepped from batch jobs, planners and tests as easily as
+// from the interactive game loop.
+class Table
+{
+public:
+    Table();
+
+    // Put the balls back in their starting positions, at rest.
+    void rackBalls();
+
+    void addBall(BallType type, glm::vec2 position, glm::vec2 velocity);
+    void removeAllBalls();
+
+    // Take a ball back out of its pocket and put it down at rest.
+    void respotBall(size_t ballIndex, glm::vec2 position);
+
+    void applyForce(size_t ballIndex, glm::vec2 force);
+    void freezeBalls();
+
+    // Advance the simulation by exactly `count` fixed time steps.
+    //
+    // Each call to step(), advance() or runUntilRest() starts with an empty
+    // event buffer, so consumers should read getEvents() after each one.
+    void step(uint32_t count = 1);
+
+    // Advance the simulation by `seconds` of simulated time. Any fraction
+    // of a time step left over is carried into the next call. Returns the
+    // number of steps taken.
+    uint32_t advance(float seconds);
+
+    // Step until the balls come to rest or `maxTime` seconds have been
+    // simulated, whichever happens first. Returns the number of steps taken.
+    uint32_t runUntilRest(float maxTime);
+
+    float getKineticEnergy() const;
+    bool isAtRest() const;
+
+    const std::vector<Ball>& getBalls() const { return m_Balls; }
+    uint64_t getStepCount() const { return m_StepCount; }
+    float getTime() const { return m_StepCount * TIME_STEP; }
+
+    const EventBuffer& getEvents() const { return m_Events; }
+    const TableStats& getStats() const { return m_Stats; }
+
+    // Whether steps are timed by the profiler, and their collisions put on
+    // the trace. Tables that only look ahead (for the aim overlay, say)
+    // turn it off, so that the profile and the trace are of the game's own
+    // table.
+    bool isInstrumented() const { return m_IsInstrumented; }
+    void setInstrumented(bool isInstrumented) { m_IsInstrumented = isInstrumented; }
+
+    // Where the cue ball is placed for the break.
+    static glm::vec2 getCueSpot();
+
+    static const size_t POCKET_COUNT {6};
+    static std::array<glm::vec2, POCKET_COUNT> getPocketPositions();
+
+public:
+    static constexpr float TIME_STEP {0.001f};
+
+    static constexpr float BALL_MASS {15.0f};
+    static constexpr float FRICTION_COEFFICIENT {0.04f};
+    static constexpr float STATIC_FRICTION_THRESHOLD {0.002f};
+
+    // Total kinetic energy below which the table counts as being at rest,
+    // i.e. less than that of a single ball moving at the static friction
+    // threshold speed.
+    static constexpr float REST_ENERGY_THRESHOLD {
+        0.5f * BALL_MASS * STATIC_FRICTION_THRESHOLD * STATIC_FRICTION_THRESHOLD
+    };
+
+    static const uint16_t BUMPER_WIDTH {50};
+    static const uint16_t FELT_LEFT_COORD {BUMPER_WIDTH * 2};
+    static const uint16_t FELT_TOP_COORD {100};
+    static const uint16_t FELT_WIDTH {800};
+    static const uint16_t FELT_HEIGHT {400};
+
+    static const uint16_t BALL_DIAMETER {35};
+
+    // A ball drops once its center is this close to the center of a pocket.
+    static constexpr float POCKET_RADIUS {0.9f * BALL_DIAMETER};
+
+    static const size_t EVENT_BUFFER_CAPACITY {1024};
+
+    // The most pairs of balls that can be touching at once. Equal discs in
+    // a plane touch in at most 3n - 6 pairs, which is 42 for a full rack
+    // (give or take balls that have sunk a little way into each other).
+    static const size_t MAX_CONTACT_PAIRS {3 * BALL_TYPE_COUNT - 6};
+
+    // The most forces in one step: friction for every ball, a shot, and
+    // four for every pair in contact, since the pair loop visits (i, j)
+    // and (j, i) and pushes both sides each time.
+    static const size_t INITIAL_FORCE_CAPACITY {BALL_TYPE_COUNT + 1 + 4 * MAX_CONTACT_PAIRS};
+
+private:
+    // Rewinding needs to put back state which is otherwise internal.
+    template<typename State> friend class RewindBuffer;
+
+    void simulatePhysics();
+    bool checkPockets(size_t ballIndex);
+
+    std::vector<Ball> m_Balls;
+    std::vector<BallForce> m_BallForces;
+    EventBuffer m_Events;
+
+    uint64_t m_StepCount;
+    float m_PendingTime;  // Simulated time not yet covered by a whole step
+    TableStats m_Stats;
+    bool m_IsInstrumented;
+
+};
+
+
+#endif
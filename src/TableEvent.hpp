@@ -0,0 +1,109 @@
+
+#ifndef TABLE_EVENT_HPP
+#define TABLE_EVENT_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+
+enum class TableEventType : uint8_t
+{
+    BallContact,
+    Cushion,
+    Pocket,
+};
+
+enum class Cushion : uint8_t
+{
+    Left,
+    Right,
+    Top,
+    Bottom,
+};
+
+
+// Something that happened on the table during a step, for the benefit of
+// scoring, sound, replays and so on.
+struct TableEvent
+{
+    TableEventType m_Type;
+    uint32_t m_BallIndex;
+    uint32_t m_Other;  // The other ball's index, a Cushion or a pocket index
+    glm::vec2 m_Position;  // Point of contact
+    float m_Time;  // Simulated time, in seconds
+    float m_RelativeSpeed;
+};
+
+
+// A fixed-capacity list of events. All of the storage is allocated up
+// front, so the physics loop can append to it without allocating or
+// calling out to anybody. Events which don't fit are counted and dropped.
+class EventBuffer
+{
+public:
+    explicit EventBuffer(size_t capacity) :
+        m_Events {},
+        m_DroppedCount {0}
+    {
+        m_Events.reserve(capacity);
+    }
+
+    // Copying a vector doesn't preserve its capacity, so do that by hand.
+    EventBuffer(const EventBuffer& other) :
+        m_Events {},
+        m_DroppedCount {other.m_DroppedCount}
+    {
+        m_Events.reserve(other.capacity());
+        m_Events.assign(other.begin(), other.end());
+    }
+
+    EventBuffer& operator=(const EventBuffer& other)
+    {
+        if (this != &other)
+        {
+            m_Events.reserve(other.capacity());
+            m_Events.assign(other.begin(), other.end());
+            m_DroppedCount = other.m_DroppedCount;
+        }
+        return *this;
+    }
+
+    bool push(const TableEvent& event)
+    {
+        if (m_Events.size() == m_Events.capacity())
+        {
+            ++m_DroppedCount;
+            return false;
+        }
+        m_Events.push_back(event);
+        return true;
+    }
+
+    void clear()
+    {
+        m_Events.clear();
+        m_DroppedCount = 0;
+    }
+
+    size_t size() const { return m_Events.size(); }
+    bool empty() const { return m_Events.empty(); }
+    size_t capacity() const { return m_Events.capacity(); }
+
+    // Number of events that were dropped since the last clear().
+    size_t getDroppedCount() const { return m_DroppedCount; }
+
+    const TableEvent& operator[](size_t i) const { return m_Events[i]; }
+    std::vector<TableEvent>::const_iterator begin() const { return m_Events.begin(); }
+    std::vector<TableEvent>::const_iterator end() const { return m_Events.end(); }
+
+private:
+    std::vector<TableEvent> m_Events;
+    size_t m_DroppedCount;
+
+};
+
+
+#endif
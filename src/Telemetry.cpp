@@ -0,0 +1,224 @@
+
+#include <fcntl.h>     // for O_* constants
+#include <sys/mman.h>  // for shm_open, mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for ftruncate, getpid
+#include <algorithm>   // for std::max
+#include <chrono>
+#include <cstring>     // for std::memcpy
+#include <new>
+
+#include "Telemetry.hpp"
+#include "Table.hpp"
+#include "debug.hpp"
+
+
+TelemetryBlock* Telemetry::s_pBlock {nullptr};
+
+// Only touched by the main thread
+typedef std::chrono::steady_clock Clock;
+static TelemetrySample s_Sample {};
+static Clock::time_point s_LastPublish {};
+static Clock::time_point s_WindowStart {};
+static uint64_t s_WindowStartStep {0};
+static uint64_t s_WindowStartFrame {0};
+static uint64_t s_WindowMaxFrame {0};
+
+// Rates and frame times are worked out over windows about this long.
+static const std::chrono::milliseconds WINDOW_LENGTH {500};
+
+// A reader gives up on a sample after this many torn copies in a row.
+static const int MAX_READ_ATTEMPTS {100};
+
+
+bool Telemetry::start()
+{
+    const int fd {shm_open(TELEMETRY_SHM_NAME, O_CREAT | O_RDWR, 0644)};
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(TelemetryBlock)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* pMemory {mmap(nullptr, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+    close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The magic number goes in last, so that a reader never takes a half
+    // set up block for a real one.
+    TelemetryBlock* pBlock {new (pMemory) TelemetryBlock {}};
+    pBlock->m_Version = TelemetryBlock::VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    pBlock->m_Magic = TelemetryBlock::MAGIC;
+
+    s_Sample = TelemetrySample {};
+    s_Sample.m_ProcessId = static_cast<uint64_t>(getpid());
+    s_LastPublish = Clock::now();
+    s_WindowStart = s_LastPublish;
+    s_pBlock = pBlock;
+
+    LOG("Publishing telemetry to %s \n", TELEMETRY_SHM_NAME);
+    return true;
+}
+
+void Telemetry::stop()
+{
+    if ( ! s_pBlock)
+    {
+        return;
+    }
+
+    munmap(s_pBlock, sizeof(TelemetryBlock));
+    shm_unlink(TELEMETRY_SHM_NAME);
+    s_pBlock = nullptr;
+}
+
+
+void Telemetry::publish(const TableStats& stats, uint64_t stepCount)
+{
+    if ( ! s_pBlock)
+    {
+        return;
+    }
+
+    const Clock::time_point now {Clock::now()};
+    const auto frameTime = std::chrono::duration_cast<std::chrono::microseconds>(now - s_LastPublish);
+    s_LastPublish = now;
+
+    TelemetrySample& sample = s_Sample;
+    sample.m_PublishedAt = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count());
+    sample.m_StepCount = stepCount;
+    ++sample.m_FrameCount;
+    sample.m_PairTests = stats.m_PairTests;
+    sample.m_Contacts = stats.m_Contacts;
+    sample.m_CushionHits = stats.m_CushionHits;
+    sample.m_MovingBalls = stats.m_MovingBalls;
+    sample.m_ForceCount = stats.m_ForceCount;
+    sample.m_LastFrameMicroseconds = static_cast<uint64_t>(frameTime.count());
+    s_WindowMaxFrame = std::max(s_WindowMaxFrame, sample.m_LastFrameMicroseconds);
+
+    const auto windowLength = std::chrono::duration_cast<std::chrono::microseconds>(now - s_WindowStart);
+    if (windowLength >= WINDOW_LENGTH)
+    {
+        const uint64_t microseconds {static_cast<uint64_t>(windowLength.count())};
+        const uint64_t frames {sample.m_FrameCount - s_WindowStartFrame};
+        sample.m_StepsPerSecond = (stepCount - s_WindowStartStep) * 1000000 / microseconds;
+        sample.m_FramesPerSecond = frames * 1000000 / microseconds;
+        sample.m_MeanFrameMicroseconds = microseconds / frames;
+        sample.m_MaxFrameMicroseconds = s_WindowMaxFrame;
+
+        s_WindowStart = now;
+        s_WindowStartStep = stepCount;
+        s_WindowStartFrame = sample.m_FrameCount;
+        s_WindowMaxFrame = 0;
+    }
+
+    uint64_t words[TELEMETRY_WORD_COUNT];
+    std::memcpy(words, &sample, sizeof(words));
+
+    const uint64_t sequence {s_pBlock->m_Sequence.load(std::memory_order_relaxed)};
+    s_pBlock->m_Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < TELEMETRY_WORD_COUNT; ++i)
+    {
+        s_pBlock->m_Words[i].store(words[i], std::memory_order_relaxed);
+    }
+    s_pBlock->m_Sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+TelemetryReader::TelemetryReader() :
+    m_pBlock {nullptr}
+{
+}
+
+TelemetryReader::~TelemetryReader()
+{
+    close();
+}
+
+bool TelemetryReader::open()
+{
+    close();
+
+    const int fd {shm_open(TELEMETRY_SHM_NAME, O_RDONLY, 0)};
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(TelemetryBlock))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* pMemory {mmap(nullptr, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0)};
+    ::close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const TelemetryBlock* pBlock {static_cast<const TelemetryBlock*>(pMemory)};
+    const bool isValid {pBlock->m_Magic == TelemetryBlock::MAGIC};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if ( ! isValid || pBlock->m_Version != TelemetryBlock::VERSION)
+    {
+        munmap(pMemory, sizeof(TelemetryBlock));
+        return false;
+    }
+
+    m_pBlock = pBlock;
+    return true;
+}
+
+void TelemetryReader::close()
+{
+    if (m_pBlock)
+    {
+        munmap(const_cast<void*>(static_cast<const void*>(m_pBlock)), sizeof(TelemetryBlock));
+        m_pBlock = nullptr;
+    }
+}
+
+bool TelemetryReader::read(TelemetrySample& sample) const
+{
+    if ( ! m_pBlock)
+    {
+        return false;
+    }
+
+    uint64_t words[TELEMETRY_WORD_COUNT];
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+    {
+        const uint64_t before {m_pBlock->m_Sequence.load(std::memory_order_acquire)};
+        if (before % 2 != 0)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < TELEMETRY_WORD_COUNT; ++i)
+        {
+            words[i] = m_pBlock->m_Words[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_pBlock->m_Sequence.load(std::memory_order_relaxed) == before)
+        {
+            std::memcpy(&sample, words, sizeof(words));
+            return true;
+        }
+    }
+    return false;
+}
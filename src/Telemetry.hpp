@@ -0,0 +1,114 @@
+
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+
+struct TableStats;
+
+
+// What the game publishes, about once a frame. Every field is a uint64_t,
+// so that the layout is the same for every reader.
+struct TelemetrySample
+{
+    uint64_t m_ProcessId;
+    uint64_t m_PublishedAt;  // Microseconds since the Unix epoch
+
+    // Totals since the game started
+    uint64_t m_StepCount;
+    uint64_t m_FrameCount;
+    uint64_t m_PairTests;
+    uint64_t m_Contacts;
+    uint64_t m_CushionHits;
+
+    // As of the latest step
+    uint64_t m_MovingBalls;
+    uint64_t m_ForceCount;
+
+    // Over the last half second or so
+    uint64_t m_StepsPerSecond;
+    uint64_t m_FramesPerSecond;
+    uint64_t m_MeanFrameMicroseconds;
+    uint64_t m_MaxFrameMicroseconds;
+
+    // The latest frame, from the end of the one before
+    uint64_t m_LastFrameMicroseconds;
+};
+
+static const size_t TELEMETRY_WORD_COUNT {sizeof(TelemetrySample) / sizeof(uint64_t)};
+
+
+// The layout of the shared memory segment.
+//
+// The sample is guarded by a sequence lock: the sequence number is odd
+// while the game is part way through writing a sample, and goes up by two
+// for each one. A reader copies the sample out, and keeps it if the
+// sequence number was even and the same before and after. The game never
+// waits for readers, and readers never write, so any number of them can
+// watch without the game noticing.
+struct TelemetryBlock
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    std::atomic<uint64_t> m_Sequence;
+    std::array<std::atomic<uint64_t>, TELEMETRY_WORD_COUNT> m_Words;
+
+    static const uint32_t MAGIC {0x42494c4c};  // "BILL"
+    static const uint32_t VERSION {1};
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory needs lock-free 64-bit atomics");
+
+// Where the game publishes, under /dev/shm on Linux.
+static const char* const TELEMETRY_SHM_NAME {"/billiards-telemetry"};
+
+
+// The game's side: publishes the table's counters and the frame times.
+class Telemetry
+{
+public:
+    // Create the shared memory segment. Returns false if it couldn't be.
+    static bool start();
+    static void stop();
+
+    static bool isEnabled() { return s_pBlock != nullptr; }
+
+    // Main thread only, once a frame. Does nothing unless started.
+    static void publish(const TableStats& stats, uint64_t stepCount);
+
+private:
+    static TelemetryBlock* s_pBlock;
+
+};
+
+
+// A reader's side, for billiards-top and the like.
+class TelemetryReader
+{
+public:
+    TelemetryReader();
+    ~TelemetryReader();
+
+    // Returns false if no game is publishing, or it's an incompatible one.
+    bool open();
+    void close();
+
+    // Copy out the latest sample. Returns false if the game kept writing
+    // over it for every one of several attempts.
+    bool read(TelemetrySample& sample) const;
+
+private:
+    const TelemetryBlock* m_pBlock;
+
+private:
+    TelemetryReader(const TelemetryReader&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+};
+
+
+#endif
@@ -0,0 +1,624 @@
+
+#include <algorithm>  // for std::min, std::max, std::sort
+#include <cmath>      // for std::lround
+#include <cstdio>     // for std::snprintf
+#include <iostream>
+
+#include "Tournament.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
+#include "Telemetry.hpp"
+#include "debug.hpp"
+
+
+Tournament::Tournament(const GameOptions& options) :
+    m_Options {options},
+    m_IsRunning {false},
+    m_FramePacer {},
+    m_pWindow {nullptr},
+    m_pRenderer {nullptr},
+    m_Tables {},
+    m_Workers {},
+    m_IsSimulating {false},
+    m_StartTicks {0},
+    m_Columns {1},
+    m_TileScale {1.0f},
+    m_TileWidth {Game::WINDOW_WIDTH},
+    m_TileHeight {Game::WINDOW_HEIGHT},
+    m_TileRects {},
+    m_Sprites {},
+    m_pBackgroundTexture {nullptr},
+    m_RenderQueue {},
+    m_RenderBackend {}
+{
+    // Each table gets its own seed, so they don't all play the same game.
+    for (size_t i = 0; i < m_Options.m_TournamentSize; ++i)
+    {
+        m_Tables.emplace_back(static_cast<uint32_t>(i));
+    }
+
+    m_TileRects.reserve(m_Tables.size());
+}
+
+Tournament::~Tournament()
+{
+    teardown();
+
+    if (m_pWindow)
+    {
+        SDL_DestroyRenderer(m_pRenderer);
+        SDL_DestroyWindow(m_pWindow);
+        SDL_Quit();
+    }
+}
+
+
+bool Tournament::setupSDL()
+{
+    LOG("Setting up SDL for a tournament of %zu tables \n", m_Tables.size());
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        return false;
+    }
+
+    m_pWindow = SDL_CreateWindow(
+        "Billiards Tournament",
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        Game::WINDOW_WIDTH,
+        Game::WINDOW_HEIGHT,
+        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
+    );
+    if ( ! m_pWindow)
+    {
+        return false;
+    }
+
+    const bool wantVsync {m_Options.m_FrameRate <= 0.0};
+    m_pRenderer = SDL_CreateRenderer(
+        m_pWindow,
+        -1,
+        SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | (wantVsync ? SDL_RENDERER_PRESENTVSYNC : 0)
+    );
+    if ( ! m_pRenderer)
+    {
+        return false;
+    }
+
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(m_pRenderer, &info) == 0)
+    {
+        m_FramePacer.setVsync((info.flags & SDL_RENDERER_PRESENTVSYNC) != 0);
+    }
+
+    if (wantVsync)
+    {
+        SDL_DisplayMode mode;
+        const bool knowsRefreshRate {SDL_GetWindowDisplayMode(m_pWindow, &mode) == 0 && mode.refresh_rate > 0};
+        m_FramePacer.setTargetFrameRate(knowsRefreshRate ? mode.refresh_rate : 60.0);
+    }
+    else
+    {
+        m_FramePacer.setTargetFrameRate(m_Options.m_FrameRate);
+    }
+
+    return true;
+}
+
+bool Tournament::start()
+{
+    if ( ! init(m_pRenderer))
+    {
+        return false;
+    }
+
+    std::cout << "Playing " << m_Tables.size() << " tables on " << m_Workers.size() << " threads" << std::endl;
+
+    m_IsRunning = true;
+    while (m_IsRunning)
+    {
+        TRACE_SCOPE("frame", "frame");
+        m_FramePacer.beginFrame();
+
+        handleInput();
+        if (m_Sprites.update(m_pRenderer))
+        {
+            createBackgroundTexture();
+        }
+
+        renderFrame();
+        {
+            PROFILE_SCOPE(Present);
+            SDL_RenderPresent(m_pRenderer);
+        }
+        Profiler::collect();
+        Tracer::writeIfRequested();
+        AllocationTracker::endFrame();
+        publishTelemetry();
+
+        m_FramePacer.endFrame(true);
+    }
+
+    teardown();
+    printFrameStats();
+    return true;
+}
+
+bool Tournament::runBenchmark()
+{
+    // The size of a 1080p display, with the whole frame drawn on the CPU
+    const int WIDTH {1920};
+    const int HEIGHT {1080};
+    const double SECONDS {2.0};
+    const size_t SIZES[] {4, 16, 64};
+
+    std::cout << "Tables, frames, mean (ms), 99th percentile (ms), mean per table (ms)" << std::endl;
+    for (const size_t size : SIZES)
+    {
+        SDL_Surface* pSurface {SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888)};
+        SDL_Renderer* pRenderer {pSurface ? SDL_CreateSoftwareRenderer(pSurface) : nullptr};
+        if ( ! pRenderer)
+        {
+            std::cerr << "Could not create a software renderer: " << SDL_GetError() << std::endl;
+            SDL_FreeSurface(pSurface);
+            return false;
+        }
+
+        GameOptions options;
+        options.m_TournamentSize = size;
+        std::vector<double> frameTimes;
+        {
+            Tournament tournament {options};
+            if ( ! tournament.init(pRenderer))
+            {
+                std::cerr << "Could not set up " << size << " tables: " << SDL_GetError() << std::endl;
+                SDL_DestroyRenderer(pRenderer);
+                SDL_FreeSurface(pSurface);
+                return false;
+            }
+
+            // As fast as it'll go, with the workers stepping the tables
+            // alongside.
+            const double frequency {static_cast<double>(SDL_GetPerformanceFrequency())};
+            const uint64_t start {SDL_GetPerformanceCounter()};
+            uint64_t frameStart {start};
+            while ((frameStart - start) / frequency < SECONDS)
+            {
+                tournament.renderFrame();
+                SDL_RenderPresent(pRenderer);
+
+                const uint64_t frameEnd {SDL_GetPerformanceCounter()};
+                frameTimes.push_back((frameEnd - frameStart) * 1000.0 / frequency);
+                frameStart = frameEnd;
+            }
+            tournament.teardown();
+        }
+
+        SDL_DestroyRenderer(pRenderer);
+        SDL_FreeSurface(pSurface);
+
+        double total {0.0};
+        for (const double time : frameTimes)
+        {
+            total += time;
+        }
+        const double mean {total / frameTimes.size()};
+        std::sort(frameTimes.begin(), frameTimes.end());
+        const double p99 {frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100)]};
+
+        std::cout
+            << size << ", " << frameTimes.size() << ", "
+            << mean << ", " << p99 << ", " << mean / size
+            << std::endl;
+    }
+    return true;
+}
+
+
+bool Tournament::init(SDL_Renderer* pRenderer)
+{
+    m_pRenderer = pRenderer;
+    if (SDL_SetRenderDrawBlendMode(m_pRenderer, SDL_BLENDMODE_BLEND) != 0)
+    {
+        return false;
+    }
+
+    if ( ! layout())
+    {
+        return false;
+    }
+
+    // Give the render thread something to draw before the workers get
+    // going. Nothing else is touching the tables yet.
+    for (auto& table : m_Tables)
+    {
+        table.m_Player.rack();
+
+        TournamentSnapshot& snapshot = table.m_Snapshots.getWriteBuffer();
+        snapshot.m_Balls = table.m_Player.getTable().getBalls();
+        snapshot.m_ShotPower = table.m_Player.getShotPower();
+        table.m_Snapshots.publish();
+    }
+
+    return startWorkers();
+}
+
+void Tournament::teardown()
+{
+    stopWorkers();
+
+    SDL_DestroyTexture(m_pBackgroundTexture);
+    m_pBackgroundTexture = nullptr;
+    m_Sprites.clear();
+}
+
+
+bool Tournament::startWorkers()
+{
+    // Leave a CPU for the render thread, but there's no point in more
+    // workers than tables.
+    const int cpuCount {SDL_GetCPUCount()};
+    const size_t workerCount {std::max<size_t>(1, std::min<size_t>(m_Tables.size(), cpuCount > 1 ? cpuCount - 1 : 1))};
+
+    // Every worker has to be in the vector before any of them starts, so
+    // that none of them moves while its thread is looking at it.
+    m_Workers.clear();
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        m_Workers.push_back(Worker {this, i, nullptr});
+    }
+
+    m_StartTicks = SDL_GetPerformanceCounter();
+    m_IsSimulating.store(true, std::memory_order_release);
+    for (auto& worker : m_Workers)
+    {
+        worker.m_pThread = SDL_CreateThread(workerThread, "tournament", &worker);
+        if ( ! worker.m_pThread)
+        {
+            stopWorkers();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Tournament::stopWorkers()
+{
+    m_IsSimulating.store(false, std::memory_order_release);
+    for (auto& worker : m_Workers)
+    {
+        if (worker.m_pThread)
+        {
+            SDL_WaitThread(worker.m_pThread, nullptr);
+        }
+    }
+    m_Workers.clear();
+}
+
+int Tournament::workerThread(void* pUserData)
+{
+    const Worker* pWorker {static_cast<const Worker*>(pUserData)};
+    pWorker->m_pTournament->runWorker(pWorker->m_Index);
+    return 0;
+}
+
+void Tournament::runWorker(size_t worker)
+{
+    LOG("Tournament worker %zu started \n", worker);
+    char name[32];
+    std::snprintf(name, sizeof(name), "worker %zu", worker);
+    Tracer::setThreadName(name);
+
+    const uint64_t frequency {SDL_GetPerformanceFrequency()};
+    const size_t stride {m_Workers.size()};
+    while (m_IsSimulating.load(std::memory_order_acquire))
+    {
+        // Every table is kept at the step it would be at by now, the same
+        // as in the game.
+        const uint64_t elapsed {SDL_GetPerformanceCounter() - m_StartTicks};
+        const uint64_t targetStep {elapsed * Game::STEPS_PER_SECOND / frequency};
+
+        for (size_t i = worker; i < m_Tables.size(); i += stride)
+        {
+            TournamentTable& table = m_Tables[i];
+            if (table.m_StepCount >= targetStep)
+            {
+                continue;
+            }
+
+            TRACE_SCOPE_ARG("simulate_table", "worker", "table", i);
+            ALLOCATION_SCOPE(Simulation);
+            uint32_t steps {0};
+            while (table.m_StepCount < targetStep && steps < MAX_CATCH_UP_STEPS)
+            {
+                table.m_Player.step();
+                ++table.m_StepCount;
+                ++steps;
+            }
+            table.m_StepCount = targetStep;
+
+            TournamentSnapshot& snapshot = table.m_Snapshots.getWriteBuffer();
+            snapshot.m_Balls = table.m_Player.getTable().getBalls();
+            snapshot.m_StepCount = table.m_Player.getTable().getStepCount();
+            snapshot.m_TableStats = table.m_Player.getTable().getStats();
+            snapshot.m_ShotPower = table.m_Player.getShotPower();
+            table.m_Snapshots.publish();
+        }
+
+        SDL_Delay(1);
+    }
+
+    LOG("Tournament worker %zu stopped \n", worker);
+}
+
+
+void Tournament::handleInput()
+{
+    PROFILE_SCOPE(Input);
+    ALLOCATION_SCOPE(Input);
+
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+            case SDL_QUIT:
+            {
+                m_IsRunning = false;
+                break;
+            }
+
+            case SDL_KEYDOWN:
+            {
+                if (event.key.keysym.sym == SDLK_ESCAPE || event.key.keysym.sym == SDLK_q)
+                {
+                    m_IsRunning = false;
+                }
+                break;
+            }
+
+            case SDL_WINDOWEVENT:
+            {
+                if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                {
+                    layout();
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool Tournament::layout()
+{
+    int outputWidth;
+    int outputHeight;
+    if (SDL_GetRendererOutputSize(m_pRenderer, &outputWidth, &outputHeight) != 0 || outputWidth <= 0 || outputHeight <= 0)
+    {
+        // Minimised, probably. Keep the layout we had.
+        return m_pBackgroundTexture != nullptr;
+    }
+
+    // Try every number of columns, and keep whichever lets the tiles be
+    // biggest.
+    const int tableCount {static_cast<int>(m_Tables.size())};
+    m_TileScale = 0.0f;
+    for (int columns = 1; columns <= tableCount; ++columns)
+    {
+        const int rows {(tableCount + columns - 1) / columns};
+        const float scale {std::min(
+            static_cast<float>(outputWidth - (columns - 1) * TILE_GAP) / (columns * Game::WINDOW_WIDTH),
+            static_cast<float>(outputHeight - (rows - 1) * TILE_GAP) / (rows * Game::WINDOW_HEIGHT)
+        )};
+        if (scale > m_TileScale)
+        {
+            m_TileScale = scale;
+            m_Columns = columns;
+        }
+    }
+    m_TileScale = std::max(m_TileScale, 1.0f / Game::WINDOW_HEIGHT);
+    m_TileWidth = std::max(1, static_cast<int>(Game::WINDOW_WIDTH * m_TileScale));
+    m_TileHeight = std::max(1, static_cast<int>(Game::WINDOW_HEIGHT * m_TileScale));
+
+    // Centre the whole grid in the window.
+    const int rows {(tableCount + m_Columns - 1) / m_Columns};
+    const int gridWidth {m_Columns * (m_TileWidth + TILE_GAP) - TILE_GAP};
+    const int gridHeight {rows * (m_TileHeight + TILE_GAP) - TILE_GAP};
+    const int left {(outputWidth - gridWidth) / 2};
+    const int top {(outputHeight - gridHeight) / 2};
+
+    m_TileRects.clear();
+    for (int i = 0; i < tableCount; ++i)
+    {
+        m_TileRects.push_back(SDL_Rect {
+            left + (i % m_Columns) * (m_TileWidth + TILE_GAP),
+            top + (i / m_Columns) * (m_TileHeight + TILE_GAP),
+            m_TileWidth,
+            m_TileHeight
+        });
+    }
+
+    LOG("Tournament tiles are %dx%d pixels, %d across \n", m_TileWidth, m_TileHeight, m_Columns);
+
+    // The first sheet has to be there before anything can be drawn; after
+    // that, new sizes are built in the background.
+    const int spriteSize {Game::getSpriteSize(m_TileScale)};
+    if ( ! m_Sprites.getCurrent().m_pTexture)
+    {
+        if ( ! m_Sprites.load(m_pRenderer, spriteSize))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        m_Sprites.request(spriteSize);
+    }
+
+    return createBackgroundTexture();
+}
+
+bool Tournament::createBackgroundTexture()
+{
+    SDL_DestroyTexture(m_pBackgroundTexture);
+    m_pBackgroundTexture = SDL_CreateTexture(
+        m_pRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        m_TileWidth,
+        m_TileHeight
+    );
+    if ( ! m_pBackgroundTexture)
+    {
+        return false;
+    }
+    SDL_SetTextureBlendMode(m_pBackgroundTexture, SDL_BLENDMODE_NONE);
+
+    if (SDL_SetRenderTarget(m_pRenderer, m_pBackgroundTexture) != 0)
+    {
+        return false;
+    }
+    SDL_RenderSetScale(m_pRenderer, m_TileScale, m_TileScale);
+
+    for (const auto& background : Game::getBackgroundRects())
+    {
+        const SDL_Color& color = background.m_Color;
+        SDL_SetRenderDrawColor(m_pRenderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(m_pRenderer, &background.m_Rect);
+    }
+
+    const SpriteSheet& sprites = m_Sprites.getCurrent();
+    for (const auto& pocket : Table::getPocketPositions())
+    {
+        const SDL_Rect rect {Game::getPocketRect(pocket)};
+        SDL_RenderCopy(m_pRenderer, sprites.m_pTexture, &sprites.m_PocketSpriteRect, &rect);
+    }
+
+    SDL_RenderSetScale(m_pRenderer, 1.0f, 1.0f);
+    return SDL_SetRenderTarget(m_pRenderer, nullptr) == 0;
+}
+
+
+void Tournament::renderFrame()
+{
+    PROFILE_SCOPE(Render);
+    ALLOCATION_SCOPE(Render);
+
+    for (auto& table : m_Tables)
+    {
+        table.m_Snapshots.update();
+    }
+
+    const SDL_Color clearColor {Game::getBackgroundRects()[0].m_Color};
+    SDL_SetRenderDrawColor(m_pRenderer, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+    SDL_RenderClear(m_pRenderer);
+
+    // Every table's background and power bar, then every ball on every
+    // table. The queue turns each of those into one call.
+    m_RenderQueue.clear();
+    const SDL_Rect wholeTile {0, 0, m_TileWidth, m_TileHeight};
+    const SpriteSheet& sprites = m_Sprites.getCurrent();
+    const float size {Table::BALL_DIAMETER * m_TileScale};
+    for (size_t i = 0; i < m_Tables.size(); ++i)
+    {
+        const SDL_Rect& tile = m_TileRects[i];
+        const TournamentSnapshot& snapshot = m_Tables[i].m_Snapshots.getReadBuffer();
+
+        m_RenderQueue.drawSprite(
+            RenderLayer::Background,
+            RenderTexture::Background,
+            wholeTile,
+            static_cast<float>(tile.x),
+            static_cast<float>(tile.y),
+            static_cast<float>(tile.w),
+            static_cast<float>(tile.h),
+            RenderBlend::None
+        );
+
+        const SDL_Rect bar {Game::getPowerBarFillRect(Game::getPowerBarFillHeight(snapshot.m_ShotPower))};
+        const int left {static_cast<int>(std::lround(bar.x * m_TileScale))};
+        const int top {static_cast<int>(std::lround(bar.y * m_TileScale))};
+        m_RenderQueue.fillRect(
+            RenderLayer::Background,
+            SDL_Rect {
+                tile.x + left,
+                tile.y + top,
+                static_cast<int>(std::lround((bar.x + bar.w) * m_TileScale)) - left,
+                static_cast<int>(std::lround((bar.y + bar.h) * m_TileScale)) - top
+            },
+            Game::POWER_BAR_FILL_COLOR
+        );
+
+        for (const auto& ball : snapshot.m_Balls)
+        {
+            if (ball.m_IsPocketed)
+            {
+                continue;
+            }
+
+            m_RenderQueue.drawSprite(
+                RenderLayer::Balls,
+                RenderTexture::Sprites,
+                sprites.m_BallSpriteRects[static_cast<size_t>(ball.m_Type)],
+                tile.x + (ball.position.x - Table::BALL_DIAMETER / 2.0f) * m_TileScale,
+                tile.y + (ball.position.y - Table::BALL_DIAMETER / 2.0f) * m_TileScale,
+                size,
+                size
+            );
+        }
+    }
+    m_RenderQueue.sort();
+
+    m_RenderBackend.setRenderer(m_pRenderer);
+    m_RenderBackend.setTexture(RenderTexture::Background, m_pBackgroundTexture);
+    m_RenderBackend.setTexture(RenderTexture::Sprites, sprites.m_pTexture);
+    m_RenderQueue.submit(m_RenderBackend);
+}
+
+
+void Tournament::publishTelemetry()
+{
+    if ( ! Telemetry::isEnabled())
+    {
+        return;
+    }
+
+    // All the tables together, as of what was just drawn.
+    TableStats total {};
+    uint64_t stepCount {0};
+    for (const auto& table : m_Tables)
+    {
+        const TournamentSnapshot& snapshot = table.m_Snapshots.getReadBuffer();
+        total.m_PairTests += snapshot.m_TableStats.m_PairTests;
+        total.m_Contacts += snapshot.m_TableStats.m_Contacts;
+        total.m_CushionHits += snapshot.m_TableStats.m_CushionHits;
+        total.m_MovingBalls += snapshot.m_TableStats.m_MovingBalls;
+        total.m_ForceCount += snapshot.m_TableStats.m_ForceCount;
+        stepCount += snapshot.m_StepCount;
+    }
+    Telemetry::publish(total, stepCount);
+}
+
+void Tournament::printFrameStats()
+{
+    const FrameStats stats = m_FramePacer.getStats();
+    std::cout
+        << "Frames: " << stats.m_FrameCount
+        << " for " << m_Tables.size() << " tables"
+        << " at a target of " << m_FramePacer.getTargetFrameRate() << " per second, "
+        << stats.m_MissedCount << " late \n"
+        << "Frame time (ms): "
+        << "min " << stats.m_MinFrameTime
+        << ", mean " << stats.m_MeanFrameTime
+        << ", 99th percentile " << stats.m_P99FrameTime
+        << ", max " << stats.m_MaxFrameTime
+        << ", mean work " << stats.m_MeanWorkTime
+        << std::endl;
+
+    if (m_Options.m_pFrameStatsPath && ! m_FramePacer.writeHistogram(m_Options.m_pFrameStatsPath))
+    {
+        std::cerr << "Could not write frame stats to " << m_Options.m_pFrameStatsPath << std::endl;
+    }
+}
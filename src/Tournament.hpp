@@ -0,0 +1,144 @@
+
+#ifndef TOURNAMENT_HPP
+#define TOURNAMENT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "Game.hpp"
+#include "AutoPlayer.hpp"
+#include "TripleBuffer.hpp"
+#include "FramePacer.hpp"
+#include "SpriteCache.hpp"
+#include "RenderQueue.hpp"
+
+
+// What a table looks like at one moment, as handed from its worker to the
+// render thread.
+struct TournamentSnapshot
+{
+    std::vector<Ball> m_Balls;
+    uint64_t m_StepCount;  // Steps actually simulated
+    TableStats m_TableStats;
+    float m_ShotPower;
+
+    TournamentSnapshot() :
+        m_Balls {},
+        m_StepCount {0},
+        m_TableStats {},
+        m_ShotPower {0.0f}
+    {
+        m_Balls.reserve(BALL_TYPE_COUNT);
+    }
+};
+
+struct TournamentTable
+{
+    AutoPlayer m_Player;
+    uint64_t m_StepCount;  // Only touched by the table's worker
+    TripleBuffer<TournamentSnapshot> m_Snapshots;
+
+    explicit TournamentTable(uint32_t seed) :
+        m_Player {seed},
+        m_StepCount {0},
+        m_Snapshots {}
+    {
+    }
+};
+
+
+// Lots of games of 8-ball playing themselves at once, tiled in one window.
+//
+// The tables are shared out between a few worker threads (one fewer than
+// there are CPUs, so the render thread has one to itself), which step them
+// at the game's usual rate and publish each one through a triple buffer.
+// Every table is drawn from the same sprite sheet and the same cached
+// background, so however many there are, a frame is only three batches:
+// the backgrounds, the power bars and the balls.
+class Tournament
+{
+public:
+    explicit Tournament(const GameOptions& options);
+    ~Tournament();
+
+    bool setupSDL();
+    bool start();
+
+    // Time frames for a few sizes of tournament, drawing with a software
+    // renderer so the numbers don't depend on the GPU, and print the
+    // results.
+    static bool runBenchmark();
+
+private:
+    bool init(SDL_Renderer* pRenderer);
+    void teardown();
+
+    bool startWorkers();
+    void stopWorkers();
+    static int workerThread(void* pUserData);
+    void runWorker(size_t worker);
+
+    void handleInput();
+    bool layout();
+    bool createBackgroundTexture();
+
+    void renderFrame();
+
+    void publishTelemetry();
+    void printFrameStats();
+
+private:
+    GameOptions m_Options;
+    bool m_IsRunning;
+    FramePacer m_FramePacer;
+
+    SDL_Window* m_pWindow;
+    SDL_Renderer* m_pRenderer;
+
+    // Never resized once the workers are running, so the tables never move.
+    std::deque<TournamentTable> m_Tables;
+
+    struct Worker
+    {
+        Tournament* m_pTournament;
+        size_t m_Index;
+        SDL_Thread* m_pThread;
+    };
+    std::vector<Worker> m_Workers;
+    std::atomic<bool> m_IsSimulating;
+    uint64_t m_StartTicks;
+
+    // The tables are laid out in a grid of equal tiles, each a scaled
+    // down copy of the game's view.
+    int m_Columns;
+    float m_TileScale;
+    int m_TileWidth;
+    int m_TileHeight;
+    std::vector<SDL_Rect> m_TileRects;
+
+    SpriteCache m_Sprites;
+    SDL_Texture* m_pBackgroundTexture;  // One tile's worth, shared by all of them
+
+    RenderQueue m_RenderQueue;
+    SdlRenderBackend m_RenderBackend;
+
+    // Gap between tiles, in pixels
+    static const int TILE_GAP {4};
+
+    // A worker that falls further behind than this skips ahead rather
+    // than trying to catch all of it up at once.
+    static const uint32_t MAX_CATCH_UP_STEPS {Game::STEPS_PER_SECOND / 10};
+
+private:
+    Tournament(const Tournament&) = delete;
+    Tournament& operator=(const Tournament&) = delete;
+
+};
+
+
+#endif
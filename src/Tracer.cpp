@@ -0,0 +1,243 @@
+
+#include <stdlib.h>
+#include <algorithm>  // for std::min
+#include <array>
+#include <csignal>
+#include <cstring>    // for std::strncpy
+#include <fstream>
+#include <iostream>
+
+#include "Tracer.hpp"
+#include "debug.hpp"
+
+
+std::atomic<bool> Tracer::s_IsEnabled {false};
+
+
+struct TraceEvent
+{
+    const char* m_pName;
+    const char* m_pCategory;
+    int64_t m_Start;     // Nanoseconds since tracing started
+    int64_t m_Duration;  // Nanoseconds
+    const char* m_pArgNames[2];
+    uint32_t m_Args[2];
+    char m_Phase;  // 'X' for something that took a while, 'i' for an instant
+};
+
+// Only its own thread adds events, in chunks which are allocated as they're
+// needed and never moved. Publishing the count is what makes the events
+// (and the chunks they're in) visible to write().
+struct TraceThread
+{
+    std::array<TraceEvent*, Tracer::MAX_CHUNKS> m_Chunks;
+    std::atomic<size_t> m_Count;
+    std::atomic<size_t> m_DroppedCount;
+    char m_Name[32];
+};
+
+static const size_t MAX_TRACED_THREADS {16};
+static std::array<TraceThread, MAX_TRACED_THREADS> s_Threads;
+static std::atomic<size_t> s_ThreadCount {0};
+
+static thread_local bool t_HasThread {false};
+static thread_local TraceThread* t_pThread {nullptr};
+
+static const char* s_pPath {nullptr};
+static Tracer::Clock::time_point s_Epoch {};
+static volatile std::sig_atomic_t s_IsWriteRequested {0};
+
+
+static int64_t toNanoseconds(Tracer::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+
+static TraceThread* getThread()
+{
+    if ( ! t_HasThread)
+    {
+        t_HasThread = true;
+        const size_t slot {s_ThreadCount.fetch_add(1, std::memory_order_relaxed)};
+        if (slot < MAX_TRACED_THREADS)
+        {
+            t_pThread = &s_Threads[slot];
+        }
+        else
+        {
+            LOG("Too many threads to trace; ignoring this one \n");
+        }
+    }
+    return t_pThread;
+}
+
+static void addEvent(const TraceEvent& event)
+{
+    TraceThread* pThread {getThread()};
+    if ( ! pThread)
+    {
+        return;
+    }
+
+    const size_t count {pThread->m_Count.load(std::memory_order_relaxed)};
+    const size_t chunk {count / Tracer::CHUNK_SIZE};
+    if (chunk == Tracer::MAX_CHUNKS)
+    {
+        pThread->m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if ( ! pThread->m_Chunks[chunk])
+    {
+        // Straight from malloc, so the allocation tracker doesn't blame
+        // whatever's being traced for it.
+        pThread->m_Chunks[chunk] = static_cast<TraceEvent*>(malloc(Tracer::CHUNK_SIZE * sizeof(TraceEvent)));
+        if ( ! pThread->m_Chunks[chunk])
+        {
+            pThread->m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    pThread->m_Chunks[chunk][count % Tracer::CHUNK_SIZE] = event;
+    pThread->m_Count.store(count + 1, std::memory_order_release);
+}
+
+static void requestWrite(int)
+{
+    s_IsWriteRequested = 1;
+}
+
+
+void Tracer::start(const char* pPath)
+{
+    s_pPath = pPath;
+    s_Epoch = Clock::now();
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, requestWrite);
+#endif
+    s_IsEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::setThreadName(const char* pName)
+{
+    TraceThread* pThread {getThread()};
+    if (pThread)
+    {
+        std::strncpy(pThread->m_Name, pName, sizeof(pThread->m_Name) - 1);
+    }
+}
+
+void Tracer::complete(
+    const char* pName,
+    const char* pCategory,
+    Clock::time_point start,
+    Clock::time_point end,
+    const char* pArgName,
+    uint32_t arg
+)
+{
+    addEvent(TraceEvent {pName, pCategory, toNanoseconds(start - s_Epoch), toNanoseconds(end - start), {pArgName, nullptr}, {arg, 0}, 'X'});
+}
+
+void Tracer::instant(
+    const char* pName,
+    const char* pCategory,
+    const char* pArgName,
+    uint32_t arg,
+    const char* pOtherArgName,
+    uint32_t otherArg
+)
+{
+    addEvent(TraceEvent {pName, pCategory, toNanoseconds(Clock::now() - s_Epoch), 0, {pArgName, pOtherArgName}, {arg, otherArg}, 'i'});
+}
+
+
+bool Tracer::write()
+{
+    std::ofstream file {s_pPath};
+    if ( ! file)
+    {
+        return false;
+    }
+
+    // Timestamps are in microseconds from when tracing started.
+    const double NANOSECONDS_PER_MICROSECOND {1e3};
+
+    file << std::fixed;
+    file.precision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"billiards\"}}";
+
+    const size_t threadCount {std::min(s_ThreadCount.load(std::memory_order_relaxed), MAX_TRACED_THREADS)};
+    size_t droppedCount {0};
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        const TraceThread& thread = s_Threads[i];
+        const size_t count {thread.m_Count.load(std::memory_order_acquire)};
+        droppedCount += thread.m_DroppedCount.load(std::memory_order_relaxed);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        file
+            << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i
+            << ", \"args\": {\"name\": \"" << (thread.m_Name[0] ? thread.m_Name : "thread") << "\"}}";
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            const TraceEvent& event = thread.m_Chunks[j / CHUNK_SIZE][j % CHUNK_SIZE];
+            file
+                << ",\n{\"name\": \"" << event.m_pName << "\""
+                << ", \"cat\": \"" << event.m_pCategory << "\""
+                << ", \"ph\": \"" << event.m_Phase << "\""
+                << ", \"ts\": " << event.m_Start / NANOSECONDS_PER_MICROSECOND;
+            if (event.m_Phase == 'X')
+            {
+                file << ", \"dur\": " << event.m_Duration / NANOSECONDS_PER_MICROSECOND;
+            }
+            else
+            {
+                file << ", \"s\": \"t\"";
+            }
+            file << ", \"pid\": 1, \"tid\": " << i;
+
+            if (event.m_pArgNames[0])
+            {
+                file << ", \"args\": {\"" << event.m_pArgNames[0] << "\": " << event.m_Args[0];
+                if (event.m_pArgNames[1])
+                {
+                    file << ", \"" << event.m_pArgNames[1] << "\": " << event.m_Args[1];
+                }
+                file << "}";
+            }
+            file << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    if (droppedCount > 0)
+    {
+        std::cerr << "The trace was full, so " << droppedCount << " events were left out of it" << std::endl;
+    }
+    return static_cast<bool>(file);
+}
+
+void Tracer::writeIfRequested()
+{
+    if ( ! s_IsWriteRequested)
+    {
+        return;
+    }
+    s_IsWriteRequested = 0;
+
+    if (write())
+    {
+        std::cout << "Wrote the trace so far to " << s_pPath << std::endl;
+    }
+    else
+    {
+        std::cerr << "Could not write trace to " << s_pPath << std::endl;
+    }
+}
@@ -0,0 +1,128 @@
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+
+// Records a timeline of what every thread was doing, and when, for viewing
+// in chrome://tracing, Perfetto or the like.
+//
+// Each thread appends to a buffer of its own, which nothing else writes
+// to, so recording an event takes no locks and never waits. The buffers
+// are only read when the trace is written out: at exit, or whenever the
+// process gets SIGUSR1 (at the end of the next frame). Each time, the
+// whole trace so far is written.
+//
+// The profiler's phases go into the trace too, so turning tracing on
+// turns the profiler's timers on as well.
+class Tracer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static bool isEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+
+    // Start recording, to be written to `pPath` later.
+    static void start(const char* pPath);
+
+    // Shown in place of the thread's number. Call it before the thread
+    // records anything. The name is copied, and may be cut short.
+    static void setThreadName(const char* pName);
+
+    // Something which took from `start` to `end`. Names and categories
+    // aren't copied, so they have to be string literals.
+    static void complete(
+        const char* pName,
+        const char* pCategory,
+        Clock::time_point start,
+        Clock::time_point end,
+        const char* pArgName = nullptr,
+        uint32_t arg = 0
+    );
+
+    // Something which happened just now.
+    static void instant(
+        const char* pName,
+        const char* pCategory,
+        const char* pArgName = nullptr,
+        uint32_t arg = 0,
+        const char* pOtherArgName = nullptr,
+        uint32_t otherArg = 0
+    );
+
+    // Main thread only. Write the trace out, as Chrome trace-event JSON.
+    // Returns false if the file couldn't be written.
+    static bool write();
+
+    // Main thread only, once a frame: write the trace out if SIGUSR1 has
+    // asked for it since last time.
+    static void writeIfRequested();
+
+    // Events each thread can record before the rest are dropped
+    static const size_t CHUNK_SIZE {1 << 16};
+    static const size_t MAX_CHUNKS {32};
+
+private:
+    static std::atomic<bool> s_IsEnabled;
+
+};
+
+
+// Puts the scope it's declared in on the timeline.
+class TraceScope
+{
+public:
+    TraceScope(const char* pName, const char* pCategory, const char* pArgName = nullptr, uint32_t arg = 0) :
+        m_pName {pName},
+        m_pCategory {pCategory},
+        m_pArgName {pArgName},
+        m_Arg {arg},
+        m_Start {}
+    {
+        if (Tracer::isEnabled())
+        {
+            m_Start = Tracer::Clock::now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (m_Start != Tracer::Clock::time_point {})
+        {
+            Tracer::complete(m_pName, m_pCategory, m_Start, Tracer::Clock::now(), m_pArgName, m_Arg);
+        }
+    }
+
+private:
+    const char* m_pName;
+    const char* m_pCategory;
+    const char* m_pArgName;
+    uint32_t m_Arg;
+    Tracer::Clock::time_point m_Start;
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+};
+
+
+#define TRACE_CONCAT_INNER(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Like the profiler's timers, these are left out by -DNPROFILE.
+#ifdef NPROFILE
+#define TRACE_SCOPE(name, category)
+#define TRACE_SCOPE_ARG(name, category, argName, arg)
+#else
+#define TRACE_SCOPE(name, category) const TraceScope TRACE_CONCAT(traceScope, __LINE__) {name, category}
+#define TRACE_SCOPE_ARG(name, category, argName, arg) \
+    const TraceScope TRACE_CONCAT(traceScope, __LINE__) {name, category, argName, static_cast<uint32_t>(arg)}
+#endif
+
+
+#endif
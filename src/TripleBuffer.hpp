@@ -0,0 +1,84 @@
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+
+// Hands the latest version of some state from one writer thread to one
+// reader thread without either of them ever waiting.
+//
+// There are three copies of the state. The writer fills in one, the reader
+// looks at another, and the third sits in the middle. Publishing swaps the
+// writer's copy with the middle one, and the reader swaps its copy with the
+// middle one when it wants something newer. If the writer publishes twice
+// before the reader gets around to it, the older one is simply skipped.
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() :
+        m_Slots {},
+        m_WriteIndex {0},
+        m_Middle {1},
+        m_ReadIndex {2}
+    {
+    }
+
+    // Writer side. Fill this in, then publish() it. Whatever was in it
+    // before is stale, so write every field.
+    T& getWriteBuffer()
+    {
+        return m_Slots[m_WriteIndex].m_Value;
+    }
+
+    void publish()
+    {
+        m_WriteIndex = m_Middle.exchange(m_WriteIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side. Picks up the newest published state, if there is one
+    // the reader hasn't seen yet. Returns false if there was nothing new.
+    bool update()
+    {
+        if ((m_Middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+        m_ReadIndex = m_Middle.exchange(m_ReadIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& getReadBuffer() const
+    {
+        return m_Slots[m_ReadIndex].m_Value;
+    }
+
+private:
+    // Set on the middle index when it holds something the reader hasn't
+    // picked up yet.
+    static const uint8_t FRESH {0x4};
+    static const uint8_t INDEX_MASK {0x3};
+
+    // Each copy gets its own cache lines, so writing one never slows down
+    // reading another.
+    struct alignas(64) Slot
+    {
+        T m_Value;
+    };
+    std::array<Slot, 3> m_Slots;
+
+    alignas(64) uint8_t m_WriteIndex;  // Only touched by the writer
+    alignas(64) std::atomic<uint8_t> m_Middle;
+    alignas(64) uint8_t m_ReadIndex;   // Only touched by the reader
+
+private:
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+};
+
+
+#endif
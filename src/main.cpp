@@ -1,15 +1,159 @@
 
+#include <cstdlib>  // for std::atof, std::atoi
+#include <cstring>  // for std::strcmp
 #include <iostream>
 
 #include "Game.hpp"
+#include "Capture.hpp"
+#include "Tournament.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
+#include "Telemetry.hpp"
+#include "StateExport.hpp"
 #include "debug.hpp"
 
 
-int main()
+static void printUsage(const char* program)
 {
-    DEBUG_LOG("Process start \n");
+    std::cerr
+        << "Usage: " << program << " [options] \n"
+        << "  --fps N              Aim for N frames per second instead of the display's refresh rate \n"
+        << "  --frame-stats FILE   Write a histogram of frame times to FILE on exit \n"
+        << "  --profile FILE       Time each phase of the frame, and write the stats to FILE on exit \n"
+        << "  --trace FILE         Record a timeline of every thread, and write it to FILE on exit \n"
+        << "                       (or on SIGUSR1) as Chrome trace-event JSON \n"
+        << "  --alloc-stats FILE   Count heap allocations by frame and subsystem, and write them to FILE on exit \n"
+        << "  --alloc-strict       Abort if the simulation or rendering allocates after warming up \n"
+        << "  --log FILE           Write log messages to FILE (\"-\" for stderr) \n"
+        << "  --telemetry          Publish live counters through shared memory, for billiards-top \n"
+        << "  --export-state       Publish every step's ball positions and velocities through shared memory \n"
+        << "  --capture FILE       Play a game with no window and record it to FILE \n"
+        << "                       (.y4m for video, anything else for a PPM stream) \n"
+        << "  --capture-seconds N  Stop the recording after N seconds (default 30) \n"
+        << "  --capture-fps N      Record N frames per second (default 60) \n"
+        << "  --tournament N       Watch N games play themselves, side by side \n"
+        << "  --tournament-bench   Time drawing tournaments of 4, 16 and 64 tables \n"
+        << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], GameOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue {i + 1 < argc};
+        if (std::strcmp(argv[i], "--fps") == 0 && hasValue)
+        {
+            options.m_FrameRate = std::atof(argv[++i]);
+            if (options.m_FrameRate <= 0.0)
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--frame-stats") == 0 && hasValue)
+        {
+            options.m_pFrameStatsPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && hasValue)
+        {
+            options.m_pProfilePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && hasValue)
+        {
+            options.m_pTracePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--alloc-stats") == 0 && hasValue)
+        {
+            options.m_pAllocationStatsPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--alloc-strict") == 0)
+        {
+            options.m_IsAllocationStrict = true;
+        }
+        else if (std::strcmp(argv[i], "--log") == 0 && hasValue)
+        {
+            options.m_pLogPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--telemetry") == 0)
+        {
+            options.m_IsTelemetryEnabled = true;
+        }
+        else if (std::strcmp(argv[i], "--export-state") == 0)
+        {
+            options.m_IsStateExportEnabled = true;
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0 && hasValue)
+        {
+            options.m_pCapturePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--capture-seconds") == 0 && hasValue)
+        {
+            options.m_CaptureSeconds = static_cast<float>(std::atof(argv[++i]));
+            if (options.m_CaptureSeconds <= 0.0f)
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--capture-fps") == 0 && hasValue)
+        {
+            options.m_CaptureFrameRate = std::atoi(argv[++i]);
+            if (options.m_CaptureFrameRate <= 0)
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--tournament") == 0 && hasValue)
+        {
+            const int size {std::atoi(argv[++i])};
+            if (size <= 0)
+            {
+                return false;
+            }
+            options.m_TournamentSize = static_cast<size_t>(size);
+        }
+        else if (std::strcmp(argv[i], "--tournament-bench") == 0)
+        {
+            options.m_IsTournamentBenchmark = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 
-    Game game;
+static int run(const GameOptions& options)
+{
+    // Capturing doesn't need SDL to be set up at all, so it works on
+    // machines without a display.
+    if (options.m_pCapturePath)
+    {
+        Capture capture {options};
+        return capture.run() ? 0 : 1;
+    }
+
+    if (options.m_IsTournamentBenchmark)
+    {
+        return Tournament::runBenchmark() ? 0 : 1;
+    }
+
+    if (options.m_TournamentSize > 0)
+    {
+        Tournament tournament {options};
+        if ( ! tournament.setupSDL())
+        {
+            std::cerr
+                << "Could not initialize SDL! \n  "
+                << SDL_GetError()
+                << std::endl;
+            return 1;
+        }
+        return tournament.start() ? 0 : 1;
+    }
+
+    Game game {options};
 
     if ( ! game.setupSDL())
     {
@@ -30,3 +174,74 @@ int main()
 
     return 0;
 }
+
+
+int main(int argc, char* argv[])
+{
+    GameOptions options;
+    if ( ! parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+#ifdef DEBUG
+    const char* pLogPath {options.m_pLogPath ? options.m_pLogPath : "-"};
+#else
+    const char* pLogPath {options.m_pLogPath};
+#endif
+    if (pLogPath && ! Log::start(std::strcmp(pLogPath, "-") == 0 ? nullptr : pLogPath))
+    {
+        std::cerr << "Could not write log to " << pLogPath << std::endl;
+    }
+    LOG("Process start \n");
+
+    if (options.m_pProfilePath || options.m_pTracePath)
+    {
+        Profiler::setEnabled(true);
+    }
+    if (options.m_pTracePath)
+    {
+        Tracer::start(options.m_pTracePath);
+        Tracer::setThreadName("main");
+    }
+    if (options.m_pAllocationStatsPath || options.m_IsAllocationStrict)
+    {
+        AllocationTracker::setEnabled(true);
+        AllocationTracker::setStrict(options.m_IsAllocationStrict);
+    }
+    if (options.m_IsTelemetryEnabled && ! Telemetry::start())
+    {
+        std::cerr << "Could not publish telemetry to " << TELEMETRY_SHM_NAME << std::endl;
+    }
+    if (options.m_IsStateExportEnabled && ! StateExport::start())
+    {
+        std::cerr << "Could not export state to " << STATE_SHM_NAME << std::endl;
+    }
+
+    const int status {run(options)};
+    StateExport::stop();
+    Telemetry::stop();
+
+    if (options.m_pProfilePath)
+    {
+        Profiler::collect();
+        if ( ! Profiler::writeCsv(options.m_pProfilePath))
+        {
+            std::cerr << "Could not write profile to " << options.m_pProfilePath << std::endl;
+        }
+    }
+
+    if (options.m_pTracePath && ! Tracer::write())
+    {
+        std::cerr << "Could not write trace to " << options.m_pTracePath << std::endl;
+    }
+
+    if (options.m_pAllocationStatsPath && ! AllocationTracker::writeCsv(options.m_pAllocationStatsPath))
+    {
+        std::cerr << "Could not write allocation stats to " << options.m_pAllocationStatsPath << std::endl;
+    }
+
+    Log::stop();
+    return status;
+}
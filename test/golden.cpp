@@ -0,0 +1,551 @@
+
+#include <algorithm>  // for std::max
+#include <cmath>      // for std::fabs
+#include <cstdlib>    // for std::atof
+#include <cstring>    // for std::strcmp
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/geometric.hpp>
+
+#include "Table.hpp"
+#include "AutoPlayer.hpp"
+
+
+// Replays a set of canonical shots and checks them against golden traces
+// recorded from an earlier build, so that changes to the physics can't
+// quietly change how the game plays. Each trace has the state of every
+// ball every CHECKPOINT_STEPS steps, and when the shot finishes.
+//
+// It also times each shot, and fails if one has got much slower than the
+// baseline stored alongside the traces.
+//
+// After a deliberate change to the physics, re-record the traces with
+// --record (and look over the diff). After moving to different hardware,
+// re-record the baseline with --record-baseline.
+
+
+static const uint64_t CHECKPOINT_STEPS {250};
+
+// How far a replay may stray from its trace. A reordered sum can change
+// the last bit of a float, and a break magnifies that, so exact matches
+// would be too much to ask for.
+static const float POSITION_TOLERANCE {0.5f};
+static const float VELOCITY_TOLERANCE {0.05f};
+static const double STEP_COUNT_TOLERANCE {0.01};  // Of the traced step count
+
+static const double DEFAULT_SLOWDOWN_THRESHOLD {0.25};
+static const double TIMING_SECONDS {0.25};  // Per shot
+
+
+// Something to replay, one step at a time, from the same start every time.
+class Scenario
+{
+public:
+    virtual ~Scenario() {}
+
+    virtual void start() = 0;
+
+    // Returns false once the scenario is over, without stepping.
+    virtual bool step() = 0;
+
+    virtual const Table& getTable() const = 0;
+};
+
+
+// Balls set out by hand, then left to run until they stop.
+class ShotScenario : public Scenario
+{
+public:
+    typedef void (*SetUp)(Table& table);
+
+    explicit ShotScenario(SetUp pSetUp) :
+        m_Table {},
+        m_pSetUp {pSetUp}
+    {
+    }
+
+    void start() override
+    {
+        m_Table = Table {};
+        m_pSetUp(m_Table);
+    }
+
+    bool step() override
+    {
+        if (m_Table.isAtRest() || m_Table.getStepCount() >= MAX_STEPS)
+        {
+            return false;
+        }
+        m_Table.step();
+        return true;
+    }
+
+    const Table& getTable() const override { return m_Table; }
+
+private:
+    Table m_Table;
+    SetUp m_pSetUp;
+
+    static const uint64_t MAX_STEPS {60000};
+
+};
+
+
+// A game played by an AutoPlayer, shots, rules, re-racks and all
+class AutoGameScenario : public Scenario
+{
+public:
+    AutoGameScenario(uint32_t seed, uint64_t stepCount) :
+        m_Seed {seed},
+        m_StepCount {stepCount},
+        m_pPlayer {}
+    {
+    }
+
+    void start() override
+    {
+        m_pPlayer.reset(new AutoPlayer {m_Seed});
+        m_pPlayer->rack();
+    }
+
+    bool step() override
+    {
+        if (m_pPlayer->getTable().getStepCount() >= m_StepCount)
+        {
+            return false;
+        }
+        m_pPlayer->step();
+        return true;
+    }
+
+    const Table& getTable() const override { return m_pPlayer->getTable(); }
+
+private:
+    uint32_t m_Seed;
+    uint64_t m_StepCount;
+    std::unique_ptr<AutoPlayer> m_pPlayer;
+
+};
+
+
+static void setUpBreak(Table& table)
+{
+    table.rackBalls();
+    table.applyForce(0, glm::vec2 {20.0f, 0.0f});
+}
+
+static void setUpSoftBreak(Table& table)
+{
+    table.rackBalls();
+    table.applyForce(0, glm::vec2 {8.0f, 0.4f});
+}
+
+// The cue ball alone, off the top cushion and around the table
+static void setUpBank(Table& table)
+{
+    table.addBall(BallType::Cue, Table::getCueSpot(), glm::vec2 {0.0f, 0.0f});
+    table.applyForce(0, glm::vec2 {12.0f, -9.0f});
+}
+
+// Off the bottom cushion, into a ball sitting in the middle of the table
+static void setUpBankIntoBall(Table& table)
+{
+    table.addBall(BallType::Cue, Table::getCueSpot(), glm::vec2 {0.0f, 0.0f});
+    table.addBall(
+        BallType::Blue,
+        glm::vec2 {Table::FELT_LEFT_COORD + 0.6f * Table::FELT_WIDTH, Table::FELT_TOP_COORD + 0.5f * Table::FELT_HEIGHT},
+        glm::vec2 {0.0f, 0.0f}
+    );
+    table.applyForce(0, glm::vec2 {8.0f, 8.0f});
+}
+
+// Straight into a ball near the top right pocket, which should drop it
+static void setUpPot(Table& table)
+{
+    const glm::vec2 pocket {Table::getPocketPositions()[2]};
+    const glm::vec2 ball {pocket + glm::vec2 {-100.0f, 50.0f}};
+    const glm::vec2 direction {glm::normalize(pocket - ball)};
+    table.addBall(BallType::Cue, ball - 150.0f * direction, glm::vec2 {0.0f, 0.0f});
+    table.addBall(BallType::Red, ball, glm::vec2 {0.0f, 0.0f});
+    table.applyForce(0, 10.0f * direction);
+}
+
+
+struct Shot
+{
+    const char* m_pName;
+    std::unique_ptr<Scenario> m_pScenario;
+};
+
+static std::vector<Shot> makeShots()
+{
+    std::vector<Shot> shots;
+    shots.push_back(Shot {"break", std::unique_ptr<Scenario> {new ShotScenario {setUpBreak}}});
+    shots.push_back(Shot {"soft_break", std::unique_ptr<Scenario> {new ShotScenario {setUpSoftBreak}}});
+    shots.push_back(Shot {"bank", std::unique_ptr<Scenario> {new ShotScenario {setUpBank}}});
+    shots.push_back(Shot {"bank_into_ball", std::unique_ptr<Scenario> {new ShotScenario {setUpBankIntoBall}}});
+    shots.push_back(Shot {"pot", std::unique_ptr<Scenario> {new ShotScenario {setUpPot}}});
+    shots.push_back(Shot {"auto_game", std::unique_ptr<Scenario> {new AutoGameScenario {1, 60000}}});
+    return shots;
+}
+
+
+struct BallState
+{
+    glm::vec2 m_Position;
+    glm::vec2 m_Velocity;
+    bool m_IsPocketed;
+};
+
+struct Checkpoint
+{
+    uint64_t m_Step;
+    std::vector<BallState> m_Balls;
+};
+
+static Checkpoint takeCheckpoint(const Table& table)
+{
+    Checkpoint checkpoint {table.getStepCount(), {}};
+    for (const auto& ball : table.getBalls())
+    {
+        checkpoint.m_Balls.push_back(BallState {ball.position, ball.velocity, ball.m_IsPocketed});
+    }
+    return checkpoint;
+}
+
+// The last checkpoint is always where the scenario finished.
+static std::vector<Checkpoint> replay(Scenario& scenario)
+{
+    std::vector<Checkpoint> trace;
+    scenario.start();
+    trace.push_back(takeCheckpoint(scenario.getTable()));
+    while (scenario.step())
+    {
+        if (scenario.getTable().getStepCount() % CHECKPOINT_STEPS == 0)
+        {
+            trace.push_back(takeCheckpoint(scenario.getTable()));
+        }
+    }
+    if (trace.back().m_Step != scenario.getTable().getStepCount())
+    {
+        trace.push_back(takeCheckpoint(scenario.getTable()));
+    }
+    return trace;
+}
+
+
+// A trace is plain text: a line per checkpoint with its step and how many
+// balls follow, then a line per ball. Floats are written with enough
+// digits to read back exactly.
+static bool writeTrace(const std::string& path, const std::vector<Checkpoint>& trace)
+{
+    std::ofstream file {path};
+    if ( ! file)
+    {
+        return false;
+    }
+
+    file.precision(std::numeric_limits<float>::max_digits10);
+    for (const auto& checkpoint : trace)
+    {
+        file << "step " << checkpoint.m_Step << " " << checkpoint.m_Balls.size() << "\n";
+        for (const auto& ball : checkpoint.m_Balls)
+        {
+            file
+                << ball.m_Position.x << " " << ball.m_Position.y << " "
+                << ball.m_Velocity.x << " " << ball.m_Velocity.y << " "
+                << (ball.m_IsPocketed ? 1 : 0) << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+static bool readTrace(const std::string& path, std::vector<Checkpoint>& trace)
+{
+    std::ifstream file {path};
+    std::string keyword;
+    uint64_t step;
+    size_t ballCount;
+    while (file >> keyword >> step >> ballCount)
+    {
+        if (keyword != "step")
+        {
+            return false;
+        }
+
+        Checkpoint checkpoint {step, {}};
+        for (size_t i = 0; i < ballCount; ++i)
+        {
+            glm::vec2 position;
+            glm::vec2 velocity;
+            int isPocketed;
+            file >> position.x >> position.y >> velocity.x >> velocity.y >> isPocketed;
+            checkpoint.m_Balls.push_back(BallState {position, velocity, isPocketed != 0});
+        }
+        if ( ! file)
+        {
+            return false;
+        }
+        trace.push_back(checkpoint);
+    }
+    return file.eof() && ! trace.empty();
+}
+
+
+// Prints the first thing that's out of tolerance, if anything is.
+static bool compareCheckpoints(const char* pName, const Checkpoint& expected, const Checkpoint& actual)
+{
+    if (expected.m_Balls.size() != actual.m_Balls.size())
+    {
+        std::cout
+            << pName << ": " << actual.m_Balls.size() << " balls at step " << actual.m_Step
+            << ", but the trace has " << expected.m_Balls.size() << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < expected.m_Balls.size(); ++i)
+    {
+        const BallState& want = expected.m_Balls[i];
+        const BallState& got = actual.m_Balls[i];
+        const float positionError {glm::distance(want.m_Position, got.m_Position)};
+        const float velocityError {glm::distance(want.m_Velocity, got.m_Velocity)};
+        if (want.m_IsPocketed != got.m_IsPocketed)
+        {
+            std::cout
+                << pName << ": ball " << i << " is " << (got.m_IsPocketed ? "" : "not ")
+                << "pocketed at step " << actual.m_Step << ", unlike in the trace" << std::endl;
+            return false;
+        }
+        if (positionError > POSITION_TOLERANCE || velocityError > VELOCITY_TOLERANCE)
+        {
+            std::cout
+                << pName << ": ball " << i << " is off by " << positionError
+                << " px (velocity by " << velocityError << ") at step " << actual.m_Step << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool compareTraces(const char* pName, const std::vector<Checkpoint>& expected, const std::vector<Checkpoint>& actual)
+{
+    // Along the way, wherever both have a checkpoint
+    size_t j {0};
+    for (size_t i = 0; i + 1 < expected.size(); ++i)
+    {
+        while (j + 1 < actual.size() && actual[j].m_Step < expected[i].m_Step)
+        {
+            ++j;
+        }
+        if (j + 1 < actual.size() && actual[j].m_Step == expected[i].m_Step)
+        {
+            if ( ! compareCheckpoints(pName, expected[i], actual[j]))
+            {
+                return false;
+            }
+        }
+    }
+
+    // And where each of them finished, which needn't be on the same step
+    const Checkpoint& expectedEnd = expected.back();
+    const Checkpoint& actualEnd = actual.back();
+    const double stepError {std::fabs(static_cast<double>(actualEnd.m_Step) - static_cast<double>(expectedEnd.m_Step))};
+    if (stepError > std::max(1.0, STEP_COUNT_TOLERANCE * expectedEnd.m_Step))
+    {
+        std::cout
+            << pName << ": finished after " << actualEnd.m_Step
+            << " steps, but the trace took " << expectedEnd.m_Step << std::endl;
+        return false;
+    }
+    return compareCheckpoints(pName, expectedEnd, actualEnd);
+}
+
+
+// Steps per second, over as many replays as fit in TIMING_SECONDS (and at
+// least one), not counting the first.
+static double measureThroughput(Scenario& scenario)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    replay(scenario);
+
+    uint64_t steps {0};
+    const auto start = Clock::now();
+    std::chrono::duration<double> elapsed {};
+    do
+    {
+        scenario.start();
+        const uint64_t firstStep {scenario.getTable().getStepCount()};
+        while (scenario.step())
+        {
+        }
+        steps += scenario.getTable().getStepCount() - firstStep;
+        elapsed = Clock::now() - start;
+    }
+    while (elapsed.count() < TIMING_SECONDS);
+
+    return steps / elapsed.count();
+}
+
+static std::map<std::string, double> readBaseline(const std::string& path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream file {path};
+    std::string name;
+    double stepsPerSecond;
+    while (file >> name >> stepsPerSecond)
+    {
+        baseline[name] = stepsPerSecond;
+    }
+    return baseline;
+}
+
+
+static void printUsage(const char* program)
+{
+    std::cerr
+        << "Usage: " << program << " [options] \n"
+        << "  --dir DIR             Where the traces and baseline are (default test/golden) \n"
+        << "  --record              Write new traces instead of checking against them \n"
+        << "  --record-baseline     Write a new throughput baseline \n"
+        << "  --no-perf             Don't check throughput \n"
+        << "  --perf-threshold F    Fail if a shot runs more than F slower than the \n"
+        << "                        baseline (default 0.25, i.e. 25%) \n"
+        << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string directory {"test/golden"};
+    bool isRecording {false};
+    bool isRecordingBaseline {false};
+    bool isCheckingPerf {true};
+    double slowdownThreshold {DEFAULT_SLOWDOWN_THRESHOLD};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue {i + 1 < argc};
+        if (std::strcmp(argv[i], "--dir") == 0 && hasValue)
+        {
+            directory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--record") == 0)
+        {
+            isRecording = true;
+        }
+        else if (std::strcmp(argv[i], "--record-baseline") == 0)
+        {
+            isRecordingBaseline = true;
+        }
+        else if (std::strcmp(argv[i], "--no-perf") == 0)
+        {
+            isCheckingPerf = false;
+        }
+        else if (std::strcmp(argv[i], "--perf-threshold") == 0 && hasValue)
+        {
+            slowdownThreshold = std::atof(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifdef DEBUG
+    // The baseline is for optimised builds, so a debug build would never
+    // keep up with it.
+    if (isCheckingPerf && ! isRecordingBaseline)
+    {
+        std::cout << "Debug build: skipping the throughput checks" << std::endl;
+        isCheckingPerf = false;
+    }
+#endif
+
+    const std::string baselinePath {directory + "/baseline.txt"};
+    const std::map<std::string, double> baseline {readBaseline(baselinePath)};
+    std::ofstream baselineFile {};
+    if (isRecordingBaseline)
+    {
+        baselineFile.open(baselinePath);
+        if ( ! baselineFile)
+        {
+            std::cerr << "Could not open " << baselinePath << " for writing" << std::endl;
+            return 1;
+        }
+    }
+
+    size_t failureCount {0};
+    std::vector<Shot> shots {makeShots()};
+    for (auto& shot : shots)
+    {
+        const std::string path {directory + "/" + shot.m_pName + ".trace"};
+        const std::vector<Checkpoint> actual {replay(*shot.m_pScenario)};
+
+        if (isRecording)
+        {
+            if ( ! writeTrace(path, actual))
+            {
+                std::cerr << "Could not write " << path << std::endl;
+                return 1;
+            }
+            std::cout << "recorded " << shot.m_pName << " (" << actual.back().m_Step << " steps)" << std::endl;
+        }
+        else
+        {
+            std::vector<Checkpoint> expected;
+            if ( ! readTrace(path, expected))
+            {
+                std::cout << "FAIL " << shot.m_pName << ": could not read " << path << std::endl;
+                ++failureCount;
+                continue;
+            }
+            if ( ! compareTraces(shot.m_pName, expected, actual))
+            {
+                std::cout << "FAIL " << shot.m_pName << ": diverged from the trace" << std::endl;
+                ++failureCount;
+                continue;
+            }
+            std::cout << "ok   " << shot.m_pName << " (" << actual.back().m_Step << " steps)" << std::endl;
+        }
+
+        if (isRecordingBaseline)
+        {
+            const double stepsPerSecond {measureThroughput(*shot.m_pScenario)};
+            baselineFile << shot.m_pName << " " << stepsPerSecond << "\n";
+            std::cout << "     " << stepsPerSecond << " steps/s recorded as the baseline" << std::endl;
+        }
+        else if (isCheckingPerf)
+        {
+            const auto found = baseline.find(shot.m_pName);
+            if (found == baseline.end())
+            {
+                std::cout << "     no baseline for " << shot.m_pName << std::endl;
+                continue;
+            }
+
+            const double stepsPerSecond {measureThroughput(*shot.m_pScenario)};
+            const double ratio {stepsPerSecond / found->second};
+            std::cout << "     " << stepsPerSecond << " steps/s, " << ratio << "x the baseline" << std::endl;
+            if (ratio < 1.0 - slowdownThreshold)
+            {
+                std::cout << "FAIL " << shot.m_pName << ": slower than the baseline" << std::endl;
+                ++failureCount;
+            }
+        }
+    }
+
+    if (failureCount > 0)
+    {
+        std::cout << failureCount << " of " << shots.size() << " shots failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
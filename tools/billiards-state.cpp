@@ -0,0 +1,132 @@
+
+#include <signal.h>    // for kill
+#include <unistd.h>    // for usleep
+#include <cstdlib>     // for std::atoll
+#include <cstring>     // for std::strcmp
+#include <iostream>
+
+#include "StateExport.hpp"
+
+
+// Follows a running game's table, from the state it exports with
+// --export-state, and prints every ball of every step as CSV. It only ever
+// reads the shared memory, so if it can't keep up, it loses steps (and
+// says how many) rather than holding the game up.
+
+
+static void printUsage(const char* program)
+{
+    std::cerr
+        << "Usage: " << program << " [options] \n"
+        << "  --every N  Print only every Nth step (default 1) \n"
+        << "  --count N  Stop after printing N steps \n"
+        << "  --once     Print the latest step and exit \n"
+        << std::endl;
+}
+
+static bool isProcessRunning(uint64_t processId)
+{
+    return kill(static_cast<pid_t>(processId), 0) == 0;
+}
+
+static void printRecord(const StateRecord& record)
+{
+    for (uint32_t i = 0; i < record.m_BallCount && i < BALL_TYPE_COUNT; ++i)
+    {
+        const StateBall& ball = record.m_Balls[i];
+        std::cout
+            << record.m_StepCount << ","
+            << record.m_PublishedAt << ","
+            << i << ","
+            << ball.m_Type << ","
+            << ((ball.m_Flags & STATE_BALL_POCKETED) ? 1 : 0) << ","
+            << ball.m_PositionX << ","
+            << ball.m_PositionY << ","
+            << ball.m_VelocityX << ","
+            << ball.m_VelocityY << "\n";
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint64_t every {1};
+    uint64_t count {0};
+    bool isOnce {false};
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue {i + 1 < argc};
+        if (std::strcmp(argv[i], "--every") == 0 && hasValue)
+        {
+            const long long value {std::atoll(argv[++i])};
+            if (value <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            every = static_cast<uint64_t>(value);
+        }
+        else if (std::strcmp(argv[i], "--count") == 0 && hasValue)
+        {
+            const long long value {std::atoll(argv[++i])};
+            if (value <= 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            count = static_cast<uint64_t>(value);
+        }
+        else if (std::strcmp(argv[i], "--once") == 0)
+        {
+            isOnce = true;
+            count = 1;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    StateReader reader;
+    if ( ! reader.open())
+    {
+        std::cerr << "No game is exporting its state (start one with --export-state)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "step,published_at,ball,type,pocketed,x,y,vx,vy\n";
+
+    StateRecord record {};
+    uint64_t readCount {0};
+    uint64_t printedCount {0};
+    uint64_t idleCount {0};
+    while (count == 0 || printedCount < count)
+    {
+        if ( ! reader.next(record))
+        {
+            // Nothing new. Once a second or so, check the game is still
+            // there to publish anything.
+            if (isOnce || (++idleCount % 1000 == 0 && ! isProcessRunning(reader.getProcessId())))
+            {
+                break;
+            }
+            usleep(1000);
+            continue;
+        }
+
+        idleCount = 0;
+        if (readCount++ % every == 0)
+        {
+            printRecord(record);
+            ++printedCount;
+        }
+    }
+    std::cout << std::flush;
+
+    if (reader.getLostCount() > 0)
+    {
+        std::cerr << "Lost " << reader.getLostCount() << " steps that were overwritten before they were read" << std::endl;
+    }
+    return printedCount > 0 ? 0 : 1;
+}
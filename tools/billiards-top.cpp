@@ -0,0 +1,122 @@
+
+#include <signal.h>    // for kill
+#include <unistd.h>    // for usleep
+#include <cstdlib>     // for std::atof
+#include <cstring>     // for std::strcmp
+#include <iomanip>
+#include <iostream>
+
+#include "Telemetry.hpp"
+
+
+// Shows what a running game is up to, from the telemetry it publishes with
+// --telemetry. It only ever reads the shared memory, so however many of
+// these are watching, the game runs just the same.
+
+
+static void printUsage(const char* program)
+{
+    std::cerr
+        << "Usage: " << program << " [options] \n"
+        << "  --interval N  Refresh every N seconds (default 1) \n"
+        << "  --once        Print one sample and exit \n"
+        << std::endl;
+}
+
+static bool isProcessRunning(uint64_t processId)
+{
+    return kill(static_cast<pid_t>(processId), 0) == 0;
+}
+
+// Per second, between two samples
+static double getRate(uint64_t now, uint64_t then, double seconds)
+{
+    return seconds > 0.0 && now >= then ? (now - then) / seconds : 0.0;
+}
+
+static void printSample(const TelemetrySample& sample, const TelemetrySample& previous, bool hasPrevious)
+{
+    const double seconds {hasPrevious ? (sample.m_PublishedAt - previous.m_PublishedAt) / 1e6 : 0.0};
+
+    std::cout
+        << "billiards (pid " << sample.m_ProcessId << ")"
+        << (isProcessRunning(sample.m_ProcessId) ? "" : ", not running") << "\n\n"
+        << std::fixed << std::setprecision(0)
+        << "  steps          " << std::setw(12) << sample.m_StepCount
+        << std::setw(12) << sample.m_StepsPerSecond << " /s \n"
+        << "  frames         " << std::setw(12) << sample.m_FrameCount
+        << std::setw(12) << sample.m_FramesPerSecond << " /s \n"
+        << "  pair tests     " << std::setw(12) << sample.m_PairTests
+        << std::setw(12) << getRate(sample.m_PairTests, previous.m_PairTests, seconds) << " /s \n"
+        << "  contacts       " << std::setw(12) << sample.m_Contacts
+        << std::setw(12) << getRate(sample.m_Contacts, previous.m_Contacts, seconds) << " /s \n"
+        << "  cushion hits   " << std::setw(12) << sample.m_CushionHits
+        << std::setw(12) << getRate(sample.m_CushionHits, previous.m_CushionHits, seconds) << " /s \n"
+        << "  moving balls   " << std::setw(12) << sample.m_MovingBalls << "\n"
+        << "  forces         " << std::setw(12) << sample.m_ForceCount << "\n"
+        << "\n"
+        << std::setprecision(2)
+        << "  frame time     " << std::setw(9) << sample.m_LastFrameMicroseconds / 1e3 << " ms last, "
+        << sample.m_MeanFrameMicroseconds / 1e3 << " ms mean, "
+        << sample.m_MaxFrameMicroseconds / 1e3 << " ms max \n"
+        << std::flush;
+}
+
+
+int main(int argc, char* argv[])
+{
+    double interval {1.0};
+    bool isOnce {false};
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval = std::atof(argv[++i]);
+            if (interval <= 0.0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--once") == 0)
+        {
+            isOnce = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    TelemetryReader reader;
+    TelemetrySample previous {};
+    bool hasPrevious {false};
+    while (true)
+    {
+        TelemetrySample sample {};
+        const bool isOpen {reader.open()};
+        if (isOpen && reader.read(sample))
+        {
+            if ( ! isOnce)
+            {
+                // Clear the terminal, and start from the top.
+                std::cout << "\x1b[H\x1b[2J";
+            }
+            printSample(sample, previous, hasPrevious && sample.m_ProcessId == previous.m_ProcessId);
+            previous = sample;
+            hasPrevious = true;
+        }
+        else if (isOnce || hasPrevious || ! isOpen)
+        {
+            std::cerr << "No game is publishing telemetry (start one with --telemetry)" << std::endl;
+            hasPrevious = false;
+        }
+
+        if (isOnce)
+        {
+            return hasPrevious ? 0 : 1;
+        }
+        usleep(static_cast<useconds_t>(interval * 1e6));
+    }
+}